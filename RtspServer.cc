@@ -1,6 +1,13 @@
 #include "reactor/MultiThreadEventLoop.h"
+#include "reactor/TcpConnection.h"
+#include "reactor/UdpConnection.h"
+#include "reactor/UdpMux.h"
+#include "reactor/UdpPortPool.h"
 #include <iostream>
+#include <getopt.h>
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "reactor/cpp11_compat.h"
 #include "reactor/Logger.h"
 
@@ -13,7 +20,96 @@ void signalHandler(int sig) {
     }
 }
 
-int main() {
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --zerocopy            RTSP/TCP 大块写出使用 MSG_ZEROCOPY\n"
+            "  --udp-mux             UDP 会话共用每个 EventLoop 的一对 RTP/RTCP 端口\n"
+            "  --udp-ports=FIRST-LAST 服务器端 RTP/RTCP 端口的分配范围\n"
+            "  --txtime              UDP 视频帧用 SO_TXTIME 铺开在帧间隔内发送（出口需要 fq 队列规则）\n"
+            "  --pacing-rate=BYTES   UDP 套接字的 SO_MAX_PACING_RATE，字节/秒（出口需要 fq 队列规则）\n"
+            "  --io-uring            EventLoop 用 io_uring 代替 epoll，内核不支持时自动退回\n"
+            "  --edge-triggered      epoll 后端的连接 fd 用边沿触发（EPOLLET），与 --io-uring 同时给出时 io_uring 优先\n"
+            "  -h, --help            显示本帮助\n",
+            prog);
+}
+
+// 各项可选特性默认关闭，必须在创建 EventLoop、建立连接之前打开
+static bool parseOptions(int argc, char *argv[]) {
+    static const struct option options[] = {
+        {"zerocopy", no_argument, nullptr, 'z'},
+        {"udp-mux", no_argument, nullptr, 'm'},
+        {"udp-ports", required_argument, nullptr, 'p'},
+        {"txtime", no_argument, nullptr, 't'},
+        {"pacing-rate", required_argument, nullptr, 'r'},
+        {"io-uring", no_argument, nullptr, 'u'},
+        {"edge-triggered", no_argument, nullptr, 'e'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "h", options, nullptr)) != -1) {
+        switch (opt) {
+        case 'z':
+            TcpConnection::setZeroCopyEnabled(true);
+            LOG_INFO("MSG_ZEROCOPY enabled for TCP connections");
+            break;
+        case 'm':
+            UdpMux::setEnabled(true);
+            LOG_INFO("Shared per-loop RTP/RTCP sockets enabled");
+            break;
+        case 'p': {
+            unsigned short first = 0, last = 0;
+            char tail;
+            if (sscanf(optarg, "%hu-%hu%c", &first, &last, &tail) != 2 || !UdpPortPool::setRange(first, last)) {
+                fprintf(stderr, "bad --udp-ports '%s', expected FIRST-LAST\n", optarg);
+                return false;
+            }
+            break;
+        }
+        case 't':
+            UdpConnection::setTxTimeEnabled(true);
+            LOG_INFO("SO_TXTIME pacing enabled for UDP sessions");
+            break;
+        case 'r': {
+            char *end = nullptr;
+            unsigned long rate = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || rate == 0 || rate > 0xFFFFFFFFul) {
+                fprintf(stderr, "bad --pacing-rate '%s', expected bytes per second\n", optarg);
+                return false;
+            }
+            UdpConnection::setMaxPacingRate((uint32_t)rate);
+            LOG_INFO("SO_MAX_PACING_RATE %lu bytes/s for UDP sessions", rate);
+            break;
+        }
+        case 'u':
+            EventLoop::setIoUringEnabled(true);
+            LOG_INFO("io_uring backend requested for event loops");
+            break;
+        case 'e':
+            EventLoop::setEdgeTriggered(true);
+            LOG_INFO("Edge-triggered epoll enabled for connections");
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+    if (optind < argc) {
+        usage(argv[0]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parseOptions(argc, argv)) {
+        return 1;
+    }
+
     // 设置信号处理
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
@@ -0,0 +1,252 @@
+// 稳态堆分配计数：替换全局 operator new，在 EventLoop 线程里直接驱动两条发送路径，
+// 预热之后统计 EventLoop 线程上的 new 次数，不为 0 视为失败（退出码 1）。
+//   live：StreamHub 打包 + GOP 缓存 + 发布给同一 EventLoop 上的 UDP RtpPusher，后者 sendmmsg 发出并记进重传历史
+//   vod：UDP RtpPusher::onPace 从预打包缓存取帧（sendCachedH264Frame）、AAC 聚合、sendmmsg、重传历史
+// 时间是模拟的：按各自返回的下一次到期时间推进，不用真的等。MediaPacer 的排队和定时器、RTCP 报告不在统计范围内，
+// 它们按唤醒次数或秒计，和包数无关。包发给本机的两个 UDP 端口，每一拍之后读空。
+// ALLOC_TRACE=1 时打印前几次计入的分配的调用栈。
+// 用法：make bench && ./bench/alloc_count_bench [live 测量的媒体秒数，默认 60] [h264 文件，默认 data/1.h264] [aac 文件，默认 data/1.aac]
+#include "media/StreamHub.h"
+#include "media/RtpPusher.h"
+#include "media/H264FileReader.h"
+#include "media/AacFileReader.h"
+#include "reactor/Acceptor.h"
+#include "reactor/EventLoop.h"
+#include "reactor/UdpConnection.h"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <execinfo.h>
+#include <future>
+#include <new>
+#include <thread>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::chrono::steady_clock;
+
+// 只统计打开了计数的线程（EventLoop 线程），后台线程（如预打包缓存的构建）不算
+static thread_local bool t_counting = false;
+static size_t g_allocations = 0;
+static int g_traces = 0;
+
+static void countAllocation() {
+    if (!t_counting) {
+        return;
+    }
+    ++g_allocations;
+    if (g_traces > 0) {
+        --g_traces;
+        t_counting = false;
+        void* frames[32];
+        int n = backtrace(frames, 32);
+        fprintf(stderr, "allocation #%zu:\n", g_allocations);
+        backtrace_symbols_fd(frames, n, STDERR_FILENO);
+        t_counting = true;
+    }
+}
+
+void* operator new(size_t size) {
+    countAllocation();
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    countAllocation();
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+// 直接驱动 StreamHub 的生产者，不经过 MediaPacer
+class StreamHubBench {
+public:
+    static bool tick(StreamHub& hub, steady_clock::time_point now, steady_clock::time_point& nextDue) {
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(hub._mutex);
+            generation = hub._generation;
+        }
+        return hub.onPace(generation, now, nextDue);
+    }
+};
+
+// 本机的一个 UDP 接收端，只负责把包读走，免得发送端缓冲区满了丢包
+class Sink {
+public:
+    Sink() {
+        _fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int rcvbuf = 4 * 1024 * 1024;
+        setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        ::bind(_fd, (struct sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(_addr);
+        getsockname(_fd, (struct sockaddr*)&_addr, &len);
+    }
+    ~Sink() { ::close(_fd); }
+    InetAddress addr() const { return InetAddress(_addr); }
+    void drain() {
+        static char buf[65536];
+        while (::recv(_fd, buf, sizeof(buf), 0) > 0) {
+            ++_packets;
+        }
+    }
+    size_t packets() const { return _packets; }
+    void reset() { _packets = 0; }
+private:
+    int _fd;
+    struct sockaddr_in _addr;
+    size_t _packets = 0;
+};
+
+struct Result {
+    size_t ticks = 0;
+    size_t packets = 0;
+    size_t allocations = 0;
+};
+
+// 按 tick 返回的到期时间推进模拟时钟，跑 warmup 秒后开始计数，再跑 seconds 秒
+template <typename Tick>
+static Result drive(Tick tick, steady_clock::time_point& now, double warmup, double seconds, Sink& video, Sink& audio) {
+    Result result;
+    auto run = [&](double span, bool counting) {
+        auto end = now + std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(span));
+        while (now < end) {
+            steady_clock::time_point due = now;
+            t_counting = counting;
+            bool alive = tick(now, due);
+            t_counting = false;
+            video.drain();
+            audio.drain();
+            if (!alive) {
+                return false;
+            }
+            result.ticks += counting;
+            now = std::max(due, now);
+        }
+        return true;
+    };
+    if (!run(warmup, false)) {
+        fprintf(stderr, "stream ended during warmup\n");
+        return result;
+    }
+    video.reset();
+    audio.reset();
+    g_allocations = 0;
+    if (!run(seconds, true)) {
+        fprintf(stderr, "stream ended during measurement\n");
+    }
+    result.packets = video.packets() + audio.packets();
+    result.allocations = g_allocations;
+    return result;
+}
+
+static bool report(const char* name, const Result& r) {
+    printf("%-5s ticks %8zu packets %9zu allocations %6zu (%.4f per packet)\n", name, r.ticks, r.packets,
+           r.allocations, r.packets ? double(r.allocations) / r.packets : 0.0);
+    return r.ticks > 0 && r.allocations == 0;
+}
+
+static std::shared_ptr<RtpPusher> udpPusher(const std::shared_ptr<EventLoop>& loop, Sink& video, Sink& audio,
+                                            const std::string& h264, const std::string& aac) {
+    auto videoConn = std::make_shared<UdpConnection>("127.0.0.1", 0, video.addr(), loop);
+    auto audioConn = std::make_shared<UdpConnection>("127.0.0.1", 0, audio.addr(), loop);
+    return std::make_shared<RtpPusher>(videoConn, audioConn, std::make_shared<H264FileReader>(h264),
+                                       std::make_shared<AacFileReader>(aac));
+}
+
+// 点播能跑多久：文件里的帧数（不含 SPS/PPS）按 25fps 算，读到结尾会停止推流
+static double vodSeconds(const std::shared_ptr<MediaSource>& source) {
+    size_t frames = 0;
+    for (size_t i = 0; i < source->frameCount(); ++i) {
+        uint8_t type = source->frame(i).type;
+        frames += (type != 7 && type != 8);
+    }
+    return frames * 0.04;
+}
+
+int main(int argc, char* argv[]) {
+    double liveSeconds = argc > 1 ? atof(argv[1]) : 60;
+    std::string h264 = argc > 2 ? argv[2] : "data/1.h264";
+    std::string aac = argc > 3 ? argv[3] : "data/1.aac";
+    if (getenv("ALLOC_TRACE")) {
+        g_traces = 5;
+        void* frames[1];
+        backtrace(frames, 1);   // 第一次调用会加载 libgcc，先在计数之外做掉
+    }
+
+    auto source = MediaSource::open(h264, MediaCodec::H264);
+    if (!source || source->frameCount() == 0 || !MediaSource::open(aac, MediaCodec::AAC)) {
+        fprintf(stderr, "can not open %s / %s\n", h264.c_str(), aac.c_str());
+        return 1;
+    }
+    while (!source->rtpPayloadCache()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    Acceptor acceptor("127.0.0.1", 0);
+    auto loop = std::make_shared<EventLoop>(acceptor);
+    std::thread thread([&loop]() { loop->loop(); });
+    std::promise<bool> done;
+    loop->runInLoop([&]() {
+        Sink video, audio;
+        bool ok = true;
+        // 直播：同一个 EventLoop 上的订阅者直接收到批次，生产和发送都在这一拍内完成
+        {
+            auto hub = StreamHub::get("alloc_count_bench", h264, aac);
+            auto pusher = udpPusher(loop, video, audio, h264, aac);
+            pusher->setStreamHub(hub);
+            pusher->start();
+            auto now = steady_clock::now();
+            auto tick = [&hub](steady_clock::time_point now, steady_clock::time_point& due) {
+                return StreamHubBench::tick(*hub, now, due);
+            };
+            // 预热要长过一个 GOP 缓存的上限，批次池才会长到稳态大小
+            ok = report("live", drive(tick, now, 20, liveSeconds, video, audio)) && ok;
+            pusher->stop();
+            hub->unsubscribe(pusher.get());
+        }
+        // 点播：读到文件结尾前停下
+        {
+            double total = vodSeconds(source);
+            double warmup = std::min(5.0, total / 4);
+            auto pusher = udpPusher(loop, video, audio, h264, aac);
+            pusher->start();
+            auto now = steady_clock::now();
+            auto tick = [&pusher](steady_clock::time_point now, steady_clock::time_point& due) {
+                return pusher->onPace(now, due);
+            };
+            ok = report("vod", drive(tick, now, warmup, total - warmup - 1, video, audio)) && ok;
+            pusher->stop();
+        }
+        loop->unloop();
+        done.set_value(ok);
+    });
+    bool ok = done.get_future().get();
+    thread.join();
+    return ok ? 0 : 1;
+}
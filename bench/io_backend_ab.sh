@@ -0,0 +1,64 @@
+#!/bin/bash
+# epoll 和 io_uring 后端的 A/B 负载测试：每种后端、每档会话数各启动一次 rtsp_server，
+# 用 bench/rtsp_loadgen 建立会话并拉流，在测量窗口里统计服务器进程的 CPU（/proc/<pid>/stat 的 utime+stime）、
+# 自愿上下文切换次数（/proc/<pid>/status，所有线程合计），以及负载端收到的码率和实际在播的会话数。
+# 服务器从当前目录读 data/1.h264 和 data/1.aac，在放好这两个文件的目录里运行；每个会话占一个描述符，
+# 10000 个会话需要先把 ulimit -n 调到 20000 以上。
+# 用法：make && make bench && ./bench/io_backend_ab.sh [会话数列表，默认 "1000 5000 10000"] [预热秒数，默认 5] [测量秒数，默认 10]
+sessions=${1:-"1000 5000 10000"}
+warmup=${2:-5}
+measure=${3:-10}
+dir=$(cd "$(dirname "$0")/.." && pwd)
+server=$dir/rtsp_server
+loadgen=$dir/bench/rtsp_loadgen
+
+if [ ! -x "$server" ] || [ ! -x "$loadgen" ]; then
+    echo "build first: make && make bench" >&2
+    exit 1
+fi
+if [ ! -f data/1.h264 ] || [ ! -f data/1.aac ]; then
+    echo "data/1.h264 and data/1.aac not found in $(pwd)" >&2
+    exit 1
+fi
+
+# 进程 utime+stime，单位为时钟滴答
+cpu_ticks() {
+    awk '{print $14 + $15}' /proc/$1/stat
+}
+
+# 所有线程的自愿上下文切换次数之和
+voluntary_switches() {
+    cat /proc/$1/task/*/status 2>/dev/null | awk '/^voluntary_ctxt_switches/ {n += $2} END {print n + 0}'
+}
+
+hz=$(getconf CLK_TCK)
+printf "%-9s %8s | %8s %8s | %8s %12s\n" backend sessions playing "MB/s" "cpu" "vol cs/s"
+for n in $sessions; do
+    for backend in epoll io_uring; do
+        args=""
+        [ $backend = io_uring ] && args="--io-uring"
+        "$server" $args > /dev/null 2>&1 &
+        pid=$!
+        sleep 1
+        out=/tmp/io_backend_ab.$$
+        "$loadgen" "$n" "$warmup" "$measure" > $out 2>&1 &
+        client=$!
+        # 和负载端的测量窗口对齐：建连和预热要多久不确定，等它输出 measuring 再开始取样
+        while kill -0 $client 2> /dev/null && ! grep -q measuring $out; do
+            sleep 0.1
+        done
+        cpu0=$(cpu_ticks $pid)
+        cs0=$(voluntary_switches $pid)
+        sleep "$measure"
+        cpu1=$(cpu_ticks $pid)
+        cs1=$(voluntary_switches $pid)
+        wait $client
+        kill $pid
+        wait $pid 2> /dev/null
+        read -r _ _ _ playing _ _ _ rate _ < <(grep ^sessions $out)
+        awk -v b=$backend -v n=$n -v p="${playing:-?}" -v r="${rate:-?}" -v cpu=$((cpu1 - cpu0)) \
+            -v cs=$((cs1 - cs0)) -v hz=$hz -v t=$measure \
+            'BEGIN {printf "%-9s %8s | %8s %8s | %7.1f%% %12.0f\n", b, n, p, r, cpu * 100 / hz / t, cs / t}'
+        rm -f $out
+    done
+done
@@ -0,0 +1,154 @@
+// PacketBuffer 池的分配计数：模拟 StreamHub 的用法，一个生产者线程打包，N 个订阅者线程各自持有一段时间后释放。
+// 缓冲区在订阅者线程释放，池必须把它们还给生产者线程，稳态下生产者才不再 new；
+// 预热之后的新分配超过包数的 1% 视为失败（退出码 1）。
+// 用法：make bench && ./bench/packet_pool_bench [订阅者数] [轮数]
+#include "reactor/PacketBuffer.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using Batch = std::vector<PacketPtr>;
+using BatchPtr = std::shared_ptr<const Batch>;
+
+// 和 StreamHub 一样：视频包同时进 GOP 缓存，遇到 IDR 清空；音频包只投递给订阅者，最后总在订阅者线程释放
+static const size_t kVideoPackets = 6;          // 每批的视频包
+static const size_t kAudioPackets = 2;          // 每批的音频包
+static const size_t kGopBatches = 50;           // 每隔这么多批一个 IDR
+static const size_t kSendWindow = 4;            // 订阅者发送链里压着的批次
+static const size_t kQueueDepth = 16;           // 订阅者落后太多时生产者等一等，相当于实时节奏
+
+// 一个订阅者线程的投递队列
+class Inbox {
+public:
+    void push(const BatchPtr& batch) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]() { return _queue.size() < kQueueDepth; });
+        _queue.push_back(batch);
+        _notEmpty.notify_one();
+    }
+    // 队列关闭且为空时返回 false
+    bool pop(BatchPtr& batch) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this]() { return !_queue.empty() || _closed; });
+        if (_queue.empty()) {
+            return false;
+        }
+        batch = std::move(_queue.front());
+        _queue.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_all();
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::deque<BatchPtr> _queue;
+    bool _closed = false;
+};
+
+static void subscriber(Inbox* inbox) {
+    std::deque<BatchPtr> sending;
+    BatchPtr batch;
+    while (inbox->pop(batch)) {
+        sending.push_back(std::move(batch));
+        if (sending.size() > kSendWindow) {
+            sending.pop_front();    // 发完了，最后一个引用在这个线程里释放
+        }
+    }
+}
+
+static size_t g_round = 0;
+
+struct Phase {
+    size_t packets = 0;
+    size_t newBuffers = 0;
+    double ns = 0;
+};
+
+static void produce(std::vector<std::unique_ptr<Inbox>>& inboxes, std::deque<BatchPtr>& gop,
+                    size_t rounds, Phase& phase) {
+    size_t before = PacketBuffer::allocatedCount();
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        auto video = std::make_shared<Batch>();
+        for (size_t i = 0; i < kVideoPackets; ++i) {
+            PacketPtr packet = PacketBuffer::alloc();
+            memset(packet->append(1200), int(i), 1200);
+            packet->prepend(PacketBuffer::kHeadroom);
+            video->push_back(std::move(packet));
+        }
+        auto batch = std::make_shared<Batch>(*video);
+        for (size_t i = 0; i < kAudioPackets; ++i) {
+            PacketPtr packet = PacketBuffer::alloc();
+            memset(packet->append(400), int(i), 400);
+            packet->prepend(PacketBuffer::kHeadroom);
+            batch->push_back(std::move(packet));
+        }
+        if (++g_round % kGopBatches == 0) {
+            gop.clear();
+        }
+        gop.push_back(video);
+        for (auto& inbox : inboxes) {
+            inbox->push(batch);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    phase.packets = rounds * (kVideoPackets + kAudioPackets);
+    phase.newBuffers = PacketBuffer::allocatedCount() - before;
+    phase.ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t subscribers = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4;
+    size_t rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000;
+    std::vector<std::unique_ptr<Inbox>> inboxes;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < subscribers; ++i) {
+        inboxes.emplace_back(new Inbox());
+        threads.emplace_back(subscriber, inboxes.back().get());
+    }
+
+    Phase warm, steady;
+    std::deque<BatchPtr> gop;
+    // 生产者就是主线程；预热让池长到稳态所需的大小（GOP + 各订阅者的队列和发送窗口）
+    produce(inboxes, gop, rounds / 4 + kGopBatches, warm);
+    produce(inboxes, gop, rounds, steady);
+
+    gop.clear();
+    for (auto& inbox : inboxes) {
+        inbox->close();
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    printf("%zu subscribers, %zu video + %zu audio packets per batch, gop %zu batches\n", subscribers,
+           kVideoPackets, kAudioPackets, kGopBatches);
+    printf("%-8s %10s %12s %14s %12s\n", "phase", "packets", "new buffers", "new per 1k pkt", "ns/packet");
+    const Phase* phases[] = {&warm, &steady};
+    const char* names[] = {"warmup", "steady"};
+    for (int i = 0; i < 2; ++i) {
+        const Phase& p = *phases[i];
+        printf("%-8s %10zu %12zu %14.2f %12.1f\n", names[i], p.packets, p.newBuffers,
+               p.packets ? p.newBuffers * 1000.0 / p.packets : 0.0, p.packets ? p.ns / p.packets : 0.0);
+    }
+    printf("total buffers allocated: %zu\n", PacketBuffer::allocatedCount());
+    if (steady.newBuffers * 100 > steady.packets) {
+        fprintf(stderr, "pool keeps growing in steady state: buffers released on other threads are not reused\n");
+        return 1;
+    }
+    return 0;
+}
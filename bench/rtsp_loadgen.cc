@@ -0,0 +1,174 @@
+// RTSP 负载生成器：建立 N 个 RTP over TCP（interleaved）会话，SETUP 两路 + PLAY 后只管把数据读走，
+// 连接全部建好、再预热一段时间后，在测量窗口里统计收到的字节数（开始测量时输出一行 measuring）。
+// 配合 bench/io_backend_ab.sh 比较 epoll 和 io_uring 后端。
+// 每个会话一个连接，需要 N 个以上的文件描述符（ulimit -n）。
+// 用法：make bench && ./bench/rtsp_loadgen 会话数 [预热秒数，默认 5] [测量秒数，默认 5] [路径，默认 test] [ip:port，默认 127.0.0.1:8888]
+#include <chrono>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Session {
+    enum State { kSetupVideo, kSetupAudio, kPlay, kPlaying, kFailed };
+    int fd = -1;
+    State state = kSetupVideo;
+    std::string reply;      // 正在接收的 RTSP 应答
+    std::string id;         // Session 头
+};
+
+static double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool sendRequest(Session& s, const std::string& url) {
+    char request[512];
+    int n = 0;
+    if (s.state == Session::kSetupVideo) {
+        n = snprintf(request, sizeof(request),
+                     "SETUP %s/track0 RTSP/1.0\r\nCSeq: 1\r\nTransport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n\r\n",
+                     url.c_str());
+    } else if (s.state == Session::kSetupAudio) {
+        n = snprintf(request, sizeof(request),
+                     "SETUP %s/track1 RTSP/1.0\r\nCSeq: 2\r\nTransport: RTP/AVP/TCP;unicast;interleaved=2-3\r\n"
+                     "Session: %s\r\n\r\n", url.c_str(), s.id.c_str());
+    } else {
+        n = snprintf(request, sizeof(request), "PLAY %s RTSP/1.0\r\nCSeq: 3\r\nSession: %s\r\n\r\n", url.c_str(),
+                     s.id.c_str());
+    }
+    return ::write(s.fd, request, n) == n;
+}
+
+// 收齐一条应答后推进到下一步，出错返回 false
+static bool handleReply(Session& s, const std::string& url) {
+    size_t end = s.reply.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return true;
+    }
+    std::string reply = s.reply.substr(0, end);
+    s.reply.erase(0, end + 4);
+    if (reply.compare(0, 15, "RTSP/1.0 200 OK") != 0) {
+        return false;
+    }
+    if (s.state == Session::kSetupVideo) {
+        size_t pos = reply.find("Session: ");
+        if (pos == std::string::npos) {
+            return false;
+        }
+        s.id = reply.substr(pos + 9, reply.find_first_of(";\r", pos + 9) - pos - 9);
+    }
+    s.state = Session::State(s.state + 1);
+    return s.state == Session::kPlaying || sendRequest(s, url);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s sessions [warmup_s] [measure_s] [path] [ip:port]\n", argv[0]);
+        return 1;
+    }
+    size_t count = strtoul(argv[1], nullptr, 10);
+    double warmup = argc > 2 ? atof(argv[2]) : 5;
+    double measure = argc > 3 ? atof(argv[3]) : 5;
+    std::string path = argc > 4 ? argv[4] : "test";
+    std::string target = argc > 5 ? argv[5] : "127.0.0.1:8888";
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos || inet_pton(AF_INET, target.substr(0, colon).c_str(), &addr.sin_addr) != 1) {
+        fprintf(stderr, "bad target %s, expected ip:port\n", target.c_str());
+        return 1;
+    }
+    addr.sin_port = htons((unsigned short)atoi(target.c_str() + colon + 1));
+    std::string url = "rtsp://" + target + "/" + path;
+
+    int epfd = epoll_create1(0);
+    std::vector<Session> sessions(count);
+    std::vector<char> buffer(256 * 1024);
+    struct epoll_event events[1024];
+    for (size_t i = 0; i < count; ++i) {
+        Session& s = sessions[i];
+        s.fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        // 接收缓冲区和普通播放器相近，不让内核替客户端兜住大量数据
+        int rcvbuf = 64 * 1024;
+        setsockopt(s.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (s.fd < 0 || ::connect(s.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            fprintf(stderr, "connect #%zu failed: %s\n", i, strerror(errno));
+            return 1;
+        }
+        fcntl(s.fd, F_SETFL, fcntl(s.fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &s;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, s.fd, &ev);
+        sendRequest(s, url);
+    }
+
+    size_t playing = 0, failed = 0;
+    uint64_t measured = 0;
+    double start = nowSeconds(), measureStart = 0;
+    for (;;) {
+        int n = epoll_wait(epfd, events, 1024, 100);
+        for (int i = 0; i < n; ++i) {
+            Session& s = *static_cast<Session*>(events[i].data.ptr);
+            if (s.state == Session::kFailed) {
+                continue;
+            }
+            for (;;) {
+                ssize_t got = ::read(s.fd, buffer.data(), buffer.size());
+                if (got <= 0) {
+                    if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                        s.state = Session::kFailed;
+                        ++failed;
+                        epoll_ctl(epfd, EPOLL_CTL_DEL, s.fd, nullptr);
+                    }
+                    break;
+                }
+                if (s.state == Session::kPlaying) {
+                    if (measureStart > 0) {
+                        measured += got;
+                    }
+                    continue;
+                }
+                // 握手阶段：应答之后可能紧跟着 interleaved 数据，进入 PLAYING 后剩下的丢掉
+                s.reply.append(buffer.data(), got);
+                if (!handleReply(s, url)) {
+                    s.state = Session::kFailed;
+                    ++failed;
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, s.fd, nullptr);
+                    break;
+                }
+                if (s.state == Session::kPlaying) {
+                    ++playing;
+                    s.reply.clear();
+                }
+            }
+        }
+        double now = nowSeconds();
+        if (measureStart == 0 && now - start >= warmup) {
+            measureStart = now;
+            // 连接全部建好要一段时间，外面的脚本看到这一行才开始对服务器取样
+            printf("measuring, %zu playing\n", playing);
+            fflush(stdout);
+        }
+        if (measureStart > 0 && now - measureStart >= measure) {
+            break;
+        }
+    }
+
+    printf("sessions %zu playing %zu failed %zu recv %.1f MB/s\n", count, playing, failed, measured / measure / 1e6);
+    for (Session& s : sessions) {
+        ::close(s.fd);
+    }
+    ::close(epfd);
+    return failed > 0 ? 1 : 0;
+}
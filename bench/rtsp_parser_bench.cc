@@ -0,0 +1,215 @@
+// RTSP 请求解析吞吐的微基准：在 corpus/ 下各播放器的真实请求序列上比较
+// RtspParser（增量、零拷贝）和原来的做法（memmem 分帧 + 拷贝成 string + istringstream 逐行解析 + 正则取端口）。
+// 用法：make bench && ./bench/rtsp_parser_bench [迭代次数]
+#include "media/RtspParser.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 统计解析过程中的堆分配次数
+static size_t g_allocs = 0;
+
+void* operator new(size_t size) {
+    ++g_allocs;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// 语料按 LF 存放，读入时统一换成 CRLF
+static std::string loadCorpus(const std::string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in) {
+        return "";
+    }
+    std::string raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string out;
+    out.reserve(raw.size() * 2);
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] == '\n' && (i == 0 || raw[i - 1] != '\r')) {
+            out += '\r';
+        }
+        out += raw[i];
+    }
+    return out;
+}
+
+struct Result {
+    size_t requests = 0;
+    long checksum = 0;  // CSeq 和 client_port 之和，两种实现应当一致
+};
+
+// 新实现：整段语料当作一个接收缓冲区，逐条解析后取走
+static bool parseNew(const std::string& stream, Result& result) {
+    RtspParser parser;
+    const char* data = stream.data();
+    size_t left = stream.size();
+    while (left > 0) {
+        RtspParser::Status status = parser.parse(data, left);
+        if (status == RtspParser::kIncomplete) {
+            break;
+        }
+        if (status == RtspParser::kBadRequest) {
+            return false;
+        }
+        int rtp = 0, rtcp = 0;
+        if (parser.method() == RtspParser::kSetup) {
+            RtspParser::parseClientPort(parser.transport(), rtp, rtcp);
+        }
+        result.checksum += parser.cseq() + rtp + rtcp + (parser.url().contains("track0") ? 1 : 0);
+        ++result.requests;
+        data += parser.messageLength();
+        left -= parser.messageLength();
+        parser.reset();
+    }
+    return true;
+}
+
+// 原来的实现：TcpConnection::reciveRtspRequest + RtspConnect::parseRequest + handleSetup 里的正则
+static bool parseLegacy(const std::string& stream, Result& result) {
+    std::string buffer = stream;
+    for (;;) {
+        size_t end = buffer.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string request = buffer.substr(0, end + 4);
+        buffer.erase(0, end + 4);
+
+        std::istringstream iss(request);
+        std::string line, method, url, version, transport;
+        std::vector<std::string> headers;
+        int cseq = 0;
+        while (std::getline(iss, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty()) {
+                break;
+            }
+            if (line[0] == ' ' || line[0] == '\t') {
+                if (!headers.empty()) {
+                    headers.back() += line;
+                }
+            } else {
+                headers.push_back(line);
+            }
+        }
+        for (size_t i = 0; i < headers.size(); ++i) {
+            const std::string& h = headers[i];
+            if (i == 0 && h.find("RTSP/") != std::string::npos) {
+                std::istringstream lss(h);
+                lss >> method >> url >> version;
+            } else if (h.find("CSeq") != std::string::npos || h.find("CSEQ") != std::string::npos) {
+                size_t pos = h.find(":");
+                if (pos != std::string::npos) {
+                    cseq = std::stoi(h.substr(pos + 1));
+                }
+            } else if (h.find("Transport") != std::string::npos) {
+                transport = h;
+            }
+        }
+        int rtp = 0, rtcp = 0;
+        if (method == "SETUP") {
+            std::regex clientPortRegex(R"(client_port=(\d+)-(\d+))");
+            std::smatch match;
+            if (std::regex_search(transport, match, clientPortRegex)) {
+                rtp = std::stoi(match[1]);
+                rtcp = std::stoi(match[2]);
+            }
+        }
+        result.checksum += cseq + rtp + rtcp + (url.find("track0") != std::string::npos ? 1 : 0);
+        ++result.requests;
+    }
+    return true;
+}
+
+// 逐字节喂给解析器（最坏的分包情况），确认增量解析和一次性解析结果一致
+static bool parseByteByByte(const std::string& stream, Result& result) {
+    RtspParser parser;
+    size_t start = 0;
+    for (size_t avail = 1; avail <= stream.size(); ++avail) {
+        RtspParser::Status status = parser.parse(stream.data() + start, avail - start);
+        if (status == RtspParser::kBadRequest) {
+            return false;
+        }
+        if (status == RtspParser::kComplete) {
+            int rtp = 0, rtcp = 0;
+            if (parser.method() == RtspParser::kSetup) {
+                RtspParser::parseClientPort(parser.transport(), rtp, rtcp);
+            }
+            result.checksum += parser.cseq() + rtp + rtcp + (parser.url().contains("track0") ? 1 : 0);
+            ++result.requests;
+            start += parser.messageLength();
+            parser.reset();
+        }
+    }
+    return true;
+}
+
+template <typename F>
+static double run(F parse, const std::string& stream, int iterations, Result& result, size_t& allocs) {
+    Result warm;
+    parse(stream, warm);
+    size_t before = g_allocs;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        Result r;
+        parse(stream, r);
+        result = r;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    allocs = g_allocs - before;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    const char* names[] = {"vlc", "ffmpeg", "gstreamer"};
+    bool ok = true;
+    printf("%-10s %6s %8s | %12s %10s %10s | %12s %10s %10s\n", "corpus", "reqs", "bytes",
+           "new ns/req", "MB/s", "allocs/req", "old ns/req", "MB/s", "allocs/req");
+    for (const char* name : names) {
+        std::string stream = loadCorpus(std::string("bench/corpus/") + name + ".txt");
+        if (stream.empty()) {
+            fprintf(stderr, "cannot read bench/corpus/%s.txt (run from the repository root)\n", name);
+            return 1;
+        }
+        Result fresh, legacy, bytewise;
+        size_t freshAllocs = 0, legacyAllocs = 0;
+        double freshNs = run(parseNew, stream, iterations, fresh, freshAllocs);
+        double legacyNs = run(parseLegacy, stream, iterations, legacy, legacyAllocs);
+        parseByteByByte(stream, bytewise);
+        if (fresh.requests != legacy.requests || fresh.checksum != legacy.checksum ||
+            fresh.requests != bytewise.requests || fresh.checksum != bytewise.checksum) {
+            fprintf(stderr, "%s: results differ (new %zu/%ld, old %zu/%ld, bytewise %zu/%ld)\n", name,
+                    fresh.requests, fresh.checksum, legacy.requests, legacy.checksum,
+                    bytewise.requests, bytewise.checksum);
+            ok = false;
+        }
+        double reqs = (double)fresh.requests * iterations;
+        double bytes = (double)stream.size() * iterations;
+        printf("%-10s %6zu %8zu | %12.1f %10.1f %10.2f | %12.1f %10.1f %10.2f\n", name, fresh.requests,
+               stream.size(), freshNs / reqs, bytes / freshNs * 1e3, freshAllocs / reqs,
+               legacyNs / reqs, bytes / legacyNs * 1e3, legacyAllocs / reqs);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// H264 起始码扫描吞吐的微基准：比较 findStartCode（SIMD）、findStartCodeScalar 和原来 H264FileReader 的做法
+// （ifstream 逐字节 read + push_back + 尾部检查起始码 + seekg 回退）。
+// 不给文件时生成一段随机的裸 H264 码流（已做防竞争处理，只在 NALU 边界出现起始码）。
+// 旧实现太慢，只在前 legacyMB 上跑，三者在这段前缀上的 NALU 个数和总字节数必须一致。
+// 用法：make bench && ./bench/startcode_bench [流大小 MB，默认 300] [旧实现扫描 MB，默认 16] [xxx.h264]
+#include "media/StartCodeScanner.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 生成 size 字节左右的码流：起始码随机取 3/4 字节，NALU 长度 200B ~ 40KB
+static std::vector<uint8_t> makeStream(size_t size) {
+    std::vector<uint8_t> out;
+    out.reserve(size + 64 * 1024);
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    };
+    static const uint8_t types[] = {0x67, 0x68, 0x65, 0x41, 0x41, 0x41, 0x41, 0x41};
+    size_t n = 0;
+    while (out.size() < size) {
+        if (next() & 1) {
+            out.push_back(0);
+        }
+        out.push_back(0);
+        out.push_back(0);
+        out.push_back(1);
+        out.push_back(types[n++ % 8]);
+        size_t len = 200 + next() % (40 * 1024);
+        for (size_t i = 0; i < len; ++i) {
+            uint8_t b = uint8_t(next());
+            // 防竞争：连续两个 0 之后不能出现 0~3
+            size_t sz = out.size();
+            if (b <= 3 && out[sz - 1] == 0 && out[sz - 2] == 0) {
+                out.push_back(3);
+            }
+            out.push_back(b);
+        }
+        // NALU 不以 0 结尾
+        if (out.back() == 0) {
+            out.back() = 0x80;
+        }
+    }
+    return out;
+}
+
+struct Result {
+    size_t nalus = 0;
+    uint64_t bytes = 0;     // NALU 内容字节数之和，不含起始码
+};
+
+// 和 MediaSource 建索引的循环一致
+static Result scan(const uint8_t* data, size_t size, const uint8_t* (*find)(const uint8_t*, const uint8_t*)) {
+    Result r;
+    const uint8_t* end = data + size;
+    const uint8_t* sc = find(data, end);
+    while (sc != end) {
+        const uint8_t* nalStart = sc + 3;
+        sc = find(nalStart, end);
+        const uint8_t* nalEnd = sc;
+        if (sc != end && sc > nalStart && sc[-1] == 0x00) {
+            --nalEnd;
+        }
+        if (nalEnd > nalStart) {
+            ++r.nalus;
+            r.bytes += nalEnd - nalStart;
+        }
+    }
+    return r;
+}
+
+static bool isStartCode(const uint8_t* p, size_t len) {
+    return (len >= 4 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x01) ||
+           (len >= 3 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x01);
+}
+
+// 原来的 H264FileReader::readFrame，逐个 NALU 读到文件末尾
+static Result scanLegacy(const std::string& path) {
+    Result r;
+    std::ifstream file(path.c_str(), std::ios::binary);
+    for (;;) {
+        std::vector<uint8_t> buffer;
+        uint8_t byte;
+        while (file.read((char*)&byte, 1)) {
+            buffer.push_back(byte);
+            if (isStartCode(buffer.data(), buffer.size())) {
+                buffer.clear();
+                break;
+            }
+        }
+        while (file.read((char*)&byte, 1)) {
+            buffer.push_back(byte);
+            size_t sz = buffer.size();
+            if ((sz >= 4 && isStartCode(&buffer[sz - 4], 4)) ||
+                (sz >= 3 && isStartCode(&buffer[sz - 3], 3))) {
+                size_t codeLen = (sz >= 4 && isStartCode(&buffer[sz - 4], 4)) ? 4 : 3;
+                buffer.resize(sz - codeLen);
+                file.seekg(-static_cast<int>(codeLen), std::ios::cur);
+                break;
+            }
+        }
+        if (buffer.empty()) {
+            break;
+        }
+        ++r.nalus;
+        r.bytes += buffer.size();
+    }
+    return r;
+}
+
+template <typename F>
+static double timed(F f) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+static void report(const char* name, const Result& r, size_t size, double ns) {
+    printf("%-10s %10zu %12.1f %12.2f %10.1f\n", name, r.nalus, size / 1048576.0, r.nalus / ns * 1e6,
+           size / ns * 1e3);
+}
+
+int main(int argc, char* argv[]) {
+    size_t mb = argc > 1 ? strtoul(argv[1], nullptr, 10) : 300;
+    size_t legacyMb = argc > 2 ? strtoul(argv[2], nullptr, 10) : 16;
+    std::vector<uint8_t> stream;
+    if (argc > 3) {
+        std::ifstream in(argv[3], std::ios::binary);
+        if (!in) {
+            fprintf(stderr, "cannot read %s\n", argv[3]);
+            return 1;
+        }
+        stream.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    } else {
+        stream = makeStream(mb * 1048576);
+    }
+
+    // 旧实现要读文件：取一段以起始码开头的前缀写到临时文件
+    size_t prefix = stream.size();
+    if (legacyMb * 1048576 < prefix) {
+        const uint8_t* end = stream.data() + stream.size();
+        const uint8_t* sc = findStartCodeScalar(stream.data() + legacyMb * 1048576, end);
+        prefix = sc - stream.data();
+        if (sc != end && prefix > 0 && sc[-1] == 0x00) {
+            --prefix;
+        }
+    }
+    char tmpPath[] = "/tmp/startcode_bench_XXXXXX";
+    int fd = mkstemp(tmpPath);
+    if (fd < 0 || write(fd, stream.data(), prefix) != ssize_t(prefix)) {
+        fprintf(stderr, "cannot write %s\n", tmpPath);
+        return 1;
+    }
+    close(fd);
+
+    Result simd, scalar, simdPrefix, scalarPrefix, legacy;
+    double simdNs = timed([&]() { simd = scan(stream.data(), stream.size(), findStartCode); });
+    double scalarNs = timed([&]() { scalar = scan(stream.data(), stream.size(), findStartCodeScalar); });
+    double legacyNs = timed([&]() { legacy = scanLegacy(tmpPath); });
+    unlink(tmpPath);
+    simdPrefix = scan(stream.data(), prefix, findStartCode);
+    scalarPrefix = scan(stream.data(), prefix, findStartCodeScalar);
+
+    printf("%-10s %10s %12s %12s %10s\n", "scanner", "nalus", "MB", "kNALUs/s", "MB/s");
+    report("simd", simd, stream.size(), simdNs);
+    report("scalar", scalar, stream.size(), scalarNs);
+    report("ifstream", legacy, prefix, legacyNs);
+
+    bool ok = simd.nalus == scalar.nalus && simd.bytes == scalar.bytes &&
+              simdPrefix.nalus == legacy.nalus && simdPrefix.bytes == legacy.bytes &&
+              scalarPrefix.nalus == legacy.nalus && scalarPrefix.bytes == legacy.bytes;
+    if (!ok) {
+        fprintf(stderr, "results differ: simd %zu/%llu scalar %zu/%llu, prefix simd %zu/%llu ifstream %zu/%llu\n",
+                simd.nalus, (unsigned long long)simd.bytes, scalar.nalus, (unsigned long long)scalar.bytes,
+                simdPrefix.nalus, (unsigned long long)simdPrefix.bytes, legacy.nalus,
+                (unsigned long long)legacy.bytes);
+        return 1;
+    }
+    return 0;
+}
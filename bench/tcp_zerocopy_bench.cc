@@ -0,0 +1,265 @@
+// RTSP/TCP interleaved 发送的 MSG_ZEROCOPY 微基准：按 TcpConnection::flushSendChain 的做法
+// （每个 RTP 包一块独立缓冲区，最多 64 个 iovec 一次 sendmsg，单次不少于 16KB 才加 MSG_ZEROCOPY，错误队列收割完成通知），
+// 在几档码率下比较普通拷贝和零拷贝的发送线程 CPU、实际码率，以及完成通知里被内核改成拷贝的比例。
+// 每 40ms 发一帧；码率 0 表示不限速，每帧 1MB 连续发。
+// 注意：环回上内核最终总要把数据拷给本机的接收套接字，完成通知会带 COPIED 标记（TcpConnection 见到后自动关掉零拷贝），
+// 这里的零拷贝数字只反映钉页和通知的额外开销；要看真实收益，给出另一台机器上的接收端（如 nc -l 9000 > /dev/null）。
+// 用法：make bench && ./bench/tcp_zerocopy_bench [每档秒数，默认 2] [码率列表 Mbit/s，默认 20,100,400,0] [ip:port]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+static const size_t kPacketSize = 4 + 12 + 1400;   // interleaved 前缀 + RTP 头 + 载荷
+static const size_t kMaxSendIov = 64;
+static const size_t kZeroCopyMinBytes = 16 * 1024;
+static const int kFrameMs = 40;
+
+static double threadCpuSeconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// 环回的接收端：读到对端关闭为止
+class Sink {
+public:
+    Sink() {
+        _listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_listenFd, (struct sockaddr*)&addr, sizeof(addr));
+        ::listen(_listenFd, 16);
+        socklen_t len = sizeof(_addr);
+        getsockname(_listenFd, (struct sockaddr*)&_addr, &len);
+        _thread = std::thread(&Sink::run, this);
+    }
+    ~Sink() {
+        _stop = true;
+        // 连一下让 accept 返回
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ::connect(fd, (struct sockaddr*)&_addr, sizeof(_addr));
+        ::close(fd);
+        _thread.join();
+        ::close(_listenFd);
+    }
+    const struct sockaddr_in& address() const { return _addr; }
+
+private:
+    void run() {
+        std::vector<char> buffer(1 << 20);
+        while (!_stop) {
+            int fd = ::accept(_listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            while (::read(fd, buffer.data(), buffer.size()) > 0) {
+            }
+            ::close(fd);
+        }
+    }
+
+    int _listenFd;
+    struct sockaddr_in _addr;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+};
+
+struct Result {
+    uint64_t bytes = 0;
+    double seconds = 0;
+    double cpu = 0;
+    uint64_t zcCalls = 0;       // 带 MSG_ZEROCOPY 的 sendmsg 次数
+    uint64_t completed = 0;     // 收到完成通知的调用数
+    uint64_t copied = 0;        // 其中被内核改成拷贝的调用数
+    uint64_t maxInFlight = 0;   // 同时未完成的零拷贝调用数峰值（对应 TcpConnection 钉住的缓冲区）
+};
+
+// 收割错误队列里的完成通知
+static void reapCompletions(int fd, Result& r) {
+    for (;;) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return;
+        }
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)) {
+                continue;
+            }
+            const struct sock_extended_err* err = (const struct sock_extended_err*)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            uint64_t calls = err->ee_data - err->ee_info + 1;   // 通知覆盖 [ee_info, ee_data] 这些调用
+            r.completed += calls;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                r.copied += calls;
+            }
+        }
+    }
+}
+
+static Result run(const struct sockaddr_in& peer, bool zeroCopy, int mbps, int seconds,
+                  const std::vector<std::vector<char>>& packets) {
+    Result r;
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (::connect(fd, (const struct sockaddr*)&peer, sizeof(peer)) < 0) {
+        perror("connect");
+        ::close(fd);
+        return r;
+    }
+    if (zeroCopy && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        perror("SO_ZEROCOPY");
+        zeroCopy = false;
+    }
+
+    size_t frameBytes = mbps > 0 ? size_t(mbps) * 1000000 / 8 * kFrameMs / 1000 : 1 << 20;
+    size_t framePackets = (frameBytes + kPacketSize - 1) / kPacketSize;
+    size_t next = 0;
+    struct iovec iov[kMaxSendIov];
+    double cpu0 = threadCpuSeconds();
+    auto t0 = std::chrono::steady_clock::now();
+    auto deadline = t0 + std::chrono::seconds(seconds);
+    auto due = t0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        for (size_t sent = 0; sent < framePackets;) {
+            size_t n = std::min(kMaxSendIov, framePackets - sent);
+            for (size_t i = 0; i < n; ++i) {
+                const std::vector<char>& packet = packets[next++ % packets.size()];
+                iov[i].iov_base = const_cast<char*>(packet.data());
+                iov[i].iov_len = packet.size();
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            bool zc = zeroCopy && n * kPacketSize >= kZeroCopyMinBytes;
+            // 阻塞套接字，一次写完整批；ENOBUFS（钉页超出 optmem）时和 TcpConnection 一样这一批退回拷贝
+            ssize_t ret = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (zc ? MSG_ZEROCOPY : 0));
+            if (ret < 0 && zc && errno == ENOBUFS) {
+                zc = false;
+                ret = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+            }
+            if (ret < 0) {
+                perror("sendmsg");
+                break;
+            }
+            r.bytes += ret;
+            sent += n;
+            if (zc) {
+                ++r.zcCalls;
+                r.maxInFlight = std::max(r.maxInFlight, r.zcCalls - r.completed);
+                reapCompletions(fd, r);
+            }
+        }
+        if (mbps > 0) {
+            due += std::chrono::milliseconds(kFrameMs);
+            std::this_thread::sleep_until(due);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    // 剩下的通知稍后才到，收割完再统计
+    for (int i = 0; i < 50 && r.completed < r.zcCalls; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        reapCompletions(fd, r);
+    }
+    r.cpu = threadCpuSeconds() - cpu0;
+    r.seconds = std::chrono::duration<double>(t1 - t0).count();
+    ::close(fd);
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 2;
+    std::string list = argc > 2 ? argv[2] : "20,100,400,0";
+    std::vector<int> rates;
+    for (size_t pos = 0; pos < list.size();) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        rates.push_back(atoi(list.substr(pos, comma - pos).c_str()));
+        pos = comma + 1;
+    }
+    if (seconds <= 0 || rates.empty()) {
+        fprintf(stderr, "usage: %s [seconds] [mbps,mbps,...] [ip:port]\n", argv[0]);
+        return 1;
+    }
+
+    // 缓冲区池：和 PacketBuffer 一样每包一块，循环复用；块数远多于同时在途的包数，零拷贝期间不会被改写
+    std::vector<std::vector<char>> packets(4096);
+    for (size_t i = 0; i < packets.size(); ++i) {
+        packets[i].assign(kPacketSize, char(i));
+        packets[i][0] = '$';
+    }
+
+    std::unique_ptr<Sink> sink;
+    struct sockaddr_in peer;
+    if (argc > 3) {
+        std::string target = argv[3];
+        size_t colon = target.rfind(':');
+        memset(&peer, 0, sizeof(peer));
+        peer.sin_family = AF_INET;
+        if (colon == std::string::npos ||
+            inet_pton(AF_INET, target.substr(0, colon).c_str(), &peer.sin_addr) != 1) {
+            fprintf(stderr, "bad target %s, expected ip:port\n", argv[3]);
+            return 1;
+        }
+        peer.sin_port = htons((unsigned short)atoi(target.c_str() + colon + 1));
+    } else {
+        sink.reset(new Sink());
+        peer = sink->address();
+    }
+
+    printf("%s, %d s per run, %zu-byte interleaved packets, zerocopy for sends >= %zu bytes\n",
+           sink ? "loopback" : argv[3], seconds, kPacketSize, kZeroCopyMinBytes);
+    printf("%-7s %-9s %10s %8s %12s %10s %9s %10s\n", "target", "mode", "Mbit/s", "cpu", "cpu s/Gbit",
+           "zc calls", "copied", "in flight");
+    for (int mbps : rates) {
+        for (int mode = 0; mode < 2; ++mode) {
+            Result r = run(peer, mode == 1, mbps, seconds, packets);
+            double gbits = r.bytes * 8 / 1e9;
+            char target[16];
+            snprintf(target, sizeof(target), mbps > 0 ? "%d" : "max", mbps);
+            printf("%-7s %-9s %10.1f %7.1f%% %12.3f %10llu %8.1f%% %10llu\n", target, mode ? "zerocopy" : "copy",
+                   r.seconds > 0 ? gbits * 1000 / r.seconds : 0.0, r.seconds > 0 ? r.cpu * 100 / r.seconds : 0.0,
+                   gbits > 0 ? r.cpu / gbits : 0.0, (unsigned long long)r.zcCalls,
+                   r.completed ? r.copied * 100.0 / r.completed : 0.0, (unsigned long long)r.maxInFlight);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+// 定时器微基准：1 万个并发周期定时器下比较时间轮 TimerManager 和原来按 id 排序的 std::map 实现。
+// 第一部分测 add/remove 的单次耗时（remove 按随机顺序）；
+// 第二部分在真实的 timerfd + poll 循环里跑若干秒，统计回调次数（与理论次数之比）、
+// 相邻两次回调间隔偏离周期的分布和 CPU 占用。周期按参数轮流分配给各个定时器。
+// 用法：make bench && ./bench/timer_bench [定时器数，默认 10000] [运行秒数，默认 3] [周期列表 ms，默认 1,20,40]
+#include "reactor/TimerManager.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static uint64_t nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t nowMs() {
+    return nowUs() / 1000;
+}
+
+// 原来的 TimerManager：std::map 按 id 排序，timerfd 按最小 id 的到期时间设置，每次增删都重设 timerfd
+class LegacyTimers {
+public:
+    using TimerCallback = std::function<void()>;
+    using TimerId = uint64_t;
+
+    LegacyTimers() : _timerfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {}
+    ~LegacyTimers() { close(_timerfd); }
+
+    TimerId addPeriodicTimer(int delayMs, int intervalMs, TimerCallback&& cb) {
+        TimerId timerId = _nextId++;
+        _timers.emplace(timerId, std::make_pair(nowMs() + delayMs, Timer{intervalMs, std::move(cb)}));
+        resetTimerfd();
+        return timerId;
+    }
+
+    void removeTimer(TimerId timerId) {
+        auto it = _timers.find(timerId);
+        if (it != _timers.end()) {
+            _timers.erase(it);
+            resetTimerfd();
+        }
+    }
+
+    int getTimerFd() const { return _timerfd; }
+
+    void handleRead() {
+        uint64_t expirations;
+        ssize_t ret = ::read(_timerfd, &expirations, sizeof(expirations));
+        (void)ret;
+        uint64_t now = nowMs();
+        std::vector<std::pair<TimerId, Timer>> expired;
+        for (auto it = _timers.begin(); it != _timers.end() && it->second.first <= now;) {
+            expired.push_back({it->first, it->second.second});
+            it = _timers.erase(it);
+        }
+        for (auto& pair : expired) {
+            if (pair.second.callback) pair.second.callback();
+            if (pair.second.interval > 0) {
+                _timers.emplace(pair.first, std::make_pair(now + pair.second.interval, pair.second));
+            }
+        }
+        resetTimerfd();
+    }
+
+private:
+    struct Timer {
+        int interval;
+        TimerCallback callback;
+    };
+
+    void resetTimerfd() {
+        itimerspec spec{};
+        if (!_timers.empty()) {
+            uint64_t nextExpire = _timers.begin()->second.first;
+            uint64_t now = nowMs();
+            uint64_t diffMs = (nextExpire > now) ? (nextExpire - now) : 1;
+            spec.it_value.tv_sec = diffMs / 1000;
+            spec.it_value.tv_nsec = (diffMs % 1000) * 1000000;
+        }
+        timerfd_settime(_timerfd, 0, &spec, nullptr);
+    }
+
+    int _timerfd;
+    std::map<TimerId, std::pair<uint64_t, Timer>> _timers;
+    TimerId _nextId = 1;
+};
+
+// 每个定时器的回调记录：次数和相邻两次回调的间隔偏差（0.1ms 一格，最后一格收容所有更大的值）
+static const int kJitterBuckets = 1001;
+
+struct Stats {
+    uint64_t fires = 0;
+    uint64_t expected = 0;
+    std::vector<uint64_t> jitter = std::vector<uint64_t>(kJitterBuckets, 0);
+
+    void record(uint64_t gapUs, int intervalMs) {
+        ++fires;
+        int64_t diff = int64_t(gapUs) - int64_t(intervalMs) * 1000;
+        if (diff < 0) diff = -diff;
+        jitter[std::min<int64_t>(diff / 100, kJitterBuckets - 1)]++;
+    }
+    double percentileMs(double p) const {
+        uint64_t total = 0;
+        for (uint64_t n : jitter) total += n;
+        uint64_t want = std::min<uint64_t>(uint64_t(total * p), total ? total - 1 : 0), seen = 0;
+        for (int i = 0; i < kJitterBuckets; ++i) {
+            seen += jitter[i];
+            if (seen > want) return i / 10.0;
+        }
+        return (kJitterBuckets - 1) / 10.0;
+    }
+};
+
+struct Probe {
+    Stats* stats;
+    int interval;
+    uint64_t last;
+};
+
+static double cpuSeconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// 增删耗时：加满 count 个，再按随机顺序全部删除
+template <typename Timers>
+static void addRemove(size_t count, double& addNs, double& removeNs) {
+    Timers timers;
+    std::vector<uint64_t> ids;
+    ids.reserve(count);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        ids.push_back(timers.addPeriodicTimer(1000 + int(i % 1000), 1000, []() {}));
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    uint32_t seed = 7;
+    for (size_t i = ids.size(); i > 1; --i) {
+        seed = seed * 1103515245 + 12345;
+        std::swap(ids[i - 1], ids[(seed >> 8) % i]);
+    }
+    for (uint64_t id : ids) {
+        timers.removeTimer(id);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    addNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / count;
+    removeNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / count;
+}
+
+// 真实运行：poll 等 timerfd，可读时交给定时器处理
+template <typename Timers>
+static void runLoop(size_t count, int seconds, const std::vector<int>& intervals, Stats& stats, double& cpu) {
+    Timers timers;
+    std::vector<Probe> probes(count);
+    uint64_t start = nowUs();
+    for (size_t i = 0; i < count; ++i) {
+        Probe& probe = probes[i];
+        probe.stats = &stats;
+        probe.interval = intervals[i % intervals.size()];
+        probe.last = start;
+        Probe* p = &probe;
+        timers.addPeriodicTimer(probe.interval, probe.interval, [p]() {
+            uint64_t now = nowUs();
+            p->stats->record(now - p->last, p->interval);
+            p->last = now;
+        });
+        stats.expected += seconds * 1000 / probe.interval;
+    }
+    double cpu0 = cpuSeconds();
+    uint64_t deadline = start + seconds * 1000000ULL;
+    struct pollfd pfd = {timers.getTimerFd(), POLLIN, 0};
+    for (uint64_t now = nowUs(); now < deadline; now = nowUs()) {
+        pfd.revents = 0;
+        int ret = poll(&pfd, 1, int((deadline - now) / 1000) + 1);
+        if (ret > 0 && (pfd.revents & POLLIN)) {
+            timers.handleRead();
+        }
+    }
+    cpu = cpuSeconds() - cpu0;
+}
+
+template <typename Timers>
+static void bench(const char* name, size_t count, int seconds, const std::vector<int>& intervals) {
+    double addNs = 0, removeNs = 0, cpu = 0;
+    Stats stats;
+    addRemove<Timers>(count, addNs, removeNs);
+    runLoop<Timers>(count, seconds, intervals, stats, cpu);
+    printf("%-8s %10.1f %10.1f %12llu %8.1f%% %8.1f %8.1f %8.1f %8.1f%%\n", name, addNs, removeNs,
+           (unsigned long long)stats.fires, stats.expected ? stats.fires * 100.0 / stats.expected : 0.0,
+           stats.percentileMs(0.5), stats.percentileMs(0.99), stats.percentileMs(1.0), cpu * 100.0 / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    std::vector<int> intervals;
+    std::string list = argc > 3 ? argv[3] : "1,20,40";
+    for (size_t pos = 0; pos < list.size();) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        int interval = atoi(list.substr(pos, comma - pos).c_str());
+        if (interval > 0) intervals.push_back(interval);
+        pos = comma + 1;
+    }
+    if (count == 0 || seconds <= 0 || intervals.empty()) {
+        fprintf(stderr, "usage: %s [timers] [seconds] [interval,interval,...]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu periodic timers, intervals %s ms, %d s run\n", count, list.c_str(), seconds);
+    printf("%-8s %10s %10s %12s %9s %8s %8s %8s %9s\n", "impl", "add ns", "remove ns", "fires", "of ideal",
+           "p50 ms", "p99 ms", "max ms", "cpu");
+    bench<TimerManager>("wheel", count, seconds, intervals);
+    bench<LegacyTimers>("map", count, seconds, intervals);
+    return 0;
+}
@@ -0,0 +1,199 @@
+// 内核辅助发送节奏的环回测试：每 40ms 把一帧的 RTP 包用一次 sendmmsg 交给内核，
+// 接收线程用 SO_TIMESTAMPNS 取每个包到达本机协议栈的时间，统计帧内相邻包的间隔分布和整帧铺开的时长。
+// 三种方式：突发（原来的行为）、SO_TXTIME 把一帧铺开在 40ms 内（RtpPusher 的 kVideoSpreadNs）、SO_MAX_PACING_RATE 限速。
+// 两种内核机制都只在出口挂 fq 队列规则时生效；lo 默认是 noqueue，三种方式的结果会一样。
+// 先 tc qdisc replace dev lo root fq（测完 tc qdisc del dev lo root 恢复）再运行才能看到区别。
+// 用法：make bench && ./bench/udp_pacing_bench [每种方式运行秒数，默认 3] [每帧包数，默认 30] [包大小，默认 1200]
+#include "reactor/UdpSocket.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+static const int kFrameMs = 40;
+static const uint64_t kSpreadNs = kFrameMs * 1000 * 1000ull;
+
+// 接收线程：按帧号（载荷前 4 字节）把内核收包时间戳分组
+class Receiver {
+public:
+    Receiver() : _socket(::socket(AF_INET, SOCK_DGRAM, 0)) {
+        int on = 1;
+        setsockopt(_socket.fd(), SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+        int size = 8 * 1024 * 1024;
+        setsockopt(_socket.fd(), SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        struct timeval tv = {0, 100 * 1000};
+        setsockopt(_socket.fd(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        InetAddress addr("127.0.0.1", 0);
+        ::bind(_socket.fd(), (const struct sockaddr*)addr.getInetAddrPtr(), sizeof(struct sockaddr_in));
+        _thread = std::thread(&Receiver::run, this);
+    }
+    ~Receiver() {
+        _stop = true;
+        _thread.join();
+    }
+
+    InetAddress address() const {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        getsockname(_socket.fd(), (struct sockaddr*)&addr, &len);
+        return InetAddress(addr);
+    }
+    // 取走目前收到的 (帧号, 到达时间 ns)
+    std::vector<std::pair<uint32_t, uint64_t>> take() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<std::pair<uint32_t, uint64_t>> out;
+        out.swap(_arrivals);
+        return out;
+    }
+
+private:
+    void run() {
+        char buffer[2048];
+        char control[CMSG_SPACE(sizeof(struct timespec))];
+        while (!_stop) {
+            struct iovec iov = {buffer, sizeof(buffer)};
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            ssize_t n = ::recvmsg(_socket.fd(), &msg, 0);
+            if (n < 4) {
+                continue;
+            }
+            uint64_t ns = 0;
+            for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+                    ns = uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+                }
+            }
+            uint32_t frame;
+            memcpy(&frame, buffer, sizeof(frame));
+            std::lock_guard<std::mutex> lock(_mutex);
+            _arrivals.push_back(std::make_pair(frame, ns));
+        }
+    }
+
+    UdpSocket _socket;
+    std::thread _thread;
+    std::atomic<bool> _stop{false};
+    std::mutex _mutex;
+    std::vector<std::pair<uint32_t, uint64_t>> _arrivals;
+};
+
+enum Mode { kBurst, kTxTime, kPacingRate };
+
+struct Result {
+    bool applied = true;            // 套接字选项是否设置成功
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    std::vector<uint64_t> gaps;     // 帧内相邻包的到达间隔（ns）
+    std::vector<uint64_t> spreads;  // 每帧第一个包到最后一个包（ns）
+};
+
+static uint64_t percentile(std::vector<uint64_t>& v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t k = std::min(v.size() - 1, size_t(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static Result run(Mode mode, Receiver& receiver, int seconds, size_t packets, size_t packetSize) {
+    Result r;
+    UdpSocket socket(::socket(AF_INET, SOCK_DGRAM, 0));
+    int size = 8 * 1024 * 1024;
+    setsockopt(socket.fd(), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    uint64_t spread = 0;
+    if (mode == kTxTime) {
+        r.applied = socket.setTxTime(true);
+        spread = kSpreadNs;
+    } else if (mode == kPacingRate) {
+        // 比一帧的平均码率略高，帧能在下一帧之前发完
+        r.applied = socket.setMaxPacingRate(uint32_t(packets * packetSize * 1000 / kFrameMs * 5 / 4));
+    }
+    InetAddress peer = receiver.address();
+
+    std::vector<std::vector<char>> frame(packets, std::vector<char>(packetSize, 0x5a));
+    std::vector<struct iovec> iovs(packets);
+    receiver.take();
+    auto t0 = std::chrono::steady_clock::now();
+    auto due = t0;
+    uint32_t frames = uint32_t(seconds * 1000 / kFrameMs);
+    for (uint32_t f = 0; f < frames; ++f) {
+        for (size_t i = 0; i < packets; ++i) {
+            memcpy(frame[i].data(), &f, sizeof(f));
+            iovs[i].iov_base = frame[i].data();
+            iovs[i].iov_len = frame[i].size();
+        }
+        size_t done = 0;
+        while (done < packets) {
+            int n = socket.sendmmsg(&iovs[done], packets - done, peer, done == 0 ? spread : 0);
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        r.sent += done;
+        due += std::chrono::milliseconds(kFrameMs);
+        std::this_thread::sleep_until(due);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * kFrameMs));
+
+    std::vector<std::pair<uint32_t, uint64_t>> arrivals = receiver.take();
+    r.received = arrivals.size();
+    size_t begin = 0;
+    for (size_t i = 1; i <= arrivals.size(); ++i) {
+        if (i == arrivals.size() || arrivals[i].first != arrivals[begin].first) {
+            for (size_t k = begin + 1; k < i; ++k) {
+                r.gaps.push_back(arrivals[k].second - arrivals[k - 1].second);
+            }
+            if (i - begin > 1) {
+                r.spreads.push_back(arrivals[i - 1].second - arrivals[begin].second);
+            }
+            begin = i;
+        }
+    }
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    size_t packets = argc > 2 ? strtoul(argv[2], nullptr, 10) : 30;
+    size_t packetSize = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1200;
+    if (seconds <= 0 || packets < 2 || packets > 64 || packetSize < 16 || packetSize > 1472) {
+        fprintf(stderr, "usage: %s [seconds] [packets per frame 2..64] [packet size 16..1472]\n", argv[0]);
+        return 1;
+    }
+
+    Receiver receiver;
+    printf("%zu x %zu-byte packets every %d ms over loopback, %d s per mode\n", packets, packetSize, kFrameMs,
+           seconds);
+    printf("%-8s %9s | %9s %9s %9s %9s | %12s %12s\n", "mode", "received", "gap p10", "gap p50", "gap p90",
+           "gap max", "frame p50", "frame max");
+    const char* names[] = {"burst", "txtime", "pacing"};
+    for (int mode = kBurst; mode <= kPacingRate; ++mode) {
+        Result r = run(Mode(mode), receiver, seconds, packets, packetSize);
+        if (!r.applied) {
+            printf("%-8s %9s\n", names[mode], "unsupported");
+            continue;
+        }
+        // 间隔以 us 显示，整帧时长以 ms 显示
+        printf("%-8s %8.1f%% | %9.1f %9.1f %9.1f %9.1f | %12.2f %12.2f\n", names[mode],
+               r.sent ? r.received * 100.0 / r.sent : 0.0, percentile(r.gaps, 0.1) / 1e3,
+               percentile(r.gaps, 0.5) / 1e3, percentile(r.gaps, 0.9) / 1e3, percentile(r.gaps, 1.0) / 1e3,
+               percentile(r.spreads, 0.5) / 1e6, percentile(r.spreads, 1.0) / 1e6);
+    }
+    return 0;
+}
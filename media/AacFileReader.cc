@@ -3,54 +3,51 @@
 #include <string.h>
 #include "../reactor/Logger.h"
 
-AacFileReader::AacFileReader(const std::string& filepath) {
-    _file.open(filepath, std::ios::binary);
+AacFileReader::AacFileReader(const std::string& filepath)
+:_source(MediaSource::open(filepath, MediaCodec::AAC))
+,_cursor(0)
+{
 }
 
 AacFileReader::~AacFileReader() {
-    if (_file.is_open()) {
-        _file.close();
-    }
 }
 
 ReadStatus AacFileReader::readFrame(std::vector<uint8_t>& outFrame) {
     outFrame.clear();
-    if (!_file.is_open()) {
+    if (!_source->isOpen()) {
         LOG_ERROR("Aac file open failed!");
         return ReadStatus::FileError;
     }
-
-    uint8_t header[7];
-    if (!_file.read(reinterpret_cast<char*>(header), 7)) {
-        if (_file.eof()) {
-            LOG_INFO("Aac file read eof!");
-            return ReadStatus::Eof;
-        }
-        return ReadStatus::FileError;
+    if (_cursor >= _source->frameCount()) {
+        LOG_INFO("Aac file read eof!");
+        return ReadStatus::Eof;
     }
 
-    // 校验 ADTS 同步头（12bit）
-    if (header[0] != 0xFF || (header[1] & 0xF0) != 0xF0) return ReadStatus::FileError;
-
-    // aac_frame_length: 13 bits: bits 30-42
-    uint16_t frameLength = ((header[3] & 0x03) << 11) |
-                           (header[4] << 3) |
-                           ((header[5] & 0xE0) >> 5);
-
-    if (frameLength < 7) return ReadStatus::FileError; // 长度不对
+    // ADTS 帧已在 MediaSource 建索引时校验过同步头和长度，包括 ADTS 头
+    const MediaFrame& frame = _source->frame(_cursor++);
+    const uint8_t* data = _source->frameData(frame);
+    outFrame.assign(data, data + frame.size);
+    return ReadStatus::Ok;
+}
 
-    outFrame.resize(frameLength);
-    ::memcpy(outFrame.data(), header, 7); // 包括 ADTS 头
-    if (!_file.read(reinterpret_cast<char*>(outFrame.data() + 7), frameLength - 7)) {
-        if (_file.eof()) {
-            LOG_INFO("Aac file read eof!");
-            outFrame.clear();
-            return ReadStatus::Eof;
-        }
-        LOG_DEBUG("Aac file read failed!");
-        outFrame.clear();
-        return ReadStatus::NoData;
+ReadStatus AacFileReader::readFrameIndex(size_t& outIndex) {
+    if (!_source->isOpen()) {
+        LOG_ERROR("Aac file open failed!");
+        return ReadStatus::FileError;
     }
-
+    if (_cursor >= _source->frameCount()) {
+        LOG_INFO("Aac file read eof!");
+        return ReadStatus::Eof;
+    }
+    outIndex = _cursor++;
     return ReadStatus::Ok;
-}
\ No newline at end of file
+}
+
+bool AacFileReader::seekFrame(size_t index) {
+    if (!_source->isOpen()) {
+        return false;
+    }
+    // 超出末尾时停在末尾，下一次读取返回 Eof
+    _cursor = index < _source->frameCount() ? index : _source->frameCount();
+    return true;
+}
@@ -2,18 +2,24 @@
 #define __AACFILEREADER_H__
 
 #include "MediaReader.h"
-#include <fstream>
+#include "MediaSource.h"
+#include <memory>
 #include <string>
 
+// AAC 读取游标：共享同一个 MediaSource，自身只保存当前帧下标
 class AacFileReader : public MediaReader {
 public:
     explicit AacFileReader(const std::string& filepath);
     ~AacFileReader();
 
     ReadStatus readFrame(std::vector<uint8_t>& outFrame) override;
+    ReadStatus readFrameIndex(size_t& outIndex) override;
+    bool seekFrame(size_t index) override;
+    std::shared_ptr<MediaSource> source() const override { return _source; }
 
 private:
-    std::ifstream _file;
+    std::shared_ptr<MediaSource> _source;
+    size_t _cursor;
 };
 
-#endif
\ No newline at end of file
+#endif
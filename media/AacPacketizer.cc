@@ -0,0 +1,92 @@
+#include "AacPacketizer.h"
+#include <string.h>
+
+static const int kAdtsSampleRates[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+bool parseAdtsConfig(const uint8_t* adts, size_t len, AacConfig& config) {
+    if (len < 7 || adts[0] != 0xFF || (adts[1] & 0xF0) != 0xF0) {
+        return false;
+    }
+    int profile = adts[2] >> 6;                 // ADTS profile = audioObjectType - 1
+    int srIndex = (adts[2] >> 2) & 0x0F;
+    int channels = ((adts[2] & 0x01) << 2) | (adts[3] >> 6);
+    if (srIndex >= int(sizeof(kAdtsSampleRates) / sizeof(kAdtsSampleRates[0]))) {
+        return false;
+    }
+    config.sampleRate = kAdtsSampleRates[srIndex];
+    config.channels = channels;
+    config.audioSpecificConfig = uint16_t(((profile + 1) << 11) | (srIndex << 7) | (channels << 3));
+    return true;
+}
+
+size_t adtsHeaderLength(const uint8_t* adts) {
+    return (adts[1] & 0x01) ? 7 : 9;
+}
+
+std::atomic<int> AacAggregator::_latencyBudgetMs{100};
+
+size_t AacAggregator::framesPerBudget(int sampleRate) {
+    uint64_t frames = uint64_t(_latencyBudgetMs) * 1000 / framesDurationUs(1, sampleRate);
+    return frames > 0 ? frames : 1;
+}
+
+AacAggregator::AacAggregator(size_t maxPayload)
+:_maxPayload(maxPayload)
+,_dataBytes(0)
+{
+}
+
+bool AacAggregator::auData(const uint8_t* adtsFrame, size_t len, const uint8_t*& au, size_t& auSize) {
+    if (len < 2) {
+        return false;
+    }
+    size_t headerLen = adtsHeaderLength(adtsFrame);
+    if (len <= headerLen || len - headerLen > kMaxAuSize) {
+        return false;
+    }
+    au = adtsFrame + headerLen;
+    auSize = len - headerLen;
+    return true;
+}
+
+bool AacAggregator::append(const uint8_t* adtsFrame, size_t len) {
+    const uint8_t* au = nullptr;
+    size_t auSize = 0;
+    if (!auData(adtsFrame, len, au, auSize) || payloadSize() + 2 + auSize > _maxPayload) {
+        return false;
+    }
+    _aus.emplace_back(au, uint16_t(auSize));
+    _dataBytes += auSize;
+    return true;
+}
+
+void AacAggregator::writeFragment(uint8_t* out, size_t auSize, const uint8_t* data, size_t len) {
+    out[0] = 0;
+    out[1] = 16;    // 一个 AU-header
+    out[2] = uint8_t(auSize >> 5);
+    out[3] = uint8_t((auSize & 0x1F) << 3);
+    ::memcpy(out + 4, data, len);
+}
+
+void AacAggregator::writePayload(uint8_t* out) const {
+    uint16_t headersBits = uint16_t(16 * _aus.size());
+    out[0] = headersBits >> 8;
+    out[1] = headersBits & 0xFF;
+    uint8_t* header = out + 2;
+    uint8_t* data = header + 2 * _aus.size();
+    for (const auto& au : _aus) {
+        // 13bit AU-size + 3bit AU-index(-delta)，连续的 AU 序号差为 0
+        header[0] = uint8_t(au.second >> 5);
+        header[1] = uint8_t((au.second & 0x1F) << 3);
+        header += 2;
+        ::memcpy(data, au.first, au.second);
+        data += au.second;
+    }
+}
+
+void AacAggregator::clear() {
+    _aus.clear();
+    _dataBytes = 0;
+}
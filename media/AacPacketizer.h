@@ -0,0 +1,73 @@
+#ifndef __AACPACKETIZER_H__
+#define __AACPACKETIZER_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// AAC 每帧固定 1024 个采样，RTP 时间戳时钟等于采样率
+static const uint32_t kAacSamplesPerFrame = 1024;
+
+// 从 ADTS 头解析出的音频参数，用于 SDP 的 rtpmap/fmtp
+struct AacConfig {
+    int sampleRate = 44100;
+    int channels = 2;
+    uint16_t audioSpecificConfig = 0x1210;  // AudioSpecificConfig: objectType(5) srIndex(4) channels(4) 000
+};
+
+// 解析 ADTS 头，非法时返回 false
+bool parseAdtsConfig(const uint8_t* adts, size_t len, AacConfig& config);
+// ADTS 头长度：protection_absent=1 时 7 字节，否则带 CRC 共 9 字节
+size_t adtsHeaderLength(const uint8_t* adts);
+
+/*
+RFC 3640 AAC-hbr 聚合打包（sizelength=13;indexlength=3;indexdeltalength=3）。
+去掉每帧的 ADTS 头，把多个 AU 放进同一个 RTP 包：
+AU-headers-length(16bit) + n 个 AU-header(13bit size + 3bit index/delta，均为 0) + n 个 AU 数据。
+单独一个 AU 也放不进一个包时按 RFC 3640 3.2.3 分片：每片都是 AU-headers-length + 一个 AU-header + 一段 AU 数据，
+AU-header 里的 AU-size 填整个 AU 的长度，各片时间戳相同，只有最后一片置 marker。
+*/
+class AacAggregator {
+public:
+    explicit AacAggregator(size_t maxPayload);
+
+    // 一个 RTP 包最多聚合多少毫秒的音频（同时受 MTU 限制），默认 100ms，设为 0 则每包一帧
+    static void setLatencyBudgetMs(int ms) { _latencyBudgetMs = ms; }
+    // 按延迟预算，给定采样率下每次最多取多少帧来聚合
+    static size_t framesPerBudget(int sampleRate);
+    // n 帧对应的时长（微秒）
+    static uint64_t framesDurationUs(size_t frames, int sampleRate) {
+        return uint64_t(frames) * kAacSamplesPerFrame * 1000000 / sampleRate;
+    }
+
+    // 加入一个 ADTS 帧；加入后载荷会超过 maxPayload 时不加入并返回 false，
+    // 这时先把已有的 AU 发出去再试，空聚合器仍放不下就用 fragmentData 分片
+    bool append(const uint8_t* adtsFrame, size_t len);
+
+    // 13bit AU-size 能表示的最大 AU，更大的帧无法按 RFC 3640 打包
+    static const size_t kMaxAuSize = 8191;
+    // 去掉 ADTS 头后的 AU，非法或超过 kMaxAuSize 时返回 false
+    static bool auData(const uint8_t* adtsFrame, size_t len, const uint8_t*& au, size_t& auSize);
+    // 分片时每片最多带多少字节 AU 数据
+    size_t maxFragmentData() const { return _maxPayload - 4; }
+    // 写一个分片的载荷（4 + len 字节）到 out，auSize 是整个 AU 的长度
+    static void writeFragment(uint8_t* out, size_t auSize, const uint8_t* data, size_t len);
+
+    size_t count() const { return _aus.size(); }
+    bool empty() const { return _aus.empty(); }
+    size_t payloadSize() const { return 2 + 2 * _aus.size() + _dataBytes; }
+    // 把载荷写到 out（至少 payloadSize() 字节）
+    void writePayload(uint8_t* out) const;
+    void clear();
+
+private:
+    size_t _maxPayload;
+    std::vector<std::pair<const uint8_t*, uint16_t>> _aus;  // 去掉 ADTS 头后的 AU 数据，长度不超过 kMaxAuSize
+    size_t _dataBytes;
+
+    static std::atomic<int> _latencyBudgetMs;
+};
+
+#endif
@@ -2,60 +2,50 @@
 #include <iostream>
 #include "../reactor/Logger.h"
 
-H264FileReader::H264FileReader(const std::string& filepath) {
-    _file.open(filepath, std::ios::binary);
+H264FileReader::H264FileReader(const std::string& filepath)
+:_source(MediaSource::open(filepath, MediaCodec::H264))
+,_cursor(0)
+{
 }
 
 H264FileReader::~H264FileReader() {
-    if (_file.is_open()) {
-        _file.close();
-    }
-}
-
-bool H264FileReader::isStartCode(const uint8_t* p, size_t len) {
-    return (len >= 4 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x00 && p[3] == 0x01) ||
-           (len >= 3 && p[0] == 0x00 && p[1] == 0x00 && p[2] == 0x01);
 }
 
 ReadStatus H264FileReader::readFrame(std::vector<uint8_t>& outFrame) {
-    if (!_file.is_open()){
+    if (!_source->isOpen()){
         LOG_ERROR("H.264 file open failed!");
         return ReadStatus::FileError;
     }
+    if (_cursor >= _source->frameCount()) {
+        LOG_INFO("H.264 file read eof!");
+        return ReadStatus::Eof;
+    }
 
-    std::vector<uint8_t> buffer;
-    uint8_t byte;
+    // NALU 边界已在 MediaSource 建索引时确定，这里只需按下标取出
+    const MediaFrame& frame = _source->frame(_cursor++);
+    const uint8_t* data = _source->frameData(frame);
+    outFrame.assign(data, data + frame.size);
+    return ReadStatus::Ok;
+}
 
-    // 跳过文件开头的起始码
-    while (_file.read((char*)&byte, 1)) {
-        buffer.push_back(byte);
-        if (isStartCode(buffer.data(), buffer.size())) {
-            buffer.clear();
-            break;
-        }
+ReadStatus H264FileReader::readFrameIndex(size_t& outIndex) {
+    if (!_source->isOpen()) {
+        LOG_ERROR("H.264 file open failed!");
+        return ReadStatus::FileError;
     }
-
-    // 读取NALU内容，直到下一个起始码
-    while (_file.read((char*)&byte, 1)) {
-        buffer.push_back(byte);
-        size_t sz = buffer.size();
-        if ((sz >= 4 && isStartCode(&buffer[sz - 4], 4)) ||
-            (sz >= 3 && isStartCode(&buffer[sz - 3], 3))) {
-            size_t codeLen = (sz >= 4 && isStartCode(&buffer[sz - 4], 4)) ? 4 : 3;
-            buffer.resize(sz - codeLen);
-            _file.seekg(-static_cast<int>(codeLen), std::ios::cur);
-            break;
-        }
+    if (_cursor >= _source->frameCount()) {
+        LOG_INFO("H.264 file read eof!");
+        return ReadStatus::Eof;
     }
+    outIndex = _cursor++;
+    return ReadStatus::Ok;
+}
 
-    if (buffer.empty()) {
-        if (_file.eof()) {
-            LOG_INFO("H.264 file read eof!");
-            return ReadStatus::Eof;
-        }
-        LOG_DEBUG("H.264 file read failed!");
-        return ReadStatus::NoData;
+bool H264FileReader::seekFrame(size_t index) {
+    if (!_source->isOpen()) {
+        return false;
     }
-    outFrame = std::move(buffer);
-    return ReadStatus::Ok;
-}
\ No newline at end of file
+    // 超出末尾时停在末尾，下一次读取返回 Eof
+    _cursor = index < _source->frameCount() ? index : _source->frameCount();
+    return true;
+}
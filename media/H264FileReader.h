@@ -2,21 +2,25 @@
 #define __H264FILEREADER_H__
 
 #include "MediaReader.h"
-#include <fstream>
+#include "MediaSource.h"
+#include <memory>
 #include <string>
 
+// H264 读取游标：共享同一个 MediaSource，自身只保存当前帧下标
 class H264FileReader : public MediaReader {
 public:
     explicit H264FileReader(const std::string& filepath);
     ~H264FileReader();
 
     ReadStatus readFrame(std::vector<uint8_t>& outFrame) override;
+    ReadStatus readFrameIndex(size_t& outIndex) override;
+    bool seekFrame(size_t index) override;
+    std::shared_ptr<MediaSource> source() const override { return _source; }
 
 private:
-    std::ifstream _file;
-    bool isStartCode(const uint8_t* p,size_t len);
-
+    std::shared_ptr<MediaSource> _source;
+    size_t _cursor;
 };
 
 
-#endif
\ No newline at end of file
+#endif
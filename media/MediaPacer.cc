@@ -0,0 +1,114 @@
+#include "MediaPacer.h"
+#include "../reactor/Logger.h"
+
+using namespace std::chrono;
+
+std::map<EventLoop*, std::unique_ptr<MediaPacer>> MediaPacer::_registry;
+std::mutex MediaPacer::_registryMutex;
+
+MediaPacer& MediaPacer::forLoop(EventLoop* loop) {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    std::unique_ptr<MediaPacer>& pacer = _registry[loop];
+    if (!pacer) {
+        pacer.reset(new MediaPacer(loop));
+    }
+    return *pacer;
+}
+
+MediaPacer::MediaPacer(EventLoop* loop)
+:_loop(loop)
+,_timerId(0)
+{
+    LOG_INFO("MediaPacer created for loop %p", loop);
+}
+
+void MediaPacer::schedule(const std::shared_ptr<PacedStream>& stream, Clock::time_point due) {
+    const PacedStream* key = stream.get();
+    auto it = _entries.find(key);
+    if (it == _entries.end()) {
+        it = _entries.emplace(key, Entry{stream, due, false}).first;
+    } else {
+        it->second.stream = stream;
+    }
+    enqueue(key, it->second, due);
+    arm();
+}
+
+void MediaPacer::cancel(const PacedStream* stream) {
+    auto it = _entries.find(stream);
+    if (it == _entries.end()) {
+        return;
+    }
+    if (it->second.queued) {
+        _queue.erase(DueKey(it->second.due, stream));
+    }
+    _entries.erase(it);
+    // 不在这里重设定时器，最早的会话被取消时最多多一次空唤醒
+}
+
+void MediaPacer::enqueue(const PacedStream* key, Entry& entry, Clock::time_point due) {
+    if (entry.queued) {
+        _queue.erase(DueKey(entry.due, key));
+    }
+    entry.due = due;
+    entry.queued = true;
+    _queue.insert(DueKey(due, key));
+}
+
+void MediaPacer::onTimer() {
+    _timerId = 0;
+    // TimerManager 按毫秒取整，可能比最早的到期点早不到 1ms 被唤醒，这部分也算到期
+    Clock::time_point now = Clock::now() + milliseconds(1);
+
+    // 先把所有到期的会话摘出队列，处理过程中它们可以安全地被取消或重新安排
+    _due.clear();
+    while (!_queue.empty() && _queue.begin()->first <= now) {
+        const PacedStream* key = _queue.begin()->second;
+        _queue.erase(_queue.begin());
+        _entries[key].queued = false;
+        _due.push_back(key);
+    }
+
+    for (const PacedStream* key : _due) {
+        auto it = _entries.find(key);
+        if (it == _entries.end() || it->second.queued) {
+            continue;   // 已被取消，或者在本轮中被重新安排
+        }
+        auto stream = it->second.stream.lock();
+        Clock::time_point nextDue = now;
+        bool keep = stream && stream->onPace(now, nextDue);
+
+        // onPace 里可能取消或重新安排了自己，重新查找
+        it = _entries.find(key);
+        if (it == _entries.end() || it->second.queued) {
+            continue;
+        }
+        if (keep) {
+            enqueue(key, it->second, nextDue);
+        } else {
+            _entries.erase(it);
+        }
+    }
+    arm();
+}
+
+void MediaPacer::arm() {
+    if (_queue.empty()) {
+        return;     // 空闲时不保留定时器，已设置的那一次唤醒到期后自然结束
+    }
+    Clock::time_point due = _queue.begin()->first;
+    if (_timerId != 0) {
+        if (due >= _armedDue) {
+            return;
+        }
+        _loop->removeTimer(_timerId);
+        _timerId = 0;
+    }
+    // TimerManager 是毫秒精度，向上取整，保证被唤醒时最早的会话已经到期
+    auto wait = duration_cast<microseconds>(due - Clock::now()).count();
+    int delayMs = wait > 0 ? int((wait + 999) / 1000) : 0;
+    _armedDue = due;
+    _timerId = _loop->addOneTimer(delayMs, [this]() {
+        onTimer();
+    });
+}
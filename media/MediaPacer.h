@@ -0,0 +1,64 @@
+#ifndef __MEDIAPACER_H__
+#define __MEDIAPACER_H__
+
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+#include "../reactor/EventLoop.h"
+#include "../reactor/NonCopyable.h"
+
+class PacedStream {
+public:
+    virtual ~PacedStream() = default;
+    // 在所属 EventLoop 线程中调用：发送到期的媒体数据，nextDue 返回下一次到期时间；
+    // 返回 false 表示结束（读完、出错或暂停），调度器不再唤醒它
+    virtual bool onPace(std::chrono::steady_clock::time_point now,
+                        std::chrono::steady_clock::time_point& nextDue) = 0;
+};
+
+/*
+每个 EventLoop 一个的媒体发送节奏调度器。
+所有会话按下一次到期时间排序，只用一个一次性定时器对准最早的到期点，
+唤醒时一次性处理所有已到期的会话，唤醒次数随帧率而不是会话数增长。
+schedule/cancel 必须在该 EventLoop 的线程中调用。
+*/
+class MediaPacer : NonCopyable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static MediaPacer& forLoop(EventLoop* loop);
+
+    // 加入或重新安排：stream 在 due 时刻被调用
+    void schedule(const std::shared_ptr<PacedStream>& stream, Clock::time_point due);
+    void cancel(const PacedStream* stream);
+    size_t size() const { return _entries.size(); }
+
+private:
+    explicit MediaPacer(EventLoop* loop);
+
+    using DueKey = std::pair<Clock::time_point, const PacedStream*>;
+    struct Entry {
+        std::weak_ptr<PacedStream> stream;
+        Clock::time_point due;
+        bool queued;    // 是否在 _queue 中；本轮正在处理的会话不在队列里
+    };
+
+    void enqueue(const PacedStream* key, Entry& entry, Clock::time_point due);
+    void onTimer();
+    void arm();
+
+    EventLoop* _loop;
+    std::unordered_map<const PacedStream*, Entry> _entries;
+    std::set<DueKey> _queue;                 // 按到期时间排序
+    std::vector<const PacedStream*> _due;    // onTimer 复用的到期列表
+    TimerId _timerId;
+    Clock::time_point _armedDue;
+
+    static std::map<EventLoop*, std::unique_ptr<MediaPacer>> _registry;
+    static std::mutex _registryMutex;
+};
+
+#endif
@@ -2,8 +2,11 @@
 #define __MEDIAREADER_H__
 
 #include <vector>
+#include <memory>
 #include <cstdint>
 
+class MediaSource;
+
 
 enum class ReadStatus {
     Ok,             // 正常读取到一帧数据
@@ -19,6 +22,12 @@ public:
     // 读取一帧（成功返回 true，失败/文件结束返回 false）
     virtual ReadStatus readFrame(std::vector<uint8_t>& outFrame) = 0;
 
+    // 基于 MediaSource 的读取器：只前进游标不拷贝数据，返回该帧在 source() 中的下标
+    virtual ReadStatus readFrameIndex(size_t& outIndex) { (void)outIndex; return ReadStatus::FileError; }
+    virtual std::shared_ptr<MediaSource> source() const { return nullptr; }
+    // 把游标移到 source() 中的第 index 帧，下一次读取从该帧开始；不支持定位的读取器返回 false
+    virtual bool seekFrame(size_t index) { (void)index; return false; }
+
     virtual ~MediaReader() = default;
 };
 
@@ -0,0 +1,181 @@
+#include "MediaSource.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include "StartCodeScanner.h"
+#include "RtpPayloadCache.h"
+#include "../reactor/Logger.h"
+
+std::map<std::string, MediaSource::RegistryEntry> MediaSource::_registry;
+std::mutex MediaSource::_registryMutex;
+
+std::shared_ptr<MediaSource> MediaSource::open(const std::string& path, MediaCodec codec) {
+    std::string key = path + (codec == MediaCodec::H264 ? "#h264" : "#aac");
+    std::promise<std::shared_ptr<MediaSource>> loaded;
+    std::shared_future<std::shared_ptr<MediaSource>> loading;
+    {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        RegistryEntry& entry = _registry[key];
+        auto source = entry.source.lock();
+        if (source) {
+            return source;
+        }
+        if (entry.loading.valid()) {
+            loading = entry.loading;
+        } else {
+            entry.loading = loaded.get_future().share();
+        }
+    }
+    if (loading.valid()) {
+        // 另一个线程正在打开同一个文件，等它建完索引，不重复映射
+        return loading.get();
+    }
+    // 大文件建索引要扫一遍，放在锁外，其他文件的 open 不用排队；构造函数私有，不能用 make_shared
+    std::shared_ptr<MediaSource> source(new MediaSource(path, codec));
+    {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        RegistryEntry& entry = _registry[key];
+        entry.source = source;
+        entry.loading = std::shared_future<std::shared_ptr<MediaSource>>();
+    }
+    loaded.set_value(source);
+    if (codec == MediaCodec::H264 && source->frameCount() > 0) {
+        // 预打包要把整个文件切一遍，不能放在处理 DESCRIBE/PLAY 的事件循环里做；
+        // 线程持有 source，建完之前不会 munmap
+        std::thread([source]() {
+            source->_payloadCache.store(new RtpPayloadCache(*source), std::memory_order_release);
+        }).detach();
+    }
+    return source;
+}
+
+MediaSource::MediaSource(const std::string& path, MediaCodec codec)
+:_path(path)
+,_codec(codec)
+,_data(nullptr)
+,_size(0)
+,_isEmpty(false)
+,_durationMs(0)
+,_payloadCache(nullptr)
+{
+    if (!mapFile()) {
+        return;
+    }
+    if (_codec == MediaCodec::H264) {
+        buildH264Index();
+    } else {
+        buildAacIndex();
+    }
+    LOG_INFO("MediaSource %s mapped: %zu bytes, %zu frames, %zu key frames", _path.c_str(), _size, _frames.size(), _keyFrames.size());
+}
+
+MediaSource::~MediaSource() {
+    delete _payloadCache.load();
+    if (_data) {
+        ::munmap(const_cast<uint8_t*>(_data), _size);
+    }
+    LOG_DEBUG("MediaSource %s unmapped", _path.c_str());
+}
+
+const KeyFrame* MediaSource::findKeyFrame(uint64_t timestampMs) const {
+    if (_keyFrames.empty()) {
+        return nullptr;
+    }
+    auto it = std::upper_bound(_keyFrames.begin(), _keyFrames.end(), timestampMs,
+                               [](uint64_t ts, const KeyFrame& key) { return ts < key.timestampMs; });
+    if (it != _keyFrames.begin()) {
+        --it;
+    }
+    return &*it;
+}
+
+bool MediaSource::mapFile() {
+    int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR("MediaSource open %s failed: %s", _path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+        LOG_ERROR("MediaSource fstat %s failed: %s", _path.c_str(), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        _isEmpty = true;
+        return true;
+    }
+    void* addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);//映射建立后文件描述符即可关闭
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("MediaSource mmap %s failed: %s", _path.c_str(), strerror(errno));
+        return false;
+    }
+    _data = static_cast<const uint8_t*>(addr);
+    _size = st.st_size;
+    return true;
+}
+
+void MediaSource::buildH264Index() {
+    // 找到每个 00 00 01 起始码，NALU 从起始码之后开始，到下一个起始码之前结束；
+    // 4 字节起始码 00 00 00 01 多出的那个 0 不计入前一个 NALU
+    const uint8_t* end = _data + _size;
+    const uint8_t* sc = findStartCode(_data, end);
+    while (sc != end) {
+        const uint8_t* nalStart = sc + 3;
+        sc = findStartCode(nalStart, end);
+        const uint8_t* nalEnd = sc;
+        if (sc != end && sc > nalStart && sc[-1] == 0x00) {
+            --nalEnd;
+        }
+        if (nalEnd > nalStart) {
+            _frames.push_back(MediaFrame{uint64_t(nalStart - _data), uint32_t(nalEnd - nalStart), uint8_t(nalStart[0] & 0x1F)});
+        }
+    }
+
+    // 顺带建立关键帧索引：除 SPS/PPS 外每个 NALU 占一帧时间，与 RtpPusher 的发送节奏一致
+    size_t spsIndex = kNoFrameIndex;
+    size_t ppsIndex = kNoFrameIndex;
+    uint64_t frameNumber = 0;
+    for (size_t i = 0; i < _frames.size(); ++i) {
+        const MediaFrame& frame = _frames[i];
+        if (frame.type == 7) {
+            spsIndex = i;
+            continue;
+        } else if (frame.type == 8) {
+            ppsIndex = i;
+            continue;
+        }
+        if (frame.type == 5) {
+            _keyFrames.push_back(KeyFrame{i, frame.offset, frameNumber * kH264FrameDurationMs, spsIndex, ppsIndex});
+        }
+        ++frameNumber;
+    }
+    _durationMs = frameNumber * kH264FrameDurationMs;
+}
+
+void MediaSource::buildAacIndex() {
+    size_t pos = 0;
+    while (pos + 7 <= _size) {
+        const uint8_t* header = _data + pos;
+        // 校验 ADTS 同步头（12bit）
+        if (header[0] != 0xFF || (header[1] & 0xF0) != 0xF0) {
+            LOG_WARN("MediaSource %s: bad ADTS sync at offset %zu, index truncated", _path.c_str(), pos);
+            break;
+        }
+        // aac_frame_length: 13 bits: bits 30-42
+        uint32_t frameLength = ((header[3] & 0x03) << 11) |
+                               (header[4] << 3) |
+                               ((header[5] & 0xE0) >> 5);
+        if (frameLength < 7 || pos + frameLength > _size) {
+            break;
+        }
+        _frames.push_back(MediaFrame{pos, frameLength, 0});
+        pos += frameLength;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef __MEDIASOURCE_H__
+#define __MEDIASOURCE_H__
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../reactor/NonCopyable.h"
+
+class RtpPayloadCache;
+
+enum class MediaCodec {
+    H264,   // Annex-B 裸流，按 NALU 建索引
+    AAC     // ADTS 裸流，按 ADTS 帧建索引
+};
+
+// 索引中的一帧：H264 为一个 NALU（不含起始码），AAC 为一个完整 ADTS 帧（含 7 字节头）
+struct MediaFrame {
+    uint64_t offset;    // 帧数据在文件中的偏移
+    uint32_t size;      // 帧数据长度
+    uint8_t type;       // H264 为 nal_unit_type，AAC 恒为 0
+};
+
+// 裸 H264 流不带时间信息，和推流节奏一致按 25fps（每帧 40ms）推算
+static const uint32_t kH264FrameDurationMs = 40;
+
+static const size_t kNoFrameIndex = static_cast<size_t>(-1);
+
+// H264 关键帧索引项，用于 PLAY Range 按时间定位
+struct KeyFrame {
+    size_t frameIndex;      // IDR 在帧索引中的下标
+    uint64_t offset;        // IDR 在文件中的字节偏移
+    uint64_t timestampMs;   // IDR 的播放时间
+    size_t spsIndex;        // IDR 之前最近的 SPS/PPS 下标，没有时为 kNoFrameIndex
+    size_t ppsIndex;
+};
+
+/*
+进程级共享的媒体源。
+同一个文件只 mmap 一次、只建一次帧索引，所有会话共享同一份只读数据，
+每个会话只需要持有一个 shared_ptr 和一个帧下标（游标），不再各自打开 ifstream。
+*/
+class MediaSource : NonCopyable {
+public:
+    // 获取（必要时创建）指定文件的共享媒体源，同一路径+编码只会存在一个实例
+    static std::shared_ptr<MediaSource> open(const std::string& path, MediaCodec codec);
+    ~MediaSource();
+
+    bool isOpen() const { return _data != nullptr || _isEmpty; }
+    const std::string& path() const { return _path; }
+    MediaCodec codec() const { return _codec; }
+
+    size_t frameCount() const { return _frames.size(); }
+    const MediaFrame& frame(size_t idx) const { return _frames[idx]; }
+    const uint8_t* frameData(const MediaFrame& f) const { return _data + f.offset; }
+    // 整个文件的只读映射，空文件时为 nullptr
+    const uint8_t* data() const { return _data; }
+
+    // H264 源：返回播放时间不晚于 timestampMs 的最近关键帧（早于第一个 IDR 时返回第一个），二分查找
+    const KeyFrame* findKeyFrame(uint64_t timestampMs) const;
+    const std::vector<KeyFrame>& keyFrames() const { return _keyFrames; }
+    uint64_t durationMs() const { return _durationMs; }
+
+    // H264 源的 RTP 预打包缓存，打开文件时在后台线程构建，所有会话共享；还没建好时返回 nullptr
+    const RtpPayloadCache* rtpPayloadCache() const { return _payloadCache.load(std::memory_order_acquire); }
+
+private:
+    MediaSource(const std::string& path, MediaCodec codec);
+    bool mapFile();
+    void buildH264Index();
+    void buildAacIndex();
+
+    std::string _path;
+    MediaCodec _codec;
+    const uint8_t* _data;   // mmap 映射的只读文件内容
+    size_t _size;
+    bool _isEmpty;          // 空文件无法 mmap，但仍视为打开成功
+    std::vector<MediaFrame> _frames;
+    std::vector<KeyFrame> _keyFrames;   // 和帧索引一起在打开时建立，按时间递增
+    uint64_t _durationMs;
+
+    std::atomic<const RtpPayloadCache*> _payloadCache;  // 建好后发布，析构时释放
+
+    // 注册表只持有弱引用，最后一个会话释放后自动 munmap。
+    // 映射和建索引在锁外做，期间 loading 有效，打开同一文件的调用者等它，打开别的文件不受影响
+    struct RegistryEntry {
+        std::weak_ptr<MediaSource> source;
+        std::shared_future<std::shared_ptr<MediaSource>> loading;
+    };
+    static std::map<std::string, RegistryEntry> _registry;
+    static std::mutex _registryMutex;
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "RtcpSession.h"
+#include <string.h>
+#include <algorithm>
+#include <unistd.h>
+#include "../reactor/Logger.h"
+
+std::atomic<uint64_t> RtcpSession::_srSent{0};
+std::atomic<uint64_t> RtcpSession::_rrReceived{0};
+std::atomic<uint64_t> RtcpSession::_byeCount{0};
+std::atomic<uint64_t> RtcpSession::_rttSamples{0};
+std::atomic<uint64_t> RtcpSession::_rttSumUs{0};
+std::atomic<uint64_t> RtcpSession::_jitterSamples{0};
+std::atomic<uint64_t> RtcpSession::_jitterSumUs{0};
+std::atomic<uint32_t> RtcpSession::_maxFractionLost{0};
+std::atomic<uint64_t> RtcpSession::_nackRequested{0};
+std::atomic<uint64_t> RtcpSession::_retransmitted{0};
+
+namespace {
+
+const uint8_t kRtcpSr = 200;
+const uint8_t kRtcpRr = 201;
+const uint8_t kRtcpSdes = 202;
+const uint8_t kRtcpBye = 203;
+const uint8_t kRtcpRtpfb = 205;     // RFC 4585 传输层反馈
+const uint8_t kRtpfbNack = 1;       // Generic NACK
+const uint8_t kSdesCname = 1;
+const uint64_t kNtpUnixOffset = 2208988800ull;  // 1900-01-01 到 1970-01-01 的秒数
+
+inline uint32_t get32(const uint8_t* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+inline void put32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// 同一台服务器上的所有流用同一个 CNAME，播放器靠它把音视频 SSRC 归到同一个来源
+const std::string& localCname() {
+    static const std::string cname = []() {
+        char host[256] = {0};
+        if (gethostname(host, sizeof(host) - 1) != 0 || host[0] == '\0') {
+            strcpy(host, "localhost");
+        }
+        return std::string("rtsp_server@") + host;
+    }();
+    return cname;
+}
+
+}
+
+RtcpSession::RtcpSession(uint32_t videoSsrc, uint32_t audioSsrc)
+: _rng(uint32_t(SteadyClock::now().time_since_epoch().count()) ^ videoSsrc) {
+    _streams[kVideo].ssrc = videoSsrc;
+    _streams[kAudio].ssrc = audioSsrc;
+}
+
+uint64_t RtcpSession::ntpNow() {
+    // NTP 时间戳：高 32 位是 1900 年起的秒数，低 32 位是秒的小数
+    auto since = std::chrono::system_clock::now().time_since_epoch();
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(since).count();
+    uint64_t sec = us / 1000000 + kNtpUnixOffset;
+    uint64_t frac = ((us % 1000000) << 32) / 1000000;
+    return (sec << 32) | frac;
+}
+
+int RtcpSession::nextIntervalMs() {
+    std::uniform_int_distribution<int> dist(kMinIntervalMs / 2, kMinIntervalMs * 3 / 2 - 1);
+    return dist(_rng);
+}
+
+size_t RtcpSession::buildSenderReport(Stream stream, uint8_t* buf, size_t cap) {
+    StreamState& s = _streams[stream];
+    const std::string& cname = localCname();
+    size_t cnameLen = cname.size() > 255 ? 255 : cname.size();
+    // SDES 块：SSRC + CNAME 项 + 至少一个 0 结束，补齐到 4 字节
+    size_t chunkLen = (4 + 2 + cnameLen + 1 + 3) & ~size_t(3);
+    size_t total = 28 + 4 + chunkLen;
+    if (!s.hasTimestamp || total > cap) {
+        return 0;
+    }
+    // NTP 和 RTP 时间戳取同一时刻：从最近发出的 RTP 时间戳按时钟频率外推到现在
+    uint64_t ntp = ntpNow();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - s.lastSentAt).count();
+    uint32_t rtpNow = s.lastTimestamp + uint32_t(int64_t(elapsed) * s.clockRate / 1000000);
+
+    uint8_t* p = buf;
+    p[0] = 0x80;                // V=2，没有报告块：我们不接收 RTP
+    p[1] = kRtcpSr;
+    p[2] = 0;
+    p[3] = 6;                   // 长度以 32 位字计，减一
+    put32(p + 4, s.ssrc);
+    put32(p + 8, uint32_t(ntp >> 32));
+    put32(p + 12, uint32_t(ntp));
+    put32(p + 16, rtpNow);
+    put32(p + 20, s.packets);
+    put32(p + 24, s.octets);
+    p += 28;
+
+    p[0] = 0x81;                // 一个 SDES 块
+    p[1] = kRtcpSdes;
+    p[2] = 0;
+    p[3] = uint8_t(chunkLen / 4);
+    put32(p + 4, s.ssrc);
+    memset(p + 8, 0, chunkLen - 4);
+    p[8] = kSdesCname;
+    p[9] = uint8_t(cnameLen);
+    memcpy(p + 10, cname.data(), cnameLen);
+
+    ++_srSent;
+    return total;
+}
+
+void RtcpSession::handlePacket(const uint8_t* data, size_t len) {
+    uint32_t arrival = ntpMiddle(ntpNow());
+    _streams[kVideo].nacks.clear();
+    _streams[kAudio].nacks.clear();
+    size_t pos = 0;
+    while (pos + 4 <= len) {
+        const uint8_t* p = data + pos;
+        if ((p[0] >> 6) != 2) {
+            break;
+        }
+        size_t count = p[0] & 0x1F;
+        size_t plen = ((size_t(p[2]) << 8) | p[3]) * 4 + 4;
+        if (pos + plen > len) {
+            break;
+        }
+        switch (p[1]) {
+        case kRtcpSr:
+            // 客户端也在发媒体时发 SR，报告块跟在 20 字节的发送者信息后面
+            if (plen >= 28) {
+                handleReportBlocks(p + 28, std::min(count, (plen - 28) / 24), get32(p + 4), arrival);
+            }
+            break;
+        case kRtcpRr:
+            if (plen >= 8) {
+                handleReportBlocks(p + 8, std::min(count, (plen - 8) / 24), get32(p + 4), arrival);
+            }
+            break;
+        case kRtcpSdes:
+            handleSdes(p + 4, plen - 4, count);
+            break;
+        case kRtcpRtpfb:
+            // 反馈包的头里 count 位置放的是 FMT
+            if (count == kRtpfbNack && plen >= 12) {
+                handleNack(p, plen);
+            }
+            break;
+        case kRtcpBye:
+            if (!_byeReceived) {
+                _byeReceived = true;
+                ++_byeCount;
+                LOG_INFO("RTCP BYE from SSRC %u", plen >= 8 && count > 0 ? get32(p + 4) : 0);
+            }
+            break;
+        default:
+            break;
+        }
+        pos += plen;
+    }
+}
+
+void RtcpSession::handleReportBlocks(const uint8_t* p, size_t count, uint32_t reporter, uint32_t arrivalNtp) {
+    for (size_t i = 0; i < count; ++i, p += 24) {
+        uint32_t source = get32(p);
+        StreamState* s = nullptr;
+        if (source == _streams[kVideo].ssrc) {
+            s = &_streams[kVideo];
+        } else if (source == _streams[kAudio].ssrc) {
+            s = &_streams[kAudio];
+        } else {
+            continue;
+        }
+        RtcpReceiverStats& r = s->receiver;
+        r.reporterSsrc = reporter;
+        r.fractionLost = p[4];
+        uint32_t lost = (uint32_t(p[5]) << 16) | (uint32_t(p[6]) << 8) | p[7];
+        r.cumulativeLost = int32_t(lost & 0x800000 ? lost | 0xFF000000 : lost);    // 24 位有符号数
+        r.highestSeq = get32(p + 8);
+        r.jitter = get32(p + 12);
+        r.jitterMs = s->clockRate ? r.jitter * 1000.0 / s->clockRate : 0;
+        ++r.reports;
+        ++_rrReceived;
+        ++_jitterSamples;
+        _jitterSumUs += uint64_t(r.jitterMs * 1000);
+        uint32_t fraction = r.fractionLost;
+        uint32_t seen = _maxFractionLost.load(std::memory_order_relaxed);
+        while (fraction > seen && !_maxFractionLost.compare_exchange_weak(seen, fraction)) {
+        }
+
+        // RTT = 到达时间 - LSR - DLSR，单位都是 1/65536 秒；客户端还没收到过 SR 时 LSR 为 0
+        uint32_t lsr = get32(p + 16);
+        uint32_t dlsr = get32(p + 20);
+        if (lsr != 0) {
+            int32_t rtt = int32_t(arrivalNtp - lsr - dlsr);
+            if (rtt >= 0) {
+                r.rttMs = rtt * 1000.0 / 65536;
+                ++_rttSamples;
+                _rttSumUs += uint64_t(r.rttMs * 1000);
+            }
+        }
+    }
+}
+
+void RtcpSession::handleSdes(const uint8_t* p, size_t len, size_t chunks) {
+    // 每个块是 SSRC 加若干 (类型, 长度, 文本) 项，以类型 0 结束并补齐到 4 字节；这里只关心 CNAME
+    size_t off = 0;
+    for (size_t c = 0; c < chunks && off + 4 <= len; ++c) {
+        off += 4;
+        while (off < len) {
+            uint8_t type = p[off];
+            if (type == 0) {
+                off = (off + 4) & ~size_t(3);
+                break;
+            }
+            if (off + 2 > len || off + 2 + p[off + 1] > len) {
+                return;
+            }
+            if (type == kSdesCname && _peerCname.empty()) {
+                _peerCname.assign(reinterpret_cast<const char*>(p + off + 2), p[off + 1]);
+            }
+            off += 2 + p[off + 1];
+        }
+    }
+}
+
+void RtcpSession::handleNack(const uint8_t* p, size_t len) {
+    // 发送者 SSRC、媒体 SSRC 之后是若干 FCI：PID 是丢失的序号，BLP 的第 i 位表示 PID+i+1 也丢了
+    uint32_t media = get32(p + 8);
+    StreamState* s = nullptr;
+    if (media == _streams[kVideo].ssrc) {
+        s = &_streams[kVideo];
+    } else if (media == _streams[kAudio].ssrc) {
+        s = &_streams[kAudio];
+    } else {
+        return;
+    }
+    size_t before = s->nacks.size();
+    for (size_t off = 12; off + 4 <= len; off += 4) {
+        uint16_t pid = uint16_t(p[off] << 8 | p[off + 1]);
+        uint16_t blp = uint16_t(p[off + 2] << 8 | p[off + 3]);
+        if (s->nacks.size() >= kMaxNacks) {
+            break;
+        }
+        s->nacks.push_back(pid);
+        for (int i = 0; i < 16 && s->nacks.size() < kMaxNacks; ++i) {
+            if (blp & (1 << i)) {
+                s->nacks.push_back(uint16_t(pid + i + 1));
+            }
+        }
+    }
+    _nackRequested += s->nacks.size() - before;
+}
+
+RtcpTotals RtcpSession::takeTotals() {
+    RtcpTotals totals;
+    totals.srSent = _srSent.exchange(0);
+    totals.rrReceived = _rrReceived.exchange(0);
+    totals.byeReceived = _byeCount.exchange(0);
+    totals.rttSamples = _rttSamples.exchange(0);
+    totals.rttSumMs = _rttSumUs.exchange(0) / 1000.0;
+    totals.jitterSamples = _jitterSamples.exchange(0);
+    totals.jitterSumMs = _jitterSumUs.exchange(0) / 1000.0;
+    totals.maxLossPercent = _maxFractionLost.exchange(0) * 100.0 / 256;
+    totals.nackRequested = _nackRequested.exchange(0);
+    totals.retransmitted = _retransmitted.exchange(0);
+    return totals;
+}
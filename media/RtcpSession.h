@@ -0,0 +1,127 @@
+#ifndef __RTCPSESSION_H__
+#define __RTCPSESSION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "../reactor/NonCopyable.h"
+
+// 客户端在 RR 里对我们某一路流的最近一次汇报，以及由此算出的 RTT
+struct RtcpReceiverStats {
+    uint32_t reporterSsrc = 0;      // 发出 RR 的客户端 SSRC
+    uint8_t fractionLost = 0;       // 上一个汇报间隔的丢包率，单位 1/256
+    int32_t cumulativeLost = 0;
+    uint32_t highestSeq = 0;        // 扩展后的最高序号
+    uint32_t jitter = 0;            // RTP 时钟单位
+    double jitterMs = 0;
+    double rttMs = -1;              // 还没有可用的 LSR/DLSR 时为 -1
+    uint64_t reports = 0;
+    double lossPercent() const { return fractionLost * 100.0 / 256; }
+};
+
+// 本进程所有会话的 RTCP 汇总，统计输出时取走并清零
+struct RtcpTotals {
+    uint64_t srSent = 0;
+    uint64_t rrReceived = 0;
+    uint64_t byeReceived = 0;
+    uint64_t rttSamples = 0;
+    double rttSumMs = 0;
+    uint64_t jitterSamples = 0;
+    double jitterSumMs = 0;
+    double maxLossPercent = 0;
+    uint64_t nackRequested = 0;     // NACK 里请求重传的序号数
+    uint64_t retransmitted = 0;
+};
+
+/*
+一个 RTSP 会话的 RTCP 状态（RFC 3550），视频、音频各一路，我们只做发送端：
+发送侧记下每路的包数、字节数和最近一个 RTP 时间戳对应的本地时间，按需生成 SR + SDES(CNAME) 复合包，
+SR 里的 NTP 时间和 RTP 时间戳对应同一时刻，播放器据此对齐音视频；
+接收侧解析客户端发来的复合包（RR/SR 的报告块、SDES、BYE，以及 RFC 4585 的 Generic NACK），
+按报告块里的 SSRC 归到对应的流，用 LSR/DLSR 算出 RTT。只在会话所在的 EventLoop 线程中使用。
+*/
+class RtcpSession : NonCopyable {
+public:
+    using SteadyClock = std::chrono::steady_clock;
+    enum Stream { kVideo = 0, kAudio = 1 };
+
+    static const size_t kMaxPacketSize = 256;     // SR + SDES 复合包的上限
+    static const int kMinIntervalMs = 5000;       // RFC 3550 6.2 建议的最小汇报间隔
+    static const int kFirstReportMs = 500;        // 开始推流后尽快发第一个 SR，播放器要靠它做音视频同步
+    static const size_t kMaxNacks = 512;          // 一个复合包里最多受理的丢失序号，多出来的忽略
+
+    RtcpSession(uint32_t videoSsrc, uint32_t audioSsrc);
+
+    void setClockRate(Stream stream, uint32_t rate) { _streams[stream].clockRate = rate; }
+    uint32_t ssrc(Stream stream) const { return _streams[stream].ssrc; }
+
+    // 发出一个 RTP 包后调用，payloadBytes 不含 RTP 头
+    void onRtpSent(Stream stream, size_t payloadBytes) {
+        ++_streams[stream].packets;
+        _streams[stream].octets += payloadBytes;
+    }
+    // 记下 timestamp 这个 RTP 时间对应本地的 sentAt，SR 由它外推出当前时刻的 RTP 时间戳
+    void onRtpTimestamp(Stream stream, uint32_t timestamp, SteadyClock::time_point sentAt) {
+        _streams[stream].lastTimestamp = timestamp;
+        _streams[stream].lastSentAt = sentAt;
+        _streams[stream].hasTimestamp = true;
+    }
+
+    // 在 buf 中生成这一路的 SR + SDES 复合包，返回长度；还没发过 RTP 时返回 0
+    size_t buildSenderReport(Stream stream, uint8_t* buf, size_t cap);
+    // 解析客户端发来的复合 RTCP 包，格式不对的部分直接丢弃
+    void handlePacket(const uint8_t* data, size_t len);
+    // 最近一次 handlePacket 里 NACK 请求重传的序号，按到达顺序，下一次 handlePacket 时清空
+    const std::vector<uint16_t>& nacks(Stream stream) const { return _streams[stream].nacks; }
+
+    const RtcpReceiverStats& receiverStats(Stream stream) const { return _streams[stream].receiver; }
+    const std::string& peerCname() const { return _peerCname; }
+    bool byeReceived() const { return _byeReceived; }
+
+    // 下一次汇报的间隔（毫秒）：最小间隔乘以 [0.5, 1.5) 的随机因子，避免大量会话同时发送
+    int nextIntervalMs();
+
+    static RtcpTotals takeTotals();
+    static void countRetransmissions(uint64_t packets) { _retransmitted += packets; }
+
+private:
+    struct StreamState {
+        uint32_t ssrc;
+        uint32_t clockRate = 90000;
+        uint32_t packets = 0;
+        uint32_t octets = 0;
+        uint32_t lastTimestamp = 0;
+        SteadyClock::time_point lastSentAt;
+        bool hasTimestamp = false;
+        RtcpReceiverStats receiver;
+        std::vector<uint16_t> nacks;    // clear 保留容量，稳态下不再分配
+    };
+
+    void handleReportBlocks(const uint8_t* p, size_t count, uint32_t reporter, uint32_t arrivalNtp);
+    void handleSdes(const uint8_t* p, size_t len, size_t chunks);
+    void handleNack(const uint8_t* p, size_t len);
+    static uint32_t ntpMiddle(uint64_t ntp) { return uint32_t(ntp >> 16); }
+    static uint64_t ntpNow();
+
+    StreamState _streams[2];
+    std::string _peerCname;
+    bool _byeReceived = false;
+    std::minstd_rand _rng;
+
+    static std::atomic<uint64_t> _srSent;
+    static std::atomic<uint64_t> _rrReceived;
+    static std::atomic<uint64_t> _byeCount;
+    static std::atomic<uint64_t> _rttSamples;
+    static std::atomic<uint64_t> _rttSumUs;
+    static std::atomic<uint64_t> _jitterSamples;
+    static std::atomic<uint64_t> _jitterSumUs;
+    static std::atomic<uint32_t> _maxFractionLost;
+    static std::atomic<uint64_t> _nackRequested;
+    static std::atomic<uint64_t> _retransmitted;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __RTPHEADER_H__
+#define __RTPHEADER_H__
+
+#include <cstdint>
+#include <cstddef>
+
+static const uint8_t kRtpPayloadTypeH264 = 96;
+static const uint8_t kRtpPayloadTypeAac = 97;
+// RFC 4588 重传流的负载类型，在 SDP 里用 apt 关联到原负载类型
+static const uint8_t kRtpPayloadTypeH264Rtx = 98;
+static const uint8_t kRtpPayloadTypeAacRtx = 99;
+static const size_t kRtpHeaderSize = 12;
+
+// 在 h 处写入 12 字节 RTP 固定头（V=2，无 padding/extension/CSRC）
+inline void writeRtpHeader(uint8_t* h, uint16_t seq, uint32_t timestamp, uint32_t ssrc, uint8_t pt, bool marker) {
+    h[0] = 0x80;
+    h[1] = pt;
+    if (marker) h[1] |= 0x80;
+    h[2] = seq >> 8;
+    h[3] = seq & 0xFF;
+    h[4] = (timestamp >> 24) & 0xFF;
+    h[5] = (timestamp >> 16) & 0xFF;
+    h[6] = (timestamp >> 8) & 0xFF;
+    h[7] = (timestamp) & 0xFF;
+    h[8] = (ssrc >> 24) & 0xFF;
+    h[9] = (ssrc >> 16) & 0xFF;
+    h[10] = (ssrc >> 8) & 0xFF;
+    h[11] = (ssrc) & 0xFF;
+}
+
+#endif
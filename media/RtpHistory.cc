@@ -0,0 +1,35 @@
+#include "RtpHistory.h"
+
+RtpHistory::RtpHistory(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    _entries.resize(size);
+    _mask = size - 1;
+}
+
+void RtpHistory::store(const PacketPtr& packet, size_t offset, SteadyClock::time_point sentAt) {
+    const uint8_t* h = packet->data() + offset;
+    uint16_t seq = uint16_t(h[2] << 8 | h[3]);
+    Entry& e = _entries[seq & _mask];
+    e.packet = packet;
+    e.seq = seq;
+    e.offset = uint16_t(offset);
+    e.sentAt = sentAt;
+    e.resends = 0;
+}
+
+RtpHistory::Entry* RtpHistory::find(uint16_t seq, SteadyClock::time_point now, SteadyClock::duration maxAge) {
+    Entry& e = _entries[seq & _mask];
+    if (!e.packet || e.seq != seq || now - e.sentAt > maxAge) {
+        return nullptr;
+    }
+    return &e;
+}
+
+void RtpHistory::clear() {
+    for (Entry& e : _entries) {
+        e.packet.reset();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef __RTPHISTORY_H__
+#define __RTPHISTORY_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+#include "../reactor/NonCopyable.h"
+#include "../reactor/PacketBuffer.h"
+
+/*
+一路 RTP 流最近发出的包，收到 NACK 时从这里取出重传。
+容量取 2 的幂，序号取模直接定位槽位，存、取都是 O(1)；槽里只持有池中缓冲区的引用，不拷贝包内容，
+新包覆盖旧槽时旧缓冲区才回到空闲链表。只在会话所在的 EventLoop 线程中使用。
+*/
+class RtpHistory : NonCopyable {
+public:
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct Entry {
+        PacketPtr packet;
+        uint16_t seq = 0;
+        uint16_t offset = 0;                // RTP 头在 packet->data() 中的偏移，StreamHub 的共享包前面有 4 字节 interleaved 前缀
+        SteadyClock::time_point sentAt;
+        SteadyClock::time_point resentAt;
+        uint32_t resends = 0;
+
+        const uint8_t* rtp() const { return packet->data() + offset; }
+        size_t rtpSize() const { return packet->totalSize() - offset; }  // 含外挂段
+    };
+
+    // capacity 向上取到 2 的幂
+    explicit RtpHistory(size_t capacity);
+
+    // 记下刚发出的包，序号从包的 RTP 头里取
+    void store(const PacketPtr& packet, size_t offset, SteadyClock::time_point sentAt);
+    // 序号为 seq 且发出不超过 maxAge 的包，已被覆盖、从未发出或太旧时返回 nullptr
+    Entry* find(uint16_t seq, SteadyClock::time_point now, SteadyClock::duration maxAge);
+    // 释放持有的所有缓冲区（暂停、定位后旧包不会再被请求）
+    void clear();
+
+    size_t capacity() const { return _entries.size(); }
+
+private:
+    std::vector<Entry> _entries;
+    size_t _mask;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "RtpPayloadCache.h"
+#include "MediaSource.h"
+#include <algorithm>
+#include "../reactor/Logger.h"
+
+RtpPayloadCache::RtpPayloadCache(const MediaSource& source)
+:_fileData(source.data())
+,_maxFramePackets(0)
+{
+    size_t count = source.frameCount();
+    _firstPayload.reserve(count + 1);
+    _stapA.assign(count, -1);
+
+    const size_t npos = static_cast<size_t>(-1);
+    size_t spsIndex = npos;
+    size_t ppsIndex = npos;
+    size_t spsPackets = 0;
+    size_t ppsPackets = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const MediaFrame& frame = source.frame(i);
+        _firstPayload.push_back(_payloads.size());
+        packetizeNalu(frame);
+        size_t packets = _payloads.size() - _firstPayload.back();
+        if (frame.type == 7) {
+            spsIndex = i;
+            spsPackets = packets;
+        } else if (frame.type == 8) {
+            ppsIndex = i;
+            ppsPackets = packets;
+        } else {
+            if (frame.type == 5 && spsIndex != npos && ppsIndex != npos) {
+                buildStapA(i, source, spsIndex, ppsIndex);
+            }
+            // 没打成 STAP-A 的 IDR 发送时前面补上最近的 SPS/PPS
+            if (frame.type == 5 && _stapA[i] < 0) {
+                packets += spsPackets + ppsPackets;
+            }
+            _maxFramePackets = std::max(_maxFramePackets, _stapA[i] < 0 ? packets : 1);
+        }
+    }
+    _firstPayload.push_back(_payloads.size());
+    LOG_INFO("RtpPayloadCache built for %s: %zu NALUs, %zu payloads, %zu STAP-A, %zu bytes",
+             source.path().c_str(), count, _payloads.size(), _stapPayloads.size(), memoryBytes());
+}
+
+uint64_t RtpPayloadCache::appendBytes(const uint8_t* data, size_t size) {
+    uint64_t offset = _arena.size();
+    _arena.insert(_arena.end(), data, data + size);
+    return offset;
+}
+
+void RtpPayloadCache::packetizeNalu(const MediaFrame& frame) {
+    const uint8_t* nalu = _fileData + frame.offset;
+    size_t size = frame.size;
+    if (size + 12 <= kMtu) {
+        // 单 NALU 包：整个载荷就是文件里的 NALU
+        _payloads.push_back(RtpPayload{0, frame.offset, uint32_t(size), 0, true});
+        return;
+    }
+    // FU-A 分片，与 RtpPusher::sendH264Nalu 的切法保持一致；arena 里只存 2 字节 FU 头
+    uint8_t nal_header = nalu[0];
+    size_t pos = 1;
+    bool isStart = true;
+    while (pos < size) {
+        size_t len = std::min(kMtu - 14, size - pos);
+        bool isLast = (pos + len == size);
+        uint8_t fu[2] = {
+            uint8_t((nal_header & 0xE0) | 28),
+            uint8_t((isStart ? 0x80 : 0x00) | (isLast ? 0x40 : 0x00) | (nal_header & 0x1F))
+        };
+        uint64_t head = appendBytes(fu, 2);
+        _payloads.push_back(RtpPayload{head, frame.offset + pos, uint32_t(len), 2, isLast});
+        pos += len;
+        isStart = false;
+    }
+}
+
+void RtpPayloadCache::buildStapA(size_t nalIndex, const MediaSource& source, size_t spsIndex, size_t ppsIndex) {
+    const MediaFrame& sps = source.frame(spsIndex);
+    const MediaFrame& pps = source.frame(ppsIndex);
+    const MediaFrame& idr = source.frame(nalIndex);
+    size_t total = 1 + (2 + sps.size) + (2 + pps.size) + (2 + idr.size);
+    if (total + 12 > kMtu) {
+        return;
+    }
+    // STAP-A 要在 NALU 之间插入长度字段，不能直接引用文件，整个放进 arena；不超过 MTU，只有小 IDR 才有
+    const uint8_t* idrData = source.frameData(idr);
+    uint8_t stapHeader = (idrData[0] & 0x60) | 24;
+    uint64_t offset = appendBytes(&stapHeader, 1);
+    const MediaFrame* parts[] = { &sps, &pps, &idr };
+    for (const MediaFrame* part : parts) {
+        uint8_t len[2] = { uint8_t(part->size >> 8), uint8_t(part->size & 0xFF) };
+        appendBytes(len, 2);
+        appendBytes(source.frameData(*part), part->size);
+    }
+    _stapA[nalIndex] = _stapPayloads.size();
+    _stapPayloads.push_back(RtpPayload{offset, 0, 0, uint16_t(total), true});
+}
@@ -0,0 +1,69 @@
+#ifndef __RTPPAYLOADCACHE_H__
+#define __RTPPAYLOADCACHE_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "../reactor/NonCopyable.h"
+
+class MediaSource;
+struct MediaFrame;
+
+// 一个已经切好的 RTP 载荷（不含 12 字节 RTP 头）：arena 里的头部（FU indicator/header，或整个 STAP-A）
+// 加上直接引用文件映射的 NALU 数据，两段都可以为空
+struct RtpPayload {
+    uint64_t headOffset;    // 头部在 arena 中的偏移
+    uint64_t bodyOffset;    // NALU 数据在文件中的偏移
+    uint32_t bodySize;
+    uint16_t headSize;
+    bool marker;            // 该包是否需要置 RTP marker 位
+    size_t size() const { return headSize + bodySize; }
+};
+
+/*
+H264 点播文件的 RTP 预打包缓存。
+对点播文件来说，每个 NALU 怎么切 FU-A、IDR 能否和 SPS/PPS 打成 STAP-A，对所有观众都是一样的，
+所以整个文件只切一次。载荷的数据部分直接引用 MediaSource 的只读映射，不另存一份，
+arena 里只有 FU indicator/header 和 STAP-A（IDR 足够小才打，本身不超过 MTU）这些切分时新生成的字节。
+各会话发送时只需要填 12 字节的 RTP 头（序号、时间戳、SSRC），载荷作为 PacketBuffer 的外挂段引用，不拷贝。
+*/
+class RtpPayloadCache : NonCopyable {
+public:
+    static const size_t kMtu = 1400;
+
+    explicit RtpPayloadCache(const MediaSource& source);
+
+    // 第 nalIndex 个 NALU 按单 NALU 包 / FU-A 切好的载荷，范围 [first, last)
+    const RtpPayload* payloadsBegin(size_t nalIndex) const { return _payloads.data() + _firstPayload[nalIndex]; }
+    const RtpPayload* payloadsEnd(size_t nalIndex) const { return _payloads.data() + _firstPayload[nalIndex + 1]; }
+
+    // IDR 与其前面最近的 SPS/PPS 组成的 STAP-A 载荷，超出 MTU 或缺少参数集时返回 nullptr
+    const RtpPayload* stapA(size_t nalIndex) const {
+        int32_t idx = _stapA[nalIndex];
+        return idx < 0 ? nullptr : &_stapPayloads[idx];
+    }
+
+    // 发一帧最多要多少个包（IDR 连同前面的 SPS/PPS 算一帧），发送端据此一次预留好批次的容量
+    size_t maxFramePackets() const { return _maxFramePackets; }
+
+    const uint8_t* head(const RtpPayload& payload) const { return _arena.data() + payload.headOffset; }
+    const uint8_t* body(const RtpPayload& payload) const { return _fileData + payload.bodyOffset; }
+    size_t memoryBytes() const {
+        return _arena.size() + (_payloads.size() + _stapPayloads.size()) * sizeof(RtpPayload);
+    }
+
+private:
+    void packetizeNalu(const MediaFrame& frame);
+    void buildStapA(size_t nalIndex, const MediaSource& source, size_t spsIndex, size_t ppsIndex);
+    uint64_t appendBytes(const uint8_t* data, size_t size);
+
+    const uint8_t* _fileData;               // MediaSource 的映射，缓存由它持有，生命周期相同
+    std::vector<uint8_t> _arena;
+    std::vector<RtpPayload> _payloads;
+    std::vector<size_t> _firstPayload;      // 每个 NALU 第一个载荷在 _payloads 中的下标，末尾多一个哨兵
+    std::vector<RtpPayload> _stapPayloads;
+    std::vector<int32_t> _stapA;            // 每个 NALU 对应 _stapPayloads 的下标，-1 表示没有
+    size_t _maxFramePackets;
+};
+
+#endif
@@ -2,25 +2,14 @@
 #include <functional>
 #include <chrono>
 #include <iostream>
+#include <string.h>
+#include "RtpHeader.h"
+#include "AacPacketizer.h"
 #include "../reactor/Logger.h"
 
-static std::vector<uint8_t> buildRtpHeader(uint16_t seq, uint32_t timestamp, uint32_t ssrc, uint8_t pt, bool marker) {
-    std::vector<uint8_t> h(12);
-    h[0] = 0x80;
-    h[1] = pt;
-    if (marker) h[1] |= 0x80;
-    h[2] = seq >> 8;
-    h[3] = seq & 0xFF;
-    h[4] = (timestamp >> 24) & 0xFF;
-    h[5] = (timestamp >> 16) & 0xFF;
-    h[6] = (timestamp >> 8) & 0xFF;
-    h[7] = (timestamp) & 0xFF;
-    h[8] = (ssrc >> 24) & 0xFF;
-    h[9] = (ssrc >> 16) & 0xFF;
-    h[10] = (ssrc >> 8) & 0xFF;
-    h[11] = (ssrc) & 0xFF;
-    return h;
-}
+std::atomic_bool RtpPusher::_payloadCacheEnabled{true};
+std::atomic_bool RtpPusher::_nackEnabled{true};
+std::atomic_bool RtpPusher::_rtxEnabled{false};
 
 RtpPusher::RtpPusher()
 : _running(false)
@@ -54,9 +43,6 @@ RtpPusher::RtpPusher(std::shared_ptr<UdpConnection> videoRtpConn,
 
 void RtpPusher::start() {
     using namespace std::chrono;
-    auto startTime = steady_clock::now();
-    auto nextVideoTime = startTime;
-    auto nextAudioTime = startTime;
     if (_useUdp) {
         if (!_videoRtpConn || !_audioRtpConn) {
             LOG_ERROR("UDP connections not initialized");
@@ -68,245 +54,870 @@ void RtpPusher::start() {
             return;
         }
     }
-    if (_useUdp) {
-        _timerId = _videoRtpConn->addPeriodicTimer(0, 1, [this, startTime, nextVideoTime, nextAudioTime]() mutable {
-            auto now = steady_clock::now();
-            if(!_running){
-                if (this->_timerId != 0) {
-                    _videoRtpConn->removeTimer(_timerId);
-                    this->_timerId = 0;
-                }
-                return;
-            }
-            // 先处理视频帧
-            if (now >= nextVideoTime) {
-                std::vector<uint8_t> nalu;
-                auto status = _videoReader->readFrame(nalu);
-                if (status == ReadStatus::Ok && _running) {
-                    uint8_t nalu_type = nalu[0] & 0x1F;
-                    if (nalu_type == 7) {
-                        _sps = nalu;
-                    } else if (nalu_type == 8) {
-                        _pps = nalu;
-                    } else if (nalu_type == 5) {
-                        /*
-                        你当前的代码在发送I帧时，会先发送SPS包，然后发送PPS包，最后再发送I帧数据包。
-                        这三个包是通过UDP独立发送的。由于UDP是不可靠的协议，网络中的任何抖动都可能导致其中任意一个包（例如SPS或PPS包）丢失。
-                        如果客户端的解码器收到了I帧，但没有收到解码它所必需的SPS或PPS，就会报告 Missing reference picture 或类似的错误，
-                        并尝试“隐藏错误”（concealing errors），这通常表现为视频画面出现花屏、卡顿或灰色块。
-                        为了解决这个问题，我们可以采用RTP的一个高级特性，叫做聚合包（Aggregation Packet），
-                        具体来说是 STAP-A (Single-Time Aggregation Packet)。
-                        STAP-A 允许我们将多个小的NALU（如SPS、PPS和I帧）捆绑成一个单一的RTP包来发送。
-                        这样做的好处是，它们要么一起成功到达，要么一起丢失。
-                        这就从根本上避免了解码器收到一个不完整的关键帧数据，从而大大提高了在有损网络下的视频播放稳定性。
-                         */
-                        const size_t mtu = 1400;
-                        if (!_sps.empty() && !_pps.empty()) {
-                            size_t sps_size = _sps.size();
-                            size_t pps_size = _pps.size();
-                            size_t nalu_size = nalu.size();
-                            size_t total_nalu_size = 1 + (2 + sps_size) + (2 + pps_size) + (2 + nalu_size);
-                            
-                            if (total_nalu_size + 12 <= mtu) { // STAP-A
-                                uint8_t stap_header = (nalu[0] & 0x60) | 24;
-                                std::vector<uint8_t> payload;
-                                payload.push_back(stap_header);
-                                payload.push_back(sps_size >> 8); payload.push_back(sps_size & 0xFF); payload.insert(payload.end(), _sps.begin(), _sps.end());
-                                payload.push_back(pps_size >> 8); payload.push_back(pps_size & 0xFF); payload.insert(payload.end(), _pps.begin(), _pps.end());
-                                payload.push_back(nalu_size >> 8); payload.push_back(nalu_size & 0xFF); payload.insert(payload.end(), nalu.begin(), nalu.end());
-                                
-                                auto rtp_header = buildRtpHeader(_seqVideo++, _timestampVideo, _ssrcVideo, 96, true);
-                                std::vector<uint8_t> packet = rtp_header;
-                                packet.insert(packet.end(), payload.begin(), payload.end());
-                                _videoRtpConn->sendInLoop(std::string((char*)packet.data(), packet.size()));
-                            } else {
-                                sendH264FrameUdp(_sps);
-                                sendH264FrameUdp(_pps);
-                                sendH264FrameUdp(nalu);
-                            }
-                        } else {
-                            if (!_sps.empty()) sendH264FrameUdp(_sps);
-                            if (!_pps.empty()) sendH264FrameUdp(_pps);
-                            sendH264FrameUdp(nalu);
-                        }
-                        _timestampVideo += 3600;
-                        nextVideoTime += milliseconds(40);
-                    } else {
-                        sendH264FrameUdp(nalu);
-                        _timestampVideo += 3600;
-                        nextVideoTime += milliseconds(40);
-                    }
-                } else if (status == ReadStatus::Eof) {
-                    LOG_INFO("H264 Read completed.");
-                    _running = false;
-                    return;
-                } else {
-                    LOG_ERROR("H264 read error.");
-                    _running = false;
-                    return;
-                }
-            }
-            // 再处理音频帧
-            if (now >= nextAudioTime) {
-                std::vector<uint8_t> aac;
-                auto status = _audioReader->readFrame(aac);
-                if (status == ReadStatus::Ok && _running) {
-                    sendAacFrameUdp(aac);
-                    _timestampAudio += 1920;
-                    nextAudioTime += milliseconds(21);
-                } else if (status == ReadStatus::Eof) {
-                    LOG_INFO("AAC Read completed.");
-                    _running = false;
-                    return;
-                } else {
-                    LOG_ERROR("AAC read error.");
-                    _running = false;
-                    return;
-                }
-            }
-        });
+    probeAudioSampleRate();
+    _rtcp.setClockRate(RtcpSession::kVideo, 90000);
+    _rtcp.setClockRate(RtcpSession::kAudio, _audioSampleRate);
+    scheduleRtcp(RtcpSession::kFirstReportMs);
+    reserveBatches();
+    if (_hub) {
+        subscribeHub();
+        return;
+    }
+    auto source = _videoReader ? _videoReader->source() : nullptr;
+    if (_payloadCacheEnabled && source && source->codec() == MediaCodec::H264) {
+        // 缓存还在后台构建时，这个会话按 NALU 自己打包
+        _payloadCache = source->rtpPayloadCache();
+        _videoSource = source;
+    }
+    _nextVideoTime = steady_clock::now();
+    _nextAudioTime = _nextVideoTime;
+    schedulePacing();
+}
+
+void RtpPusher::probeAudioSampleRate() {
+    // 音频 RTP 时钟就是采样率，取自第一帧 ADTS 头；直播时 StreamHub 读的是同一个文件
+    auto audio = _audioReader ? _audioReader->source() : nullptr;
+    if (audio && audio->frameCount() > 0) {
+        AacConfig config;
+        const MediaFrame& first = audio->frame(0);
+        if (parseAdtsConfig(audio->frameData(first), first.size, config)) {
+            _audioSampleRate = config.sampleRate;
+        }
+    }
+}
+
+void RtpPusher::setRtcpConnections(std::shared_ptr<UdpConnection> videoRtcpConn,
+                                   std::shared_ptr<UdpConnection> audioRtcpConn) {
+    _videoRtcpConn = videoRtcpConn;
+    _audioRtcpConn = audioRtcpConn;
+}
+
+void RtpPusher::scheduleRtcp(int delayMs) {
+    std::weak_ptr<RtpPusher> weakSelf = shared_from_this();
+    _rtcpTimer = eventLoop()->addOneTimer(delayMs, [weakSelf]() {
+        auto self = weakSelf.lock();
+        if (self) {
+            self->rtcpTick();
+        }
+    });
+}
+
+void RtpPusher::rtcpTick() {
+    _rtcpTimer = 0;
+    if (!_running) {
+        return;
+    }
+    if (!_paused) {
+        // 暂停时 RTP 时钟不走，外推出的时间戳没有意义
+        _rtcp.setClockRate(RtcpSession::kAudio, _audioSampleRate);
+        sendSenderReport(RtcpSession::kVideo);
+        sendSenderReport(RtcpSession::kAudio);
+    }
+    scheduleRtcp(_rtcp.nextIntervalMs());
+}
+
+void RtpPusher::sendSenderReport(RtcpSession::Stream stream) {
+    uint8_t report[RtcpSession::kMaxPacketSize];
+    size_t len = _rtcp.buildSenderReport(stream, report, sizeof(report));
+    if (len == 0) {
+        return;
+    }
+    if (!_useUdp) {
+        // 和 RTP 一样挂到发送链上，interleaved 通道号是 RTP 通道加一
+        PacketPtr packet = PacketBuffer::alloc();
+        ::memcpy(packet->append(len), report, len);
+        uint8_t* p = packet->prepend(4);
+        p[0] = '$';
+        p[1] = stream == RtcpSession::kVideo ? 1 : 3;
+        p[2] = uint8_t(len >> 8);
+        p[3] = uint8_t(len & 0xFF);
+        _conn->send(packet);
+        return;
+    }
+    const std::shared_ptr<UdpConnection>& conn = stream == RtcpSession::kVideo ? _videoRtcpConn : _audioRtcpConn;
+    if (conn) {
+        struct iovec iov;
+        iov.iov_base = report;
+        iov.iov_len = len;
+        conn->sendBatch(&iov, 1);
+    }
+}
+
+void RtpPusher::handleRtcp(const uint8_t* data, size_t len) {
+    _rtcp.handlePacket(data, len);
+    if (_useUdp && _nackEnabled) {
+        retransmit(RtcpSession::kVideo);
+        retransmit(RtcpSession::kAudio);
+    }
+    const RtcpReceiverStats& video = _rtcp.receiverStats(RtcpSession::kVideo);
+    LOG_DEBUG("[RTCP] video loss %.1f%% (cumulative %d), jitter %.1f ms, rtt %.1f ms",
+              video.lossPercent(), video.cumulativeLost, video.jitterMs, video.rttMs);
+    if (video.reports == 0) {
+        return;
+    }
+    bool lossy = video.lossPercent() > kLossWarnPercent;
+    if (lossy != _lossy) {
+        _lossy = lossy;
+        if (lossy) {
+            LOG_WARN("RtpPusher %p: client reports %.1f%% video loss, jitter %.1f ms, rtt %.1f ms",
+                     this, video.lossPercent(), video.jitterMs, video.rttMs);
+        } else {
+            LOG_INFO("RtpPusher %p: client video loss back to %.1f%%", this, video.lossPercent());
+        }
+    }
+}
+
+void RtpPusher::retransmit(RtcpSession::Stream stream) {
+    using namespace std::chrono;
+    const std::vector<uint16_t>& seqs = _rtcp.nacks(stream);
+    if (seqs.empty()) {
+        return;
+    }
+    bool isVideo = stream == RtcpSession::kVideo;
+    RtpHistory& history = isVideo ? _videoHistory : _audioHistory;
+    auto now = steady_clock::now();
+    // 重传包到达之前客户端可能再次 NACK 同一个包，一个 RTT 内的重复请求不理会
+    double rttMs = _rtcp.receiverStats(stream).rttMs;
+    int intervalMs = rttMs > kMinResendIntervalMs ? int(rttMs) : kMinResendIntervalMs;
+    auto resendInterval = milliseconds(intervalMs);
+    auto window = milliseconds(int(kRetransmitWindowMs));
+    _resendIovs.clear();
+    _resendSegments.clear();
+    _rtxPackets.clear();
+    for (uint16_t seq : seqs) {
+        ++_retransmitStats.requested;
+        RtpHistory::Entry* entry = history.find(seq, now, window);
+        if (!entry) {
+            ++_retransmitStats.missed;
+            continue;
+        }
+        if (entry->resends > 0 && now - entry->resentAt < resendInterval) {
+            ++_retransmitStats.suppressed;
+            continue;
+        }
+        entry->resentAt = now;
+        ++entry->resends;
+        const uint8_t* rtp = entry->rtp();
+        struct iovec segs[2];
+        if (!_rtxEnabled) {
+            // 原样重发，包还在池里的缓冲区中（载荷可能在外挂段里），直接引用
+            size_t n = entry->packet->fillIovec(segs, entry->offset);
+            _resendIovs.insert(_resendIovs.end(), segs, segs + n);
+            _resendSegments.push_back(uint8_t(n));
+            continue;
+        }
+        // RFC 4588：RTX 包有自己的 SSRC 和序号，时间戳和 marker 沿用原包，载荷前面加 2 字节原序号
+        size_t payloadLen = entry->rtpSize() - kRtpHeaderSize;
+        PacketPtr packet = PacketBuffer::alloc();
+        uint8_t* p = packet->append(2 + payloadLen);
+        if (!p) {
+            continue;
+        }
+        p[0] = rtp[2];
+        p[1] = rtp[3];
+        p += 2;
+        size_t n = entry->packet->fillIovec(segs, entry->offset + kRtpHeaderSize);
+        for (size_t i = 0; i < n; ++i) {
+            ::memcpy(p, segs[i].iov_base, segs[i].iov_len);
+            p += segs[i].iov_len;
+        }
+        uint32_t timestamp = uint32_t(rtp[4]) << 24 | uint32_t(rtp[5]) << 16 | uint32_t(rtp[6]) << 8 | rtp[7];
+        bool marker = (rtp[1] & 0x80) != 0;
+        uint8_t* h = packet->prepend(kRtpHeaderSize);
+        if (isVideo) {
+            writeRtpHeader(h, _seqVideoRtx++, timestamp, _ssrcVideoRtx, kRtpPayloadTypeH264Rtx, marker);
+        } else {
+            writeRtpHeader(h, _seqAudioRtx++, timestamp, _ssrcAudioRtx, kRtpPayloadTypeAacRtx, marker);
+        }
+        struct iovec iov;
+        iov.iov_base = packet->data();
+        iov.iov_len = packet->size();
+        _resendIovs.push_back(iov);
+        _resendSegments.push_back(1);
+        _rtxPackets.push_back(std::move(packet));
+    }
+    if (_resendSegments.empty()) {
+        return;
+    }
+    (isVideo ? _videoRtpConn : _audioRtpConn)->sendBatch(_resendIovs.data(), _resendSegments.data(),
+                                                         _resendSegments.size());
+    _retransmitStats.retransmitted += _resendSegments.size();
+    RtcpSession::countRetransmissions(_resendSegments.size());
+    _rtxPackets.clear();
+    LOG_DEBUG("[RTCP] NACK %s: %zu requested, %zu retransmitted", isVideo ? "video" : "audio",
+              seqs.size(), _resendSegments.size());
+}
+
+EventLoop* RtpPusher::eventLoop() const {
+    return _useUdp ? _videoRtpConn->getLoop() : _conn->getLoop();
+}
+
+void RtpPusher::schedulePacing() {
+    // 不再每个会话挂一个 1ms 周期定时器，而是交给所在 EventLoop 的调度器，到期时才被唤醒
+    _pacing = true;
+    MediaPacer::forLoop(eventLoop()).schedule(shared_from_this(), std::min(_nextVideoTime, _nextAudioTime));
+}
+
+void RtpPusher::cancelPacing() {
+    if (_pacing) {
+        _pacing = false;
+        MediaPacer::forLoop(eventLoop()).cancel(this);
+    }
+}
+
+bool RtpPusher::onPace(std::chrono::steady_clock::time_point now,
+                       std::chrono::steady_clock::time_point& nextDue) {
+    using namespace std::chrono;
+    if (!_running || _paused) {
+        _pacing = false;
+        return false;
+    }
+    // 先处理视频帧，SPS/PPS 不占帧时间，接着读到下一个真正的帧为止，每次最多发一帧
+    if (now >= _nextVideoTime) {
+        uint32_t frameTimestamp = _timestampVideo;  // 每次最多一帧，SPS/PPS 不推进时间戳
+        bool isFrame = false;
+        ReadStatus status = ReadStatus::Ok;
+        while (status == ReadStatus::Ok && !isFrame && _running) {
+            status = sendVideoFrame(isFrame);
+        }
+        if (status == ReadStatus::Eof) {
+            LOG_INFO("H264 Read completed.");
+            _running = false;
+        } else if (status != ReadStatus::Ok) {
+            LOG_ERROR("H264 read error.");
+            _running = false;
+        } else if (isFrame) {
+            // 这一帧的 RTP 时间戳对应它的计划发送时刻，SR 从这里外推
+            _rtcp.onRtpTimestamp(RtcpSession::kVideo, frameTimestamp, _nextVideoTime);
+            _nextVideoTime += milliseconds(40);
+        }
+    }
+    // 再处理音频帧
+    if (_running && now >= _nextAudioTime) {
+        size_t frames = 0;
+        uint32_t audioTimestamp = _timestampAudio;
+        auto status = sendAacFrames(frames);
+        if (status == ReadStatus::Ok && _running) {
+            _rtcp.onRtpTimestamp(RtcpSession::kAudio, audioTimestamp, _nextAudioTime);
+            _nextAudioTime += microseconds(AacAggregator::framesDurationUs(frames, _audioSampleRate));
+        } else if (status == ReadStatus::Eof) {
+            LOG_INFO("AAC Read completed.");
+            _running = false;
+        } else {
+            LOG_ERROR("AAC read error.");
+            _running = false;
+        }
+    }
+    flushBatches();
+    if (!_running) {
+        _pacing = false;
+        return false;
+    }
+    nextDue = std::min(_nextVideoTime, _nextAudioTime);
+    return true;
+}
+
+void RtpPusher::reserveBatches() {
+    // 预打包缓存还没建好时不知道最大的帧有多大，视频部分按需增长
+    auto source = _videoReader ? _videoReader->source() : nullptr;
+    const RtpPayloadCache* cache = source ? source->rtpPayloadCache() : nullptr;
+    size_t video = cache ? cache->maxFramePackets() : 0;
+    size_t audio = AacAggregator::framesPerBudget(_audioSampleRate);
+    if (_hub) {
+        // 共享包的头和外挂段各占一个 iovec
+        _hubVideoIovs.reserve(video * 2);
+        _hubVideoSegments.reserve(video);
+        _hubAudioIovs.reserve(audio * 2);
+        _hubAudioSegments.reserve(audio);
+    } else if (_useUdp) {
+        _videoBatch.reserve(video);
+        _audioBatch.reserve(audio);
+        _videoRtpConn->reserveBatch(video);
+        _audioRtpConn->reserveBatch(audio);
     } else {
-        this->_timerId = _conn->addPeriodicTimer(0, 1, [this, startTime, nextVideoTime, nextAudioTime]() mutable {
-            // if (this->_timerId == 0) return; // 已经移除，不再做任何事
-            auto now = steady_clock::now();
-            if(!_running){
-                if (this->_timerId != 0) {
-                    _conn->removeTimer(_timerId);
-                    this->_timerId = 0;
-                }
-                return;
-            }
-            // 先处理视频帧
-            if (now >= nextVideoTime) {
-                std::vector<uint8_t> nalu;
-                auto status = _videoReader->readFrame(nalu);
-                if (status == ReadStatus::Ok && _running) {
-                    uint8_t nalu_type = nalu[0] & 0x1F;
-                    if (nalu_type == 7) {
-                        _sps = nalu;
-                    } else if (nalu_type == 8) {
-                        _pps = nalu;
-                    } else if (nalu_type == 5) {
-                        if (!_sps.empty()) sendH264Frame(_sps);
-                        if (!_pps.empty()) sendH264Frame(_pps);
-                        sendH264Frame(nalu);
-                        _timestampVideo += 3600;
-                        nextVideoTime += milliseconds(40);
-                    } else {
-                        sendH264Frame(nalu);
-                        _timestampVideo += 3600;
-                        nextVideoTime += milliseconds(40);
-                    }
-                } else if (status == ReadStatus::Eof) {
-                    LOG_INFO("H264 Read completed.");
-                    _running = false;
-                    return;
-                } else {
-                    LOG_ERROR("H264 read error.");
-                    _running = false;
-                    return;
-                }
-            }
-            // 再处理音频帧
-            if (now >= nextAudioTime) {
-                std::vector<uint8_t> aac;
-                auto status = _audioReader->readFrame(aac);
-                if (status == ReadStatus::Ok && _running) {
-                    sendAacFrame(aac);
-                    _timestampAudio += 1920;
-                    nextAudioTime += milliseconds(21);
-                } else if (status == ReadStatus::Eof) {
-                    LOG_INFO("AAC Read completed.");
-                    _running = false;
-                    return;
-                } else {
-                    LOG_ERROR("AAC read error.");
-                    _running = false;
-                    return;
-                }
-            }
-        });
+        _tcpBatch.reserve(video + audio);
+    }
+}
+
+void RtpPusher::flushBatches() {
+    // 一个节拍内的包整批发出：TCP 一次 sendmsg，UDP 视频、音频各一次 sendmmsg；clear 保留容量，稳态下不再分配。
+    // 音频批次很小，不铺开
+    if (!_tcpBatch.empty()) {
+        _conn->sendBatch(_tcpBatch);
+        _tcpBatch.clear();
+    }
+    if (_useUdp && _nackEnabled && (!_videoBatch.empty() || !_audioBatch.empty())) {
+        // 发出的包记进历史等 NACK，只加引用计数
+        auto now = std::chrono::steady_clock::now();
+        for (const PacketPtr& packet : _videoBatch) {
+            _videoHistory.store(packet, 0, now);
+        }
+        for (const PacketPtr& packet : _audioBatch) {
+            _audioHistory.store(packet, 0, now);
+        }
+    }
+    if (!_videoBatch.empty()) {
+        _videoRtpConn->sendBatchInLoop(_videoBatch, kVideoSpreadNs);
+        _videoBatch.clear();
+    }
+    if (!_audioBatch.empty()) {
+        _audioRtpConn->sendBatchInLoop(_audioBatch);
+        _audioBatch.clear();
+    }
+}
+
+ReadStatus RtpPusher::sendVideoFrame(bool& isFrame) {
+    if (_payloadCache) {
+        return sendCachedH264Frame(isFrame);
+    }
+    std::vector<uint8_t>& nalu = _nalu;    // 复用同一块内存，读取时不再每帧分配
+    auto status = _videoReader->readFrame(nalu);
+    if (status != ReadStatus::Ok) {
+        return status;
+    }
+    uint8_t nalu_type = nalu[0] & 0x1F;
+    if (nalu_type == 7) {
+        _sps = nalu;
+        return status;
+    } else if (nalu_type == 8) {
+        _pps = nalu;
+        return status;
+    }
+    if (!admitVideoFrame(frameKind(nalu_type, nalu[0]))) {
+        // 丢掉的帧照常占用帧时间，时间戳继续前进，RTP 序号不受影响
+    } else if (nalu_type == 5 && _useUdp) {
+        sendH264KeyFrameUdp(nalu);
+    } else if (nalu_type == 5) {
+        if (!_sps.empty()) sendH264Nalu(_sps);
+        if (!_pps.empty()) sendH264Nalu(_pps);
+        sendH264Nalu(nalu);
+    } else {
+        sendH264Nalu(nalu);
+    }
+    _timestampVideo += 3600;
+    isFrame = true;
+    return status;
+}
+
+void RtpPusher::sendH264KeyFrameUdp(const std::vector<uint8_t>& nalu) {
+    /*
+    你当前的代码在发送I帧时，会先发送SPS包，然后发送PPS包，最后再发送I帧数据包。
+    这三个包是通过UDP独立发送的。由于UDP是不可靠的协议，网络中的任何抖动都可能导致其中任意一个包（例如SPS或PPS包）丢失。
+    如果客户端的解码器收到了I帧，但没有收到解码它所必需的SPS或PPS，就会报告 Missing reference picture 或类似的错误，
+    并尝试“隐藏错误”（concealing errors），这通常表现为视频画面出现花屏、卡顿或灰色块。
+    为了解决这个问题，我们可以采用RTP的一个高级特性，叫做聚合包（Aggregation Packet），
+    具体来说是 STAP-A (Single-Time Aggregation Packet)。
+    STAP-A 允许我们将多个小的NALU（如SPS、PPS和I帧）捆绑成一个单一的RTP包来发送。
+    这样做的好处是，它们要么一起成功到达，要么一起丢失。
+    这就从根本上避免了解码器收到一个不完整的关键帧数据，从而大大提高了在有损网络下的视频播放稳定性。
+     */
+    const size_t mtu = 1400;
+    if (!_sps.empty() && !_pps.empty()) {
+        size_t sps_size = _sps.size();
+        size_t pps_size = _pps.size();
+        size_t nalu_size = nalu.size();
+        size_t total_nalu_size = 1 + (2 + sps_size) + (2 + pps_size) + (2 + nalu_size);
+
+        if (total_nalu_size + 12 <= mtu) { // STAP-A
+            // 直接在池里的缓冲区中拼 STAP-A 载荷，RTP 头写在预留的 headroom 里
+            PacketPtr packet = PacketBuffer::alloc();
+            uint8_t* p = packet->append(total_nalu_size);
+            *p++ = (nalu[0] & 0x60) | 24;
+            *p++ = sps_size >> 8; *p++ = sps_size & 0xFF; ::memcpy(p, _sps.data(), sps_size); p += sps_size;
+            *p++ = pps_size >> 8; *p++ = pps_size & 0xFF; ::memcpy(p, _pps.data(), pps_size); p += pps_size;
+            *p++ = nalu_size >> 8; *p++ = nalu_size & 0xFF; ::memcpy(p, nalu.data(), nalu_size);
+            sendRtpPacket(true, std::move(packet), true);
+        } else {
+            sendH264Nalu(_sps);
+            sendH264Nalu(_pps);
+            sendH264Nalu(nalu);
+        }
+    } else {
+        if (!_sps.empty()) sendH264Nalu(_sps);
+        if (!_pps.empty()) sendH264Nalu(_pps);
+        sendH264Nalu(nalu);
     }
 }
 
 void RtpPusher::stop(){
     _running = false;
-    if (_timerId != 0) {
-        if (_useUdp) {
-            _videoRtpConn->removeTimer(_timerId);
-        } else if (_conn) {
-            _conn->removeTimer(_timerId);
+    if (_dropStats.frames() > 0) {
+        LOG_INFO("RtpPusher stopped, dropped %llu non-reference frames, %llu frames in %llu gops, %llu congestions",
+                 (unsigned long long)_dropStats.nonRefFrames, (unsigned long long)_dropStats.gopFrames,
+                 (unsigned long long)_dropStats.gops, (unsigned long long)_dropStats.congestions);
+    }
+    for (int i = 0; i < 2; ++i) {
+        const RtcpReceiverStats& r = _rtcp.receiverStats(RtcpSession::Stream(i));
+        if (r.reports > 0) {
+            LOG_INFO("RtpPusher stopped, %s: %llu receiver reports, last loss %.1f%% (cumulative %d), jitter %.1f ms, rtt %.1f ms",
+                     i == RtcpSession::kVideo ? "video" : "audio", (unsigned long long)r.reports,
+                     r.lossPercent(), r.cumulativeLost, r.jitterMs, r.rttMs);
         }
-        _timerId = 0;
     }
+    if (_retransmitStats.requested > 0) {
+        LOG_INFO("RtpPusher stopped, NACK: %llu requested, %llu retransmitted%s, %llu suppressed, %llu too old",
+                 (unsigned long long)_retransmitStats.requested, (unsigned long long)_retransmitStats.retransmitted,
+                 _rtxEnabled ? " as RTX" : "", (unsigned long long)_retransmitStats.suppressed,
+                 (unsigned long long)_retransmitStats.missed);
+    }
+    if (_rtcpTimer) {
+        eventLoop()->removeTimer(_rtcpTimer);
+        _rtcpTimer = 0;
+    }
+    _videoHistory.clear();
+    _audioHistory.clear();
+    if (_hub) {
+        _hub->unsubscribe(this);
+    }
+    cancelPacing();
 }
 
-void RtpPusher::sendH264Frame(const std::vector<uint8_t>& nalu) {
-    const size_t mtu = 1400;
-    if (nalu.size() + 12 <= mtu) {
-        auto header = buildRtpHeader(_seqVideo++, _timestampVideo, _ssrcVideo, 96, true);
-        std::vector<uint8_t> packet = header;
-        packet.insert(packet.end(), nalu.begin(), nalu.end());
-        uint8_t prefix[] = { '$', 0, uint8_t(packet.size() >> 8), uint8_t(packet.size() & 0xFF) };
-        _conn->sendInLoop(std::string((char*)prefix, 4) + std::string((char*)packet.data(), packet.size()));
+void RtpPusher::pause() {
+    if (_paused) {
+        return;
+    }
+    _paused = true;
+    if (_hub) {
+        // 直播没有可以保留的位置，暂停期间退订，恢复时重新订阅并从 GOP 缓存起播
+        _hub->unsubscribe(this);
+        _pendingBatches.clear();
+        _awaitingBurst = false;
+    }
+    cancelPacing();
+    LOG_INFO("RtpPusher paused, this=%p", this);
+}
+
+void RtpPusher::resume() {
+    if (!_paused) {
+        return;
+    }
+    _paused = false;
+    if (_hub) {
+        subscribeHub();
     } else {
-        uint8_t nal_header = nalu[0];
-        size_t pos = 1;
-        bool isStart = true;
-        while (pos < nalu.size()) {
-            size_t len = std::min(mtu - 14, nalu.size() - pos);
-            bool isLast = (pos + len == nalu.size());
-            uint8_t fu_ind = (nal_header & 0xE0) | 28;
-            uint8_t fu_hdr = (isStart ? 0x80 : 0x00) | (isLast ? 0x40 : 0x00) | (nal_header & 0x1F);
+        // 游标和 RTP 序号/时间戳都保持暂停前的状态，只重置发送节奏，避免恢复时一次补发整段暂停时长
+        _nextVideoTime = std::chrono::steady_clock::now();
+        _nextAudioTime = _nextVideoTime;
+        schedulePacing();
+    }
+    LOG_INFO("RtpPusher resumed, this=%p", this);
+}
 
-            std::vector<uint8_t> payload = { fu_ind, fu_hdr };
-            payload.insert(payload.end(), nalu.begin() + pos, nalu.begin() + pos + len);
+bool RtpPusher::seek(double npt, double& actualNpt) {
+    if (_hub || !_videoReader) {
+        return false;
+    }
+    auto video = _videoReader->source();
+    if (!video || video->codec() != MediaCodec::H264) {
+        return false;
+    }
+    const KeyFrame* key = video->findKeyFrame(npt > 0 ? uint64_t(npt * 1000) : 0);
+    if (!key || !_videoReader->seekFrame(key->frameIndex)) {
+        return false;
+    }
+    // 定位到 IDR 本身，SPS/PPS 取索引里记录的，发送 IDR 时照常带上
+    _spsIndex = key->spsIndex;
+    _ppsIndex = key->ppsIndex;
+    if (_spsIndex != kNoFrameIndex) {
+        const MediaFrame& sps = video->frame(_spsIndex);
+        _sps.assign(video->frameData(sps), video->frameData(sps) + sps.size);
+    }
+    if (_ppsIndex != kNoFrameIndex) {
+        const MediaFrame& pps = video->frame(_ppsIndex);
+        _pps.assign(video->frameData(pps), video->frameData(pps) + pps.size);
+    }
+    actualNpt = key->timestampMs / 1000.0;
 
-            auto header = buildRtpHeader(_seqVideo++, _timestampVideo, _ssrcVideo, 96, isLast);
-            std::vector<uint8_t> packet = header;
-            packet.insert(packet.end(), payload.begin(), payload.end());
+    // AAC 每帧固定 1024 个采样，直接换算出帧下标
+    auto audio = _audioReader ? _audioReader->source() : nullptr;
+    if (audio && audio->frameCount() > 0) {
+        probeAudioSampleRate();
+        _audioReader->seekFrame(size_t(key->timestampMs * _audioSampleRate / 1000 / kAacSamplesPerFrame));
+    }
+    _nextVideoTime = std::chrono::steady_clock::now();
+    _nextAudioTime = _nextVideoTime;
+    if (_pacing) {
+        schedulePacing();   // 播放中再次 PLAY 带 Range，立即按新位置发送
+    }
+    LOG_INFO("RtpPusher seek to npt=%.3f, key frame %zu at %.3f", npt, key->frameIndex, actualNpt);
+    return true;
+}
 
-            uint8_t prefix[] = { '$', 0, uint8_t(packet.size() >> 8), uint8_t(packet.size() & 0xFF) };
-            _conn->sendInLoop(std::string((char*)prefix, 4) + std::string((char*)packet.data(), packet.size()));
+void RtpPusher::getRtpInfo(uint16_t& videoSeq, uint32_t& videoTimestamp,
+                           uint16_t& audioSeq, uint32_t& audioTimestamp) const {
+    videoSeq = _seqVideo;
+    videoTimestamp = _timestampVideo;
+    audioSeq = _seqAudio;
+    audioTimestamp = _timestampAudio;
+}
 
-            pos += len;
-            isStart = false;
-        }
+void RtpPusher::subscribeHub() {
+    _awaitingBurst = true;
+    _hub->subscribe(shared_from_this(), eventLoop());
+}
+
+void RtpPusher::onStreamBurst(const HubGopPtr& gop) {
+    if (!_running || _paused) {
+        return;
+    }
+    // GOP 排在等待队列最前面，之后按 kBurstIntervalMs 加速发出，再接上实时批次
+    _pendingBatches.insert(_pendingBatches.begin(), gop->begin(), gop->end());
+    _awaitingBurst = false;
+    LOG_DEBUG("RtpPusher burst: %zu gop frames, %zu pending batches", gop->size(), _pendingBatches.size());
+    if (!_pendingBatches.empty() && !_bursting) {
+        _bursting = true;
+        burstTick();
     }
 }
 
-void RtpPusher::sendAacFrame(const std::vector<uint8_t>& aac) {
-    if (aac.size() < 7) return;
+void RtpPusher::onStreamPackets(const HubPacketBatchPtr& batch) {
+    if (!_running || _paused) {
+        return;
+    }
+    if (_awaitingBurst || _bursting) {
+        _pendingBatches.push_back(batch);
+        return;
+    }
+    sendHubBatch(*batch);
+}
 
-    auto header = buildRtpHeader(_seqAudio++, _timestampAudio, _ssrcAudio, 97, true);
-    uint16_t aacLen = aac.size();
-    uint8_t au_header[] = { 0x00, 0x10 }; // AU-headers-length: 16 bits
-    uint8_t au_data[] = {
-        uint8_t(aacLen >> 5),
-        uint8_t((aacLen & 0x1F) << 3)
+void RtpPusher::burstTick() {
+    if (!_running || _paused || _pendingBatches.empty()) {
+        _pendingBatches.clear();
+        _bursting = false;
+        return;
+    }
+    sendHubBatch(*_pendingBatches.front());
+    _pendingBatches.pop_front();
+    if (_pendingBatches.empty()) {
+        _bursting = false;
+        LOG_DEBUG("RtpPusher burst finished, switching to live");
+        return;
+    }
+    // 用一次性定时器串起来，避免在周期定时器回调里删除自己
+    std::weak_ptr<RtpPusher> weakSelf = shared_from_this();
+    auto cb = [weakSelf]() {
+        auto self = weakSelf.lock();
+        if (self) {
+            self->burstTick();
+        }
     };
+    if (_useUdp) {
+        _videoRtpConn->addOneTimer(kBurstIntervalMs, std::move(cb));
+    } else {
+        _conn->addOneTimer(kBurstIntervalMs, std::move(cb));
+    }
+}
 
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), au_header, au_header + 2);
-    payload.insert(payload.end(), au_data, au_data + 2);
-    payload.insert(payload.end(), aac.begin(), aac.end());
+void RtpPusher::sendHubBatch(const HubPacketBatch& batch) {
+    // 已经在本会话所在的 EventLoop 线程里，直接 send，不再经过 sendInLoop 拷贝
+    auto now = std::chrono::steady_clock::now();
+    if (!_bursting) {
+        // 实时批次刚由 StreamHub 打好，包里的时间戳就对应现在；补发的 GOP 是过去的数据，不能用来对时
+        bool seen[2] = {false, false};
+        for (const HubPacket& packet : batch) {
+            RtcpSession::Stream stream = packet.channel == 0 ? RtcpSession::kVideo : RtcpSession::kAudio;
+            if (!seen[stream]) {
+                const uint8_t* h = packet.data->data() + 4;
+                uint32_t timestamp = uint32_t(h[4]) << 24 | uint32_t(h[5]) << 16 | uint32_t(h[6]) << 8 | h[7];
+                _rtcp.onRtpTimestamp(stream, timestamp, now);
+                seen[stream] = true;
+            }
+        }
+    }
+    if (_useUdp) {
+        // UDP 下按通道收集共享包的 iovec（跳过 interleaved 前缀，外挂段另占一个），各用一次 sendmmsg 发出，不拷贝包内容
+        _hubVideoIovs.clear();
+        _hubAudioIovs.clear();
+        _hubVideoSegments.clear();
+        _hubAudioSegments.clear();
+        for (const HubPacket& packet : batch) {
+            struct iovec segs[2];
+            size_t n = packet.data->fillIovec(segs, 4);
+            std::vector<struct iovec>& iovs = packet.channel == 0 ? _hubVideoIovs : _hubAudioIovs;
+            iovs.insert(iovs.end(), segs, segs + n);
+            (packet.channel == 0 ? _hubVideoSegments : _hubAudioSegments).push_back(uint8_t(n));
+            if (_nackEnabled) {
+                // 共享包本来就被 GOP 缓存和其他订阅者引用着，记进历史不多占内存
+                (packet.channel == 0 ? _videoHistory : _audioHistory).store(packet.data, 4, now);
+            }
+            _rtcp.onRtpSent(packet.channel == 0 ? RtcpSession::kVideo : RtcpSession::kAudio,
+                            packet.data->totalSize() - 4 - kRtpHeaderSize);
+        }
+        _videoRtpConn->sendBatch(_hubVideoIovs.data(), _hubVideoSegments.data(), _hubVideoSegments.size(),
+                                 _bursting ? kBurstSpreadNs : kVideoSpreadNs);
+        _audioRtpConn->sendBatch(_hubAudioIovs.data(), _hubAudioSegments.data(), _hubAudioSegments.size());
+        return;
+    }
+    // 一个批次最多一帧视频：按其中的 NALU 类型决定这一帧是否发送，音频总是发送。
+    // 共享包的序号由 StreamHub 统一分配，丢掉的帧在客户端表现为序号缺口，解码器据此知道有丢失
+    bool hasVideo = false;
+    FrameKind kind = FrameKind::NonReference;
+    for (const HubPacket& packet : batch) {
+        if (packet.channel != 0) {
+            continue;
+        }
+        hasVideo = true;
+        // 单个 NALU 的载荷整个在外挂段里，按偏移取字节
+        const size_t payload = 4 + kRtpHeaderSize;
+        uint8_t nalHeader = packet.data->byteAt(payload);
+        uint8_t type = nalHeader & 0x1F;
+        if (type == 28) {
+            type = packet.data->byteAt(payload + 1) & 0x1F;   // FU-A：真实类型在 FU 头里，NRI 在 FU 指示字节里
+        } else if (type == 24) {
+            type = 5;                   // STAP-A 只用于 SPS+PPS+IDR
+        }
+        FrameKind packetKind = frameKind(type, nalHeader);
+        if (packetKind == FrameKind::Key || (packetKind == FrameKind::Reference && kind != FrameKind::Key)) {
+            kind = packetKind;
+        }
+    }
+    bool sendVideo = !hasVideo || admitVideoFrame(kind);
+    // 前缀已经由 StreamHub 写好，共享包直接挂到发送链上，一次 sendmsg 写出
+    for (const HubPacket& packet : batch) {
+        if (packet.channel == 0 && !sendVideo) {
+            continue;
+        }
+        _rtcp.onRtpSent(packet.channel == 0 ? RtcpSession::kVideo : RtcpSession::kAudio,
+                        packet.data->totalSize() - 4 - kRtpHeaderSize);
+        _tcpBatch.push_back(packet.data);
+    }
+    _conn->sendBatch(_tcpBatch);
+    _tcpBatch.clear();
+}
 
-    std::vector<uint8_t> packet = header;
-    packet.insert(packet.end(), payload.begin(), payload.end());
+RtpPusher::FrameKind RtpPusher::frameKind(uint8_t nalType, uint8_t nalHeader) {
+    // SPS/PPS 随 IDR 一起发，按关键帧算；nal_ref_idc 为 0 的帧没有其他帧引用，可以单独丢
+    if (nalType == 5 || nalType == 7 || nalType == 8) {
+        return FrameKind::Key;
+    }
+    return (nalHeader & 0x60) ? FrameKind::Reference : FrameKind::NonReference;
+}
 
-    uint8_t prefix[] = { '$', 2, uint8_t(packet.size() >> 8), uint8_t(packet.size() & 0xFF) };
-    _conn->sendInLoop(std::string((char*)prefix, 4) + std::string((char*)packet.data(), packet.size()));
+bool RtpPusher::admitVideoFrame(FrameKind kind) {
+    if (_useUdp || !_conn) {
+        return true;
+    }
+    bool above = _conn->aboveHighWaterMark();
+    if (!_congested && above) {
+        _congested = true;
+        ++_dropStats.congestions;
+        LOG_WARN("RtpPusher fd %d congested: %zu bytes buffered, dropping frames",
+                 _conn->getFd(), _conn->bufferedBytes());
+    } else if (_congested && !_awaitingIdr && _conn->belowLowWaterMark()) {
+        _congested = false;
+        LOG_INFO("RtpPusher fd %d drained to %zu bytes, resume sending (dropped %llu frames, %llu gops so far)",
+                 _conn->getFd(), _conn->bufferedBytes(),
+                 (unsigned long long)_dropStats.frames(), (unsigned long long)_dropStats.gops);
+    }
+    if (!_congested) {
+        return true;
+    }
+    if (_awaitingIdr) {
+        if (kind == FrameKind::Key && !above) {
+            _awaitingIdr = false;
+            return true;
+        }
+        ++_dropStats.gopFrames;
+        return false;
+    }
+    if (kind == FrameKind::NonReference) {
+        ++_dropStats.nonRefFrames;
+        return false;
+    }
+    if (above) {
+        // 参考帧丢了，后面的帧都解不出来，干脆丢到下一个 IDR
+        _awaitingIdr = true;
+        ++_dropStats.gops;
+        ++_dropStats.gopFrames;
+        return false;
+    }
+    return true;
 }
 
-void RtpPusher::sendH264FrameUdp(const std::vector<uint8_t>& nalu) {
+ReadStatus RtpPusher::sendCachedH264Frame(bool& isFrame) {
+    size_t idx = 0;
+    auto status = _videoReader->readFrameIndex(idx);
+    if (status != ReadStatus::Ok) {
+        return status;
+    }
+    const MediaFrame& frame = _videoSource->frame(idx);
+    // 只记下标，发送时从缓存里取；_sps/_pps 只给逐 NALU 打包的路径用
+    if (frame.type == 7) {
+        _spsIndex = idx;
+        return status;
+    } else if (frame.type == 8) {
+        _ppsIndex = idx;
+        return status;
+    }
+    const RtpPayload* stap = _useUdp ? _payloadCache->stapA(idx) : nullptr;
+    if (!admitVideoFrame(frameKind(frame.type, _videoSource->frameData(frame)[0]))) {
+        // 丢掉的帧照常占用帧时间
+    } else if (stap) {
+        // UDP 下 SPS+PPS+IDR 打成一个 STAP-A，避免单独丢失参数集
+        sendCachedPayload(*stap);
+    } else {
+        if (frame.type == 5) {
+            if (_spsIndex != kNoFrameIndex) sendCachedNalu(_spsIndex);
+            if (_ppsIndex != kNoFrameIndex) sendCachedNalu(_ppsIndex);
+        }
+        sendCachedNalu(idx);
+    }
+    _timestampVideo += 3600;
+    isFrame = true;
+    return status;
+}
+
+void RtpPusher::sendCachedNalu(size_t nalIndex) {
+    for (auto p = _payloadCache->payloadsBegin(nalIndex); p != _payloadCache->payloadsEnd(nalIndex); ++p) {
+        sendCachedPayload(*p);
+    }
+}
+
+void RtpPusher::sendCachedPayload(const RtpPayload& payload) {
+    // 缓存在会话期间不变，外挂段持有 MediaSource 的引用，包还在发送链或重传历史里时映射不会被解除
+    PacketPtr packet = PacketBuffer::alloc();
+    if (payload.bodySize == 0) {
+        packet->attachTail(_payloadCache->head(payload), payload.headSize, _videoSource);
+    } else {
+        ::memcpy(packet->append(payload.headSize), _payloadCache->head(payload), payload.headSize);
+        packet->attachTail(_payloadCache->body(payload), payload.bodySize, _videoSource);
+    }
+    sendRtpPacket(true, std::move(packet), payload.marker);
+}
+
+ReadStatus RtpPusher::sendAacFrames(size_t& frameCount) {
+    // 按延迟预算一次取出若干帧，去掉 ADTS 头后按 MTU 聚合成 RFC 3640 包
+    auto source = _audioReader->source();
+    _aacFrames.clear();
+    size_t maxFrames = 1;
+    ReadStatus status = ReadStatus::Ok;
+    while (_aacFrames.size() < maxFrames) {
+        const uint8_t* aac = nullptr;
+        size_t size = 0;
+        if (source) {
+            // 基于 MediaSource 的读取器直接引用映射的文件数据，不拷贝
+            size_t idx = 0;
+            status = _audioReader->readFrameIndex(idx);
+            if (status != ReadStatus::Ok) {
+                break;
+            }
+            const MediaFrame& frame = source->frame(idx);
+            aac = source->frameData(frame);
+            size = frame.size;
+        } else {
+            if (_aacScratch.size() <= _aacFrames.size()) {
+                _aacScratch.resize(_aacFrames.size() + 1);
+            }
+            std::vector<uint8_t>& buf = _aacScratch[_aacFrames.size()];
+            status = _audioReader->readFrame(buf);
+            if (status != ReadStatus::Ok) {
+                break;
+            }
+            aac = buf.data();
+            size = buf.size();
+        }
+        if (_aacFrames.empty()) {
+            AacConfig config;
+            if (parseAdtsConfig(aac, size, config)) {
+                _audioSampleRate = config.sampleRate;
+            }
+            maxFrames = AacAggregator::framesPerBudget(_audioSampleRate);
+        }
+        _aacFrames.emplace_back(aac, size);
+    }
+    if (_aacFrames.empty()) {
+        return status == ReadStatus::Ok ? ReadStatus::NoData : status;
+    }
+
+    for (const auto& frame : _aacFrames) {
+        if (_aacAggregator.append(frame.first, frame.second)) {
+            continue;
+        }
+        if (!_aacAggregator.empty()) {
+            flushAacPacket();
+            if (_aacAggregator.append(frame.first, frame.second)) {
+                continue;
+            }
+        }
+        sendAacFragments(frame.first, frame.second);
+    }
+    if (!_aacAggregator.empty()) {
+        flushAacPacket();
+    }
+    frameCount = _aacFrames.size();
+    return ReadStatus::Ok;
+}
+
+void RtpPusher::flushAacPacket() {
+    PacketPtr packet = PacketBuffer::alloc();
+    uint8_t* p = packet->append(_aacAggregator.payloadSize());
+    if (p) {
+        _aacAggregator.writePayload(p);
+        // RTP 时间戳是包内第一个 AU 的时间，后续 AU 依次顺延 1024 个采样
+        sendRtpPacket(false, std::move(packet), true);
+    }
+    _timestampAudio += kAacSamplesPerFrame * _aacAggregator.count();
+    _aacAggregator.clear();
+}
+
+void RtpPusher::sendAacFragments(const uint8_t* adtsFrame, size_t len) {
+    const uint8_t* au = nullptr;
+    size_t auSize = 0;
+    if (AacAggregator::auData(adtsFrame, len, au, auSize)) {
+        for (size_t pos = 0; pos < auSize;) {
+            size_t n = std::min(_aacAggregator.maxFragmentData(), auSize - pos);
+            PacketPtr packet = PacketBuffer::alloc();
+            AacAggregator::writeFragment(packet->append(4 + n), auSize, au + pos, n);
+            pos += n;
+            sendRtpPacket(false, std::move(packet), pos == auSize);
+        }
+    } else {
+        LOG_WARN("AAC frame of %zu bytes can not be packetized, dropped", len);
+    }
+    // 丢掉的帧也占一帧时间，后面的时间戳不能往前挪
+    _timestampAudio += kAacSamplesPerFrame;
+}
+
+void RtpPusher::sendRtpPacket(bool isVideo, const uint8_t* payload, size_t len, bool marker) {
+    // 载荷拷进池里的缓冲区，头部写在 headroom 里
+    PacketPtr packet = PacketBuffer::alloc();
+    uint8_t* p = packet->append(len);
+    if (!p) {
+        return;
+    }
+    ::memcpy(p, payload, len);
+    sendRtpPacket(isVideo, std::move(packet), marker);
+}
+
+void RtpPusher::sendRtpPacket(bool isVideo, PacketPtr&& packet, bool marker) {
+    _rtcp.onRtpSent(isVideo ? RtcpSession::kVideo : RtcpSession::kAudio, packet->totalSize());
+    size_t rtpLen = kRtpHeaderSize + packet->totalSize();
+    uint8_t* h = packet->prepend(kRtpHeaderSize);
+    if (isVideo) {
+        writeRtpHeader(h, _seqVideo++, _timestampVideo, _ssrcVideo, kRtpPayloadTypeH264, marker);
+    } else {
+        writeRtpHeader(h, _seqAudio++, _timestampAudio, _ssrcAudio, kRtpPayloadTypeAac, marker);
+    }
+    if (!_useUdp) {
+        uint8_t* p = packet->prepend(4);
+        p[0] = '$';
+        p[1] = isVideo ? 0 : 2;
+        p[2] = uint8_t(rtpLen >> 8);
+        p[3] = uint8_t(rtpLen & 0xFF);
+        // onPace 运行在本会话的 EventLoop 线程，节拍结束时整批挂到发送链上，不经过 sendInLoop 拷贝
+        _tcpBatch.push_back(std::move(packet));
+    } else if (isVideo) {
+        _videoBatch.push_back(std::move(packet));
+    } else {
+        _audioBatch.push_back(std::move(packet));
+    }
+}
+
+void RtpPusher::sendH264Nalu(const std::vector<uint8_t>& nalu) {
     const size_t mtu = 1400;
     if (nalu.size() + 12 <= mtu) {
-        auto header = buildRtpHeader(_seqVideo++, _timestampVideo, _ssrcVideo, 96, true);
-        std::vector<uint8_t> packet = header;
-        packet.insert(packet.end(), nalu.begin(), nalu.end());
-        
-        std::string packetStr((char*)packet.data(), packet.size());
-        _videoRtpConn->sendInLoop(packetStr);
+        sendRtpPacket(true, nalu.data(), nalu.size(), true);
     } else {
         uint8_t nal_header = nalu[0];
         size_t pos = 1;
@@ -317,15 +928,13 @@ void RtpPusher::sendH264FrameUdp(const std::vector<uint8_t>& nalu) {
             uint8_t fu_ind = (nal_header & 0xE0) | 28;
             uint8_t fu_hdr = (isStart ? 0x80 : 0x00) | (isLast ? 0x40 : 0x00) | (nal_header & 0x1F);
 
-            std::vector<uint8_t> payload = { fu_ind, fu_hdr };
-            payload.insert(payload.end(), nalu.begin() + pos, nalu.begin() + pos + len);
-
-            auto header = buildRtpHeader(_seqVideo++, _timestampVideo, _ssrcVideo, 96, isLast);
-            std::vector<uint8_t> packet = header;
-            packet.insert(packet.end(), payload.begin(), payload.end());
-
-            std::string packetStr((char*)packet.data(), packet.size());
-            _videoRtpConn->sendInLoop(packetStr);
+            // FU indicator/header 和分片数据直接写进池里的缓冲区
+            PacketPtr packet = PacketBuffer::alloc();
+            uint8_t* p = packet->append(2 + len);
+            p[0] = fu_ind;
+            p[1] = fu_hdr;
+            ::memcpy(p + 2, nalu.data() + pos, len);
+            sendRtpPacket(true, std::move(packet), isLast);
 
             pos += len;
             isStart = false;
@@ -333,25 +942,3 @@ void RtpPusher::sendH264FrameUdp(const std::vector<uint8_t>& nalu) {
     }
 }
 
-void RtpPusher::sendAacFrameUdp(const std::vector<uint8_t>& aac) {
-    if (aac.size() < 7) return;
-
-    auto header = buildRtpHeader(_seqAudio++, _timestampAudio, _ssrcAudio, 97, true);
-    uint16_t aacLen = aac.size();
-    uint8_t au_header[] = { 0x00, 0x10 }; // AU-headers-length: 16 bits
-    uint8_t au_data[] = {
-        uint8_t(aacLen >> 5),
-        uint8_t((aacLen & 0x1F) << 3)
-    };
-
-    std::vector<uint8_t> payload;
-    payload.insert(payload.end(), au_header, au_header + 2);
-    payload.insert(payload.end(), au_data, au_data + 2);
-    payload.insert(payload.end(), aac.begin(), aac.end());
-
-    std::vector<uint8_t> packet = header;
-    packet.insert(packet.end(), payload.begin(), payload.end());
-
-    std::string packetStr((char*)packet.data(), packet.size());
-    _audioRtpConn->sendInLoop(packetStr);
-}
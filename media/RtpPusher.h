@@ -4,12 +4,44 @@
 #include <memory>
 #include <atomic>
 #include <vector>
+#include <deque>
+#include <chrono>
 #include "MediaReader.h"
+#include "MediaSource.h"
+#include "RtpPayloadCache.h"
+#include "StreamHub.h"
+#include "MediaPacer.h"
+#include "AacPacketizer.h"
+#include "RtpHeader.h"
+#include "RtcpSession.h"
+#include "RtpHistory.h"
+#include "../reactor/PacketBuffer.h"
 #include "../reactor/TcpConnection.h"
 #include "../reactor/UdpConnection.h"
 
 enum class ReadStatus;
-class RtpPusher {
+
+// interleaved TCP 慢速客户端的丢帧统计（每个会话一份）
+struct RtpDropStats {
+    uint64_t congestions = 0;       // 越过高水位进入拥塞的次数
+    uint64_t nonRefFrames = 0;      // 丢掉的非参考帧
+    uint64_t gopFrames = 0;         // 整 GOP 丢弃阶段丢掉的帧（含触发它的参考帧/IDR）
+    uint64_t gops = 0;              // 整 GOP 丢弃的次数
+    uint64_t frames() const { return nonRefFrames + gopFrames; }
+};
+
+// UDP 下按 NACK 重传的统计（每个会话一份）
+struct RtpRetransmitStats {
+    uint64_t requested = 0;         // NACK 请求的序号数
+    uint64_t retransmitted = 0;
+    uint64_t suppressed = 0;        // 一个 RTT 内重复请求同一个包，不再重发
+    uint64_t missed = 0;            // 已经不在历史里（太旧或被覆盖）
+};
+
+class RtpPusher
+: public StreamSubscriber
+, public PacedStream
+, public std::enable_shared_from_this<RtpPusher> {
 public:
     RtpPusher();
     RtpPusher(std::shared_ptr<TcpConnection> conn,
@@ -23,16 +55,102 @@ public:
 
     void start();
     void stop();
+    bool isRunning() const { return _running; }
+
+    // 暂停时保留游标、RTP 序号和定时器，resume() 从暂停处继续
+    void pause();
+    void resume();
+    bool isPaused() const { return _paused; }
+    // 定位到不晚于 npt（秒）的最近 IDR，音频对齐到同一时间，actualNpt 返回实际起播位置；直播不支持
+    bool seek(double npt, double& actualNpt);
+    // 下一个要发送的 RTP 包的序号和时间戳，用于 PLAY 响应的 RTP-Info
+    void getRtpInfo(uint16_t& videoSeq, uint32_t& videoTimestamp,
+                    uint16_t& audioSeq, uint32_t& audioTimestamp) const;
     
+    // TCP 下因对端消费跟不上而丢弃的帧，只在本会话的 EventLoop 线程里读
+    const RtpDropStats& dropStats() const { return _dropStats; }
+
+    // UDP 下发送 SR 用的 RTCP 连接（独占端口时是会话自己的 RTCP 套接字，共享套接字时经 UdpMux 的 RTCP 端口）；
+    // TCP 下 SR 走 interleaved 通道 1/3，不用设置
+    void setRtcpConnections(std::shared_ptr<UdpConnection> videoRtcpConn, std::shared_ptr<UdpConnection> audioRtcpConn);
+    // 客户端发来的 RTCP 复合包（UDP 或 interleaved 通道），在本会话的 EventLoop 线程中调用
+    void handleRtcp(const uint8_t* data, size_t len);
+    // 客户端汇报的丢包、抖动和 RTT，只在本会话的 EventLoop 线程里读
+    const RtcpSession& rtcp() const { return _rtcp; }
+    const RtpRetransmitStats& retransmitStats() const { return _retransmitStats; }
+
+    // UDP 会话是否保留最近发出的包、按 RTCP NACK 重传，默认开启；TCP 本身可靠，不受影响
+    static void setNackEnabled(bool enabled) { _nackEnabled = enabled; }
+    static bool nackEnabled() { return _nackEnabled; }
+    // 重传是否按 RFC 4588 走单独的 RTX 负载类型和 SSRC（SDP 里随之声明），默认关闭，原样重发原包
+    static void setRtxEnabled(bool enabled) { _rtxEnabled = enabled; }
+    static bool rtxEnabled() { return _rtxEnabled; }
+    // 发出超过这个时长的包不再重传，播放器的抖动缓冲早已越过它；也写进 SDP 的 rtx-time
+    static const int kRetransmitWindowMs = 1000;
+
     void setTransportMode(bool useUdp, const InetAddress& videoAddr = InetAddress(), const InetAddress& audioAddr = InetAddress());
+
+    // 是否使用 RTP 预打包缓存（仅对基于 MediaSource 的 H264 读取器生效），默认开启
+    static void setPayloadCacheEnabled(bool enabled) { _payloadCacheEnabled = enabled; }
+
+    // 设置后 start() 不再自己读文件打包，而是订阅 StreamHub 转发共享的 RTP 包
+    void setStreamHub(const std::shared_ptr<StreamHub>& hub) { _hub = hub; }
+    void onStreamBurst(const HubGopPtr& gop) override;
+    void onStreamPackets(const HubPacketBatchPtr& batch) override;
+
+    // 由所在 EventLoop 的 MediaPacer 在到期时调用
+    bool onPace(std::chrono::steady_clock::time_point now,
+                std::chrono::steady_clock::time_point& nextDue) override;
     
 private:
-    void sendH264Frame(const std::vector<uint8_t>& nalu);
-    void sendAacFrame(const std::vector<uint8_t>& aac);
-    void sendLoop();
+    EventLoop* eventLoop() const;
+    void schedulePacing();
+    void cancelPacing();
+    // 读取并发送下一个视频 NALU，isFrame 表示是否发出了占用一个帧时间的 NALU（SPS/PPS 不算）
+    ReadStatus sendVideoFrame(bool& isFrame);
+    void sendH264KeyFrameUdp(const std::vector<uint8_t>& nalu);
+    void flushBatches();
+    // 按最大的一帧和一拍的音频帧数预留发送用的容器，偶尔来一个大帧时不用再扩容
+    void reserveBatches();
+
+    // 单 NALU 包或 FU-A 分片发送一个 NALU（未启用预打包缓存时）
+    void sendH264Nalu(const std::vector<uint8_t>& nalu);
+    void probeAudioSampleRate();
+
+    // RTCP：开始推流后尽快发第一个 SR，之后按随机化的间隔定期发送，暂停期间不发
+    void scheduleRtcp(int delayMs);
+    void rtcpTick();
+    void sendSenderReport(RtcpSession::Stream stream);
+    // 重传 RTCP NACK 请求的这一路的包，找不到或刚重传过的跳过
+    void retransmit(RtcpSession::Stream stream);
     
-    void sendH264FrameUdp(const std::vector<uint8_t>& nalu);
-    void sendAacFrameUdp(const std::vector<uint8_t>& aac);
+    // 按音频延迟预算读取若干 AAC 帧，聚合发送，frameCount 返回本次发送的帧数
+    ReadStatus sendAacFrames(size_t& frameCount);
+    void flushAacPacket();
+    // 单独一个包也放不下的 AAC 帧分片发送，无法打包时丢弃
+    void sendAacFragments(const uint8_t* adtsFrame, size_t len);
+
+    // 从预打包缓存取出下一个 NALU 的载荷发送，isFrame 表示该 NALU 是否占用一个视频帧时间
+    void subscribeHub();
+    void sendHubBatch(const HubPacketBatch& batch);
+    void burstTick();
+
+    /*
+    TCP 背压：发送链越过高水位后进入拥塞，先丢非参考帧；还在高水位以上时连参考帧也发不出，
+    后面整个 GOP 都依赖它，于是一直丢到下一个 IDR。回落到低水位以下才恢复正常发送。
+    UDP 没有发送链，总是放行。返回 false 表示这一帧不发。
+    */
+    enum class FrameKind { Key, Reference, NonReference };
+    bool admitVideoFrame(FrameKind kind);
+    static FrameKind frameKind(uint8_t nalType, uint8_t nalHeader);
+
+    ReadStatus sendCachedH264Frame(bool& isFrame);
+    void sendCachedNalu(size_t nalIndex);
+    // 缓存中的载荷不拷贝：NALU 数据作为外挂段引用文件映射，只有 FU 头拷进包里
+    void sendCachedPayload(const RtpPayload& payload);
+    void sendRtpPacket(bool isVideo, const uint8_t* payload, size_t len, bool marker);
+    // packet 里已写好载荷，在 headroom 中补上 RTP 头（TCP 再加 interleaved 前缀）后发出
+    void sendRtpPacket(bool isVideo, PacketPtr&& packet, bool marker);
     
     std::shared_ptr<TcpConnection> _conn;
     std::shared_ptr<UdpConnection> _videoRtpConn;
@@ -41,16 +159,76 @@ private:
     std::shared_ptr<MediaReader> _audioReader;
 
     std::atomic_bool _running;
+    bool _paused = false;
+    std::chrono::steady_clock::time_point _nextVideoTime;
+    std::chrono::steady_clock::time_point _nextAudioTime;
     uint16_t _seqVideo = 0;
     uint16_t _seqAudio = 0;
     uint32_t _timestampVideo = 0;
     uint32_t _timestampAudio = 0;
+    int _audioSampleRate = 44100;   // 音频 RTP 时钟，取自第一帧 ADTS 头
     const uint32_t _ssrcVideo = 0x12345678;
     const uint32_t _ssrcAudio = 0x87654321;
-    TimerId _timerId;
+    RtcpSession _rtcp{_ssrcVideo, _ssrcAudio};
+    std::shared_ptr<UdpConnection> _videoRtcpConn;
+    std::shared_ptr<UdpConnection> _audioRtcpConn;
+    TimerId _rtcpTimer = 0;
+    bool _lossy = false;    // 客户端汇报的视频丢包率超过 kLossWarnPercent，用于只在跨过阈值时打日志
+    static const int kLossWarnPercent = 5;
+    // 最近发出的包，按 NACK 重传；视频约 1.5 秒的量（IDR 也放得下），音频包少得多
+    static const size_t kVideoHistorySize = 128;
+    static const size_t kAudioHistorySize = 32;
+    // 同一个包至少隔一个 RTT 才再重传，RTT 还不知道或很小时按这个下限
+    static const int kMinResendIntervalMs = 20;
+    RtpHistory _videoHistory{kVideoHistorySize};
+    RtpHistory _audioHistory{kAudioHistorySize};
+    const uint32_t _ssrcVideoRtx = 0x12345679;
+    const uint32_t _ssrcAudioRtx = 0x87654322;
+    uint16_t _seqVideoRtx = 0;
+    uint16_t _seqAudioRtx = 0;
+    std::vector<struct iovec> _resendIovs;
+    std::vector<uint8_t> _resendSegments;   // 每个重传包占几个 iovec
+    std::vector<PacketPtr> _rtxPackets;
+    RtpRetransmitStats _retransmitStats;
+    static std::atomic_bool _nackEnabled;
+    static std::atomic_bool _rtxEnabled;
+    bool _pacing = false;   // 是否已在 MediaPacer 中排队
+    // 本节拍待发的 RTP 包，onPace 结束时整批发出：TCP 走发送链一次 sendmsg，UDP 各自 sendmmsg
+    std::vector<PacketPtr> _tcpBatch;
+    std::vector<PacketPtr> _videoBatch;
+    std::vector<PacketPtr> _audioBatch;
+    // 以下缓冲区在各节拍间复用，稳态下不再分配
+    std::vector<uint8_t> _nalu;
+    std::vector<std::pair<const uint8_t*, size_t>> _aacFrames;
+    std::vector<std::vector<uint8_t>> _aacScratch;  // 不基于 MediaSource 的音频读取器才用
+    std::vector<struct iovec> _hubVideoIovs;
+    std::vector<struct iovec> _hubAudioIovs;
+    std::vector<uint8_t> _hubVideoSegments;
+    std::vector<uint8_t> _hubAudioSegments;
+    AacAggregator _aacAggregator{RtpPayloadCache::kMtu - kRtpHeaderSize};
     std::vector<uint8_t> _sps, _pps;
+
+    std::shared_ptr<MediaSource> _videoSource;
+    const RtpPayloadCache* _payloadCache = nullptr;
+    size_t _spsIndex = kNoFrameIndex;
+    size_t _ppsIndex = kNoFrameIndex;
+    static std::atomic_bool _payloadCacheEnabled;
+
+    std::shared_ptr<StreamHub> _hub;
+    // 订阅 StreamHub 后先加速补发 GOP 缓存，期间到达的实时批次排在后面，排空后再切回实时转发
+    std::deque<HubPacketBatchPtr> _pendingBatches;
+    bool _awaitingBurst = false;
+    bool _bursting = false;
+    static const int kBurstIntervalMs = 10;   // 补发时每 10ms 发一批，25fps 下约 4 倍速
+    // 开启 SO_TXTIME 时 UDP 视频批次铺开的时长：一帧在下一帧到来前发完，补发时在补发间隔内发完
+    static const uint64_t kVideoSpreadNs = 40 * 1000 * 1000ull;
+    static const uint64_t kBurstSpreadNs = kBurstIntervalMs * 1000 * 1000ull;
     
     bool _useUdp = false;
+
+    bool _congested = false;    // 发送链越过高水位，还没回落到低水位
+    bool _awaitingIdr = false;  // 正在整 GOP 丢弃，等下一个 IDR
+    RtpDropStats _dropStats;
 };
 
 #endif
\ No newline at end of file
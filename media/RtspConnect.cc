@@ -3,7 +3,10 @@
 #include <sstream>
 #include <atomic>
 #include <thread>
-#include <regex>
+#include <algorithm>
+#include <string.h>
+#include "AacPacketizer.h"
+#include "../reactor/UdpPortPool.h"
 #include "../reactor/Logger.h"
 using std::cout;
 using std::endl;
@@ -12,18 +15,10 @@ using std::endl;
 std::unordered_map<std::string, RtspSession> RtspConnect::_sessionMap;
 std::mutex RtspConnect::_sessionMutex;
 
-// 用于端口分配的静态变量
-static std::atomic<int> nextUdpPort{10000};
-static std::mutex portMutex;
-
 RtspConnect::RtspConnect(TcpConnectionPtr connPtr,EventLoopPtr loopPtr)
 :_connPtr(connPtr)
 ,_loopPtr(loopPtr)
-,method("")
-,url("")
-,version("")
 ,CSeq(0)
-,transport("")
 ,currentSessionId("")
 ,_h264FileReaderPtr(std::make_shared<H264FileReader>("data/1.h264"))
 ,_aacFileReaderPtr(std::make_shared<AacFileReader>("data/1.aac"))
@@ -38,40 +33,75 @@ RtspConnect::~RtspConnect(){
 }
 
 void RtspConnect::handleRtspConnect(){
+    // 数据已经由 EventLoop 读进接收缓冲区，这里把其中完整的请求一次处理完（客户端可能连发多条）
+    auto onInterleaved = [this](uint8_t channel, const uint8_t* data, size_t len) {
+        handleInterleaved(channel, data, len);
+    };
+    for (;;) {
+        // 请求之间可能夹着 '$' 帧，先分出去；请求解析到一半时后面的数据都属于这条请求
+        if (_parser.idle() && !_connPtr->demuxInterleaved(onInterleaved)) {
+            LOG_DEBUG("No complete RTSP request received from fd: %d", _connPtr->getFd());
+            return;
+        }
+        RtspParser::Status status = _parser.parse(_connPtr->inputData(), _connPtr->inputBytes());
+        if (status == RtspParser::kIncomplete) {
+            LOG_DEBUG("No complete RTSP request received from fd: %d", _connPtr->getFd());
+            // 没有完整请求，已解析的部分留在 _parser 里，下次接着解析
+            return;
+        }
+        if (status == RtspParser::kBadRequest) {
+            // 之后的数据已经找不到消息边界，回一个 400 后断开
+            LOG_ERROR("Malformed or oversized RTSP request from fd %d, closing", _connPtr->getFd());
+            sendResponse("RTSP/1.0 400 Bad Request\r\nCSeq: " + std::to_string(_parser.cseq()) + "\r\n\r\n");
+            _connPtr->closeAfterRead();
+            return;
+        }
+        LOG_INFO("Received RTSP request from fd %d: %zu bytes", _connPtr->getFd(), _parser.messageLength());
+        LOG_DEBUG("Request content:\n%.*s", (int)_parser.messageLength(), _connPtr->inputData());
 
-    std::string rBuf = _connPtr->reciveRtspRequest();
-    if (rBuf.empty()) {
-        LOG_DEBUG("No complete RTSP request received from fd: %d", _connPtr->getFd());
-        // 没有完整请求
-        return;
-    }
-    LOG_INFO("Received RTSP request from fd %d: %zu bytes", _connPtr->getFd(), rBuf.size());
-    LOG_DEBUG("Request content:\n%s", rBuf.c_str());
-
-    // 1. 解析请求
-    parseRequest(rBuf);
-
-    // 2. 路由处理
-    if (method == "OPTIONS") {
-        LOG_DEBUG("Handling OPTIONS request, CSeq: %d", CSeq);
-        handleOptions();
-    } else if (method == "DESCRIBE") {
-        LOG_DEBUG("Handling DESCRIBE request, CSeq: %d", CSeq);
-        handleDescribe();
-    } else if (method == "SETUP") {
-        LOG_DEBUG("Handling SETUP request, CSeq: %d", CSeq);
-        handleSetup();
-    } else if (method == "PLAY") {
-        LOG_DEBUG("Handling PLAY request, CSeq: %d", CSeq);
-        handlePlay();
-    } else if (method == "TEARDOWN") {
-        LOG_DEBUG("Handling TEARDOWN request, CSeq: %d", CSeq);
-        handleTeardown();
-    } else {
-        LOG_WARN("Unknown RTSP method: %s, CSeq: %d", method.c_str(), CSeq);
-        sendResponse("RTSP/1.0 400 Bad Request\r\nCSeq: " + std::to_string(CSeq) + "\r\n\r\n");
+        CSeq = _parser.cseq();
+        StrRef session = _parser.session();
+        if (!session.empty() && !session.equals(currentSessionId)) {
+            currentSessionId = session.str();
+            LOG_DEBUG("Session ID: %s", currentSessionId.c_str());
+        }
+
+        switch (_parser.method()) {
+        case RtspParser::kOptions:
+            LOG_DEBUG("Handling OPTIONS request, CSeq: %d", CSeq);
+            handleOptions();
+            break;
+        case RtspParser::kDescribe:
+            LOG_DEBUG("Handling DESCRIBE request, CSeq: %d", CSeq);
+            handleDescribe();
+            break;
+        case RtspParser::kSetup:
+            LOG_DEBUG("Handling SETUP request, CSeq: %d", CSeq);
+            handleSetup();
+            break;
+        case RtspParser::kPlay:
+            LOG_DEBUG("Handling PLAY request, CSeq: %d", CSeq);
+            handlePlay();
+            break;
+        case RtspParser::kPause:
+            LOG_DEBUG("Handling PAUSE request, CSeq: %d", CSeq);
+            handlePause();
+            break;
+        case RtspParser::kTeardown:
+            LOG_DEBUG("Handling TEARDOWN request, CSeq: %d", CSeq);
+            handleTeardown();
+            break;
+        default: {
+            StrRef name = _parser.methodName();
+            LOG_WARN("Unknown RTSP method: %.*s, CSeq: %d", (int)name.size, name.data, CSeq);
+            sendResponse("RTSP/1.0 400 Bad Request\r\nCSeq: " + std::to_string(CSeq) + "\r\n\r\n");
+            break;
+        }
+        }
+        // 处理完才取走：处理函数里用到的 URL、Transport 等都还指向接收缓冲区
+        _connPtr->retrieveInput(_parser.messageLength());
+        _parser.reset();
     }
-    
 }
 
 void RtspConnect::releaseSession() {
@@ -79,10 +109,6 @@ void RtspConnect::releaseSession() {
     if (!currentSessionId.empty()) {
         auto it = _sessionMap.find(currentSessionId);
         if (it != _sessionMap.end()) {
-            if (it->second.useUdp) {
-                LOG_DEBUG("Releasing UDP ports for session: %s", currentSessionId.c_str());
-                releaseUdpPorts();
-            }
             _sessionMap.erase(it);
             LOG_INFO("Session %s released", currentSessionId.c_str());
         }
@@ -92,56 +118,10 @@ void RtspConnect::releaseSession() {
     if(_rtspPusher) {
         LOG_DEBUG("Stopping RTP pusher");
         _rtspPusher->stop();
+        _rtspPusher.reset();    // 推流器也持有 UDP 连接，先放掉，端口还回池之前套接字就关闭了
     }
-}
-
-void RtspConnect::parseRequest(const std::string& rBuf) {
-    LOG_INFO("parseRequest");
-    std::istringstream iss(rBuf);
-    std::string line;
-    std::vector<std::string> headers;
-    std::string lastHeader;
-
-    while (std::getline(iss, line)) {
-        // 去掉行尾的 \r
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        // 如果是空行，header结束
-        if (line.empty()) break;
-
-        // 判断是否为折行（以空格或Tab开头）
-        if (!line.empty() && (line[0] == ' ' || line[0] == '\t')) {
-            if (!headers.empty()) {
-                headers.back() += line;
-            }
-        } else {
-            headers.push_back(line);
-        }
-    }
-    // 处理请求行和各个header
-    for (size_t i = 0; i < headers.size(); ++i) {
-        const std::string& h = headers[i];
-        if (i == 0 && h.find("RTSP/") != std::string::npos) {
-            std::istringstream lss(h);
-            lss >> method >> url >> version;
-            LOG_DEBUG("Parsed request line: %s %s %s", method.c_str(), url.c_str(), version.c_str());
-        } else if (h.find("CSeq") != std::string::npos || h.find("CSEQ") != std::string::npos) {
-            size_t pos = h.find(":");
-            if (pos != std::string::npos)
-                CSeq = std::stoi(h.substr(pos + 1));
-        } else if (h.find("Transport") != std::string::npos) {
-            transport = h;
-            LOG_DEBUG("Transport header: %s", transport.c_str());
-        } else if (h.find("Session:") != std::string::npos){
-            size_t pos = h.find(":");
-            if (pos != std::string::npos)
-                currentSessionId = h.substr(pos + 1);
-            currentSessionId.erase(0, currentSessionId.find_first_not_of(" \t")); // 去空格
-            LOG_DEBUG("Session ID: %s", currentSessionId.c_str());
-        }
-        // 你可以继续处理其他header
-    }
+    // SETUP 失败或已经 TEARDOWN 的会话不在 _sessionMap 里，端口也要还回去
+    releaseUdpPorts();
 }
 
 void RtspConnect::handleOptions() {
@@ -152,30 +132,87 @@ void RtspConnect::handleOptions() {
     sendResponse(response);
 }
 
-void RtspConnect::handleDescribe() {
-    std::string localIP;
+string RtspConnect::requestHost() const {
+    std::string host;
+    StrRef url = _parser.url();
     size_t start = url.find("rtsp://");
-    if (start != std::string::npos) {
+    if (start != StrRef::npos) {
         start += 7;
-        size_t end = url.find(":", start);
-        if (end != std::string::npos) {
-            localIP = url.substr(start, end - start);
+        StrRef rest(url.data + start, url.size - start);
+        size_t end = rest.find(":");
+        if (end != StrRef::npos) {
+            host.assign(rest.data, end);
         }
     }
+    return host;
+}
+
+// 解析 "npt=12.5-" / "npt=12.5-20" 的起点；"npt=now-" 或格式不对时返回 false
+static bool parseNptStart(StrRef range, double& npt) {
+    size_t pos = range.find("npt=");
+    if (pos == StrRef::npos) {
+        return false;
+    }
+    // 值在接收缓冲区里，后面不一定有 '\0'，拷到栈上再交给 strtod
+    char buf[32];
+    size_t len = std::min(range.size - pos - 4, sizeof(buf) - 1);
+    memcpy(buf, range.data + pos + 4, len);
+    buf[len] = '\0';
+    const char* begin = buf;
+    char* end = nullptr;
+    double value = strtod(begin, &end);
+    if (end == begin || value < 0) {
+        return false;
+    }
+    npt = value;
+    return true;
+}
+
+void RtspConnect::handleDescribe() {
+    std::string localIP = requestHost();
     LOG_DEBUG("Generating SDP for IP: %s", localIP.c_str());
     
+    // 音频参数取自 ADTS 头，和 RtpPusher 去掉 ADTS 头后的 AAC-hbr 打包方式保持一致
+    AacConfig aacConfig;
+    auto audioSource = _aacFileReaderPtr->source();
+    if (audioSource && audioSource->frameCount() > 0) {
+        const MediaFrame& first = audioSource->frame(0);
+        parseAdtsConfig(audioSource->frameData(first), first.size, aacConfig);
+    }
+    char aacConfigHex[8];
+    snprintf(aacConfigHex, sizeof(aacConfigHex), "%04X", aacConfig.audioSpecificConfig);
+
+    // UDP 会话按 NACK 重传（RFC 4585），开启 RTX 时重传走单独的负载类型（RFC 4588），apt 指向原负载类型。
+    // 仍声明 RTP/AVP：不认识 rtcp-fb 的播放器会忽略这些属性，改成 AVPF 反而有播放器拒绝
+    std::string sampleRate = std::to_string(aacConfig.sampleRate);
+    bool nack = RtpPusher::nackEnabled();
+    bool rtx = nack && RtpPusher::rtxEnabled();
+    std::string videoFeedback, audioFeedback;
+    if (nack) {
+        videoFeedback = "a=rtcp-fb:96 nack\r\n";
+        audioFeedback = "a=rtcp-fb:97 nack\r\n";
+        if (rtx) {
+            std::string rtxTime = std::to_string(RtpPusher::kRetransmitWindowMs);
+            videoFeedback += "a=rtpmap:98 rtx/90000\r\n"
+                             "a=fmtp:98 apt=96;rtx-time=" + rtxTime + "\r\n";
+            audioFeedback += "a=rtpmap:99 rtx/" + sampleRate + "\r\n"
+                             "a=fmtp:99 apt=97;rtx-time=" + rtxTime + "\r\n";
+        }
+    }
+
     // 示例 SDP 内容
     std::string sdp = "v=0\r\n"
                       "o=- 9" + std::to_string(time(NULL)) + " 1 IN IP4 " + localIP + "\r\n"
                       "s=Unnamed\r\n"
                       "t=0 0\r\n"
                       "a=control:*\r\n"
-                      "m=video 0 RTP/AVP 96\r\n"
-                      "a=rtpmap:96 H264/90000\r\n"
+                      "m=video 0 RTP/AVP 96" + (rtx ? " 98" : "") + "\r\n"
+                      "a=rtpmap:96 H264/90000\r\n" + videoFeedback +
                       "a=control:track0\r\n"
-                      "m=audio 0 RTP/AVP 97\r\n"
-                      "a=rtpmap:97 MPEG4-GENERIC/44100/2\r\n"
-                      "a=fmtp:97 profile-level-id=1;mode=AAC-hbr;sizelength=13;indexlength=3;indexdeltalength=3;config=1210;\r\n"
+                      "m=audio 0 RTP/AVP 97" + (rtx ? " 99" : "") + "\r\n"
+                      "a=rtpmap:97 MPEG4-GENERIC/" + sampleRate + "/" + std::to_string(aacConfig.channels) + "\r\n"
+                      "a=fmtp:97 profile-level-id=1;mode=AAC-hbr;sizelength=13;indexlength=3;indexdeltalength=3;config=" + aacConfigHex + ";\r\n" +
+                      audioFeedback +
                       "a=control:track1\r\n\r\n";
 
     std::string response = "RTSP/1.0 200 OK\r\n"
@@ -205,49 +242,65 @@ void RtspConnect::handleSetup() {
 
     // 解析Transport头
     bool useUdp = false;
+    int setupStatus = 200;
+    StrRef url = _parser.url();
+    StrRef transport = _parser.transport();
     InetAddress clientVideoAddr, clientAudioAddr;
     
-    if (transport.find("RTP/AVP") != std::string::npos &&
-              transport.find("interleaved=") == std::string::npos) {
+    if (transport.contains("RTP/AVP") && !transport.contains("interleaved=")) {
         // UDP传输
         useUdp = true;
         session.useUdp = true;
-        int basePort = allocateUdpPorts();
-        if (session.serverVideoPort == 0) {
-            session.serverVideoPort = basePort;
-        }else if(session.serverAudioPort == 0){
-            session.serverAudioPort = basePort + 2;
+        if (!_udpMux && UdpMux::enabled()) {
+            _udpMux = UdpMux::forLoop(_loopPtr.get());  // 创建失败时退回每个会话独占端口
+        }
+        if (_udpMux) {
+            // 同一个 EventLoop 上的所有会话共用一对端口，客户端靠自己的端口区分音视频
+            session.serverVideoPort = _udpMux->rtpPort();
+            session.serverAudioPort = _udpMux->rtpPort();
         }
         LOG_DEBUG("UDP transport detected, video port: %d, audio port: %d", 
                  session.serverVideoPort, session.serverAudioPort);
         
         // 解析客户端端口
-        std::regex clientPortRegex(R"(client_port=(\d+)-(\d+))");
-        std::smatch match;
-        if (std::regex_search(transport, match, clientPortRegex)) {
-            int clientRtpPort = std::stoi(match[1]);
-            int clientRtcpPort = std::stoi(match[2]);
-            
-            if (url.find("track0") != std::string::npos) { // 视频
+        int clientRtpPort = 0, clientRtcpPort = 0;
+        if (RtspParser::parseClientPort(transport, clientRtpPort, clientRtcpPort)) {
+            if (url.contains("track0")) { // 视频
                 session.clientVideoRtpAddr = InetAddress(_connPtr->getPeerAddr().ip(), clientRtpPort);
                 session.clientVideoRtcpAddr = InetAddress(_connPtr->getPeerAddr().ip(), clientRtcpPort);
-                _videoRtpConn = std::make_shared<UdpConnection>(_connPtr->getLocalAddr().ip(),session.serverVideoPort,session.clientVideoRtpAddr,_loopPtr);//建立视频Rtp连接
-                _videoRtcpConn = std::make_shared<UdpConnection>(_connPtr->getLocalAddr().ip(),session.serverVideoPort+1,session.clientVideoRtcpAddr,_loopPtr);//建立视频Rtcp连接
+                if (_udpMux) {
+                    _videoRtpConn = _udpMux->connect(session.clientVideoRtpAddr, _loopPtr);
+                } else {
+                    setupStatus = openUdpTrack(_videoPort, session.clientVideoRtpAddr, session.clientVideoRtcpAddr, _videoRtpConn, _videoRtcpConn);//建立视频Rtp/Rtcp连接
+                    session.serverVideoPort = _videoPort;
+                }
                 LOG_DEBUG("Created video UDP connections - RTP: %d, RTCP: %d", session.serverVideoPort, session.serverVideoPort+1);
-            } else if (url.find("track1") != std::string::npos) { // 音频
+            } else if (url.contains("track1")) { // 音频
                 session.clientAudioRtpAddr = InetAddress(_connPtr->getPeerAddr().ip(), clientRtpPort);
                 session.clientAudioRtcpAddr = InetAddress(_connPtr->getPeerAddr().ip(), clientRtcpPort);
-                _audioRtpConn = std::make_shared<UdpConnection>(_connPtr->getLocalAddr().ip(),session.serverAudioPort,session.clientAudioRtpAddr,_loopPtr);//建立音频Rtp连接
-                _audioRtcpConn = std::make_shared<UdpConnection>(_connPtr->getLocalAddr().ip(),session.serverAudioPort+1,session.clientAudioRtcpAddr,_loopPtr);//建立音频Rtcp连接
+                if (_udpMux) {
+                    _audioRtpConn = _udpMux->connect(session.clientAudioRtpAddr, _loopPtr);
+                } else {
+                    setupStatus = openUdpTrack(_audioPort, session.clientAudioRtpAddr, session.clientAudioRtcpAddr, _audioRtpConn, _audioRtcpConn);//建立音频Rtp/Rtcp连接
+                    session.serverAudioPort = _audioPort;
+                }
                 LOG_DEBUG("Created audio UDP connections - RTP: %d, RTCP: %d", session.serverAudioPort, session.serverAudioPort+1);
             }
         }
     } else {
         LOG_DEBUG("TCP transport detected");
     }
+
+    if (setupStatus == 453) {
+        sendResponse("RTSP/1.0 453 Not Enough Bandwidth\r\nCSeq: " + std::to_string(CSeq) + "\r\n\r\n");
+        return;
+    } else if (setupStatus != 200) {
+        sendResponse("RTSP/1.0 500 Internal Server Error\r\nCSeq: " + std::to_string(CSeq) + "\r\n\r\n");
+        return;
+    }
     
     std::string response;
-    if (url.find("track0") != std::string::npos) { // 视频
+    if (url.contains("track0")) { // 视频
         if (useUdp) {
             response = "RTSP/1.0 200 OK\r\n"
                        "CSeq: " + std::to_string(CSeq) + "\r\n"
@@ -263,7 +316,7 @@ void RtspConnect::handleSetup() {
                        "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n"
                        "Session: " + currentSessionId + "\r\n\r\n";
         }
-    } else if (url.find("track1") != std::string::npos) { // 音频
+    } else if (url.contains("track1")) { // 音频
         if (useUdp) {
             response = "RTSP/1.0 200 OK\r\n"
                        "CSeq: " + std::to_string(CSeq) + "\r\n"
@@ -298,67 +351,121 @@ void RtspConnect::handlePlay() {
 
     it->second.isPlaying = true;
     it->second.lastActive = time(nullptr);
-    LOG_INFO("Starting playback for session: %s", currentSessionId.c_str());
+
+    // 已有推流器时（PAUSE 之后或播放中再次 PLAY）直接复用，游标和定时器都还在，不再重新打开文件
+    bool resume = _rtspPusher && _rtspPusher->isRunning();
+    LOG_INFO("%s playback for session: %s", resume ? "Resuming" : "Starting", currentSessionId.c_str());
     
-    if(it->second.useUdp){
+    if (resume) {
+        LOG_DEBUG("Reusing existing RTP pusher");
+    } else if(it->second.useUdp){
         LOG_DEBUG("Starting UDP RTP pusher");
         this->_rtspPusher = std::make_shared<RtpPusher>(_videoRtpConn,_audioRtpConn,_h264FileReaderPtr,_aacFileReaderPtr);
-        _loopPtr->addEpollReadFd(_videoRtcpConn->getUdpFd());
-        _loopPtr->addEpollReadFd(_audioRtcpConn->getUdpFd());
-        _loopPtr->udpConns[_videoRtcpConn->getUdpFd()] = _videoRtcpConn;
-        _loopPtr->udpConns[_audioRtcpConn->getUdpFd()] = _audioRtcpConn;
-        auto rtcpCallback = [](const UdpConnectionPtr &udpConn, const char* streamType){
-            char buffer[2048];
-            int n = udpConn->recv(buffer);
-            if (n <= 0) {
-                LOG_DEBUG("[RTCP] No data received for %s stream", streamType);
-            }
-            const uint8_t* packet = (const uint8_t*)buffer;
-            size_t len = n;
-            size_t pos = 0;
-
-            while (pos + 4 <= len) { // Minimum RTCP header size
-                uint16_t length_words = (packet[pos + 2] << 8) | packet[pos + 3];
-                size_t packet_len_bytes = (length_words + 1) * 4;
-
-                if (pos + packet_len_bytes > len) {
-                    // Malformed packet, stop processing
-                    break;
-                }
-
-                uint8_t pt = packet[pos + 1];
-                if (pt == 201 && pos + 8 <= len) { // Receiver Report
-                    // SSRC of the media source being reported on
-                    uint32_t ssrc_source = ntohl(*(uint32_t*)&packet[pos + 8]);
-                    LOG_DEBUG("[RTCP] Received Receiver Report for %s stream (SSRC: %u)", streamType, ssrc_source);
-                }
-                
-                pos += packet_len_bytes;
+        // 客户端的 RR/SDES/BYE 交给推流器更新接收质量；回调只持有弱引用，推流器停掉后自然失效
+        std::weak_ptr<RtpPusher> weakPusher = _rtspPusher;
+        auto onRtcp = [weakPusher](const uint8_t* data, size_t len) {
+            auto pusher = weakPusher.lock();
+            if (pusher) {
+                pusher->handleRtcp(data, len);
             }
         };
-        _videoRtcpConn->setMessageCallback([rtcpCallback](const UdpConnectionPtr &conn){
-            rtcpCallback(conn, "video");
-        });
-
-        _audioRtcpConn->setMessageCallback([rtcpCallback](const UdpConnectionPtr &conn){
-            rtcpCallback(conn, "audio");
-        });
+        if (_udpMux) {
+            _rtspPusher->setRtcpConnections(_udpMux->connectRtcp(it->second.clientVideoRtcpAddr, _loopPtr),
+                                            _udpMux->connectRtcp(it->second.clientAudioRtcpAddr, _loopPtr));
+            if (_rtcpPeerIds.empty()) {
+                _rtcpPeerIds.push_back(_udpMux->addRtcpPeer(it->second.clientVideoRtcpAddr, onRtcp));
+                _rtcpPeerIds.push_back(_udpMux->addRtcpPeer(it->second.clientAudioRtcpAddr, onRtcp));
+            }
+        } else {
+            _rtspPusher->setRtcpConnections(_videoRtcpConn, _audioRtcpConn);
+            _loopPtr->addEpollConnFd(_videoRtcpConn->getUdpFd(), false);
+            _loopPtr->addEpollConnFd(_audioRtcpConn->getUdpFd(), false);
+            _loopPtr->udpConns[_videoRtcpConn->getUdpFd()] = _videoRtcpConn;
+            _loopPtr->udpConns[_audioRtcpConn->getUdpFd()] = _audioRtcpConn;
+            auto rtcpCallback = [onRtcp](const UdpConnectionPtr &udpConn){
+                uint8_t buffer[2048];
+                // 读到 EAGAIN 为止，边沿触发下剩下的数据报不会再有通知
+                for (;;) {
+                    int n = udpConn->recv(buffer, sizeof(buffer));
+                    if (n < 0) {
+                        return;
+                    }
+                    if (n > 0) {
+                        onRtcp(buffer, n);
+                    }
+                }
+            };
+            _videoRtcpConn->setMessageCallback(rtcpCallback);
+            _audioRtcpConn->setMessageCallback(rtcpCallback);
+        }
     }else{
         LOG_DEBUG("Starting TCP RTP pusher");
         this->_rtspPusher = std::make_shared<RtpPusher>(_connPtr,_h264FileReaderPtr,_aacFileReaderPtr);
     }
     
+    bool live = _parser.url().contains("/live");
+    if (!resume && live) {
+        // 直播地址：所有观众共享同一个 StreamHub，只有一份读取和打包
+        LOG_INFO("Session %s subscribes to live stream", currentSessionId.c_str());
+        _rtspPusher->setStreamHub(StreamHub::get("live", "data/1.h264", "data/1.aac"));
+    }
+    
+    double npt = 0;
+    bool seeked = false;
+    if (parseNptStart(_parser.range(), npt)) {
+        // 按关键帧索引二分定位，不再从文件头重新扫描
+        seeked = _rtspPusher->seek(npt, npt);
+    }
+
     std::string response = "RTSP/1.0 200 OK\r\n"
                            "CSeq: " + std::to_string(CSeq) + "\r\n"
-                           "Session: " + currentSessionId + "\r\n\r\n";
+                           "Session: " + currentSessionId + "\r\n";
+    if (seeked) {
+        char rangeBuf[64];
+        snprintf(rangeBuf, sizeof(rangeBuf), "Range: npt=%.3f-\r\n", npt);
+        response += rangeBuf;
+    }
+    if (!live) {
+        // 告诉客户端从哪个序号/时间戳开始是本次 PLAY 的数据，seek 和恢复后客户端据此重新对齐
+        uint16_t videoSeq = 0, audioSeq = 0;
+        uint32_t videoTs = 0, audioTs = 0;
+        _rtspPusher->getRtpInfo(videoSeq, videoTs, audioSeq, audioTs);
+        std::string base = "rtsp://" + requestHost() + "/";
+        response += "RTP-Info: url=" + base + "track0;seq=" + std::to_string(videoSeq) + ";rtptime=" + std::to_string(videoTs) +
+                    ",url=" + base + "track1;seq=" + std::to_string(audioSeq) + ";rtptime=" + std::to_string(audioTs) + "\r\n";
+    }
+    response += "\r\n";
     LOG_DEBUG("Sending PLAY response, CSeq: %d", CSeq);
     sendResponse(response);
-    if(_rtspPusher) {
+    if (resume) {
+        _rtspPusher->resume();
+    } else if(_rtspPusher) {
         LOG_INFO("Starting RTP pusher");
         _rtspPusher->start(); 
     }
 }
 
+void RtspConnect::handlePause() {
+    std::lock_guard<std::mutex> lock(_sessionMutex);
+    auto it = _sessionMap.find(currentSessionId);
+    if (it == _sessionMap.end()) {
+        LOG_WARN("Session not found: %s", currentSessionId.c_str());
+        sendResponse("RTSP/1.0 454 Session Not Found\r\nCSeq: " + std::to_string(CSeq) + "\r\n\r\n");
+        return;
+    }
+    it->second.isPlaying = false;
+    it->second.lastActive = time(nullptr);
+    if (_rtspPusher) {
+        LOG_INFO("Pausing playback for session: %s", currentSessionId.c_str());
+        _rtspPusher->pause();
+    }
+    std::string response = "RTSP/1.0 200 OK\r\n"
+                           "CSeq: " + std::to_string(CSeq) + "\r\n"
+                           "Session: " + currentSessionId + "\r\n\r\n";
+    LOG_DEBUG("Sending PAUSE response, CSeq: %d", CSeq);
+    sendResponse(response);
+}
+
 void RtspConnect::handleTeardown() {
     std::lock_guard<std::mutex> lock(_sessionMutex);
 
@@ -374,6 +481,23 @@ void RtspConnect::handleTeardown() {
     if(_rtspPusher) {
         LOG_DEBUG("Stopping RTP pusher");
         _rtspPusher->stop();
+        _rtspPusher.reset();
+    }
+    releaseUdpPorts();
+}
+
+void RtspConnect::handleInterleaved(uint8_t channel, const uint8_t* data, size_t len) {
+    switch (channel) {
+    case 1:
+    case 3:
+        if (_rtspPusher) {
+            _rtspPusher->handleRtcp(data, len);
+        }
+        break;
+    default:
+        // 偶数通道是客户端发来的 RTP，播放场景下不该出现，丢掉
+        LOG_DEBUG("Dropping %zu-byte interleaved frame on channel %u from fd %d", len, channel, _connPtr->getFd());
+        break;
     }
 }
 
@@ -392,27 +516,54 @@ string RtspConnect::generateSessionId() {
     return sessionId;
 }
 
-int RtspConnect::allocateUdpPorts() {
-    std::lock_guard<std::mutex> lock(portMutex);
-    int basePort = nextUdpPort.fetch_add(2); // 分配6个端口：视频RTP/RTCP, 音频RTP/RTCP, 控制RTP/RTCP
-    LOG_DEBUG("Allocated UDP ports starting from: %d", basePort);
-    return basePort;
+int RtspConnect::openUdpTrack(int& port, const InetAddress& rtpPeer, const InetAddress& rtcpPeer,
+                              std::shared_ptr<UdpConnection>& rtpConn, std::shared_ptr<UdpConnection>& rtcpConn) {
+    // 同一轨道重复 SETUP 时先关掉旧连接、归还旧端口
+    closeUdpTrack(port, rtpConn, rtcpConn);
+    string localIp = _connPtr->getLocalAddr().ip();
+    for (int attempt = 0; attempt < kUdpBindAttempts; ++attempt) {
+        int rtpPort = UdpPortPool::acquire();
+        if (rtpPort < 0) {
+            LOG_WARN("UDP port pool exhausted (%zu pairs in use)", UdpPortPool::inUse());
+            return 453;
+        }
+        rtpConn = std::make_shared<UdpConnection>(localIp, rtpPort, rtpPeer, _loopPtr);
+        rtcpConn = std::make_shared<UdpConnection>(localIp, rtpPort + 1, rtcpPeer, _loopPtr);
+        if (rtpConn->localPort() == rtpPort && rtcpConn->localPort() == rtpPort + 1) {
+            port = rtpPort;
+            LOG_DEBUG("Allocated UDP ports %d-%d", rtpPort, rtpPort + 1);
+            return 200;
+        }
+        // 端口被别的进程或还没关掉的旧套接字占着，换下一对
+        LOG_WARN("Failed to bind UDP ports %d-%d, trying next pair", rtpPort, rtpPort + 1);
+        rtpConn.reset();
+        rtcpConn.reset();
+        UdpPortPool::release(rtpPort);
+    }
+    return 500;
 }
 
-void RtspConnect::releaseUdpPorts() {
-    if(_videoRtcpConn){
-        LOG_DEBUG("Removing video RTCP connection from epoll");
-        _loopPtr->delEpollReadFd(_videoRtcpConn->getUdpFd());
-        _loopPtr->udpConns.erase(_videoRtcpConn->getUdpFd());
+void RtspConnect::closeUdpTrack(int& port, std::shared_ptr<UdpConnection>& rtpConn, std::shared_ptr<UdpConnection>& rtcpConn) {
+    if (rtcpConn) {
+        _loopPtr->delEpollReadFd(rtcpConn->getUdpFd());
+        _loopPtr->udpConns.erase(rtcpConn->getUdpFd());
     }
-    if(_audioRtcpConn){
-        LOG_DEBUG("Removing audio RTCP connection from epoll");
-        _loopPtr->delEpollReadFd(_audioRtcpConn->getUdpFd());
-        _loopPtr->udpConns.erase(_audioRtcpConn->getUdpFd());
+    rtpConn.reset();
+    rtcpConn.reset();
+    if (port >= 0) {
+        UdpPortPool::release(port);
+        port = -1;
+    }
+}
+
+void RtspConnect::releaseUdpPorts() {
+    if (_udpMux) {
+        for (uint64_t id : _rtcpPeerIds) {
+            _udpMux->removeRtcpPeer(id);
+        }
+        _rtcpPeerIds.clear();
     }
-    _videoRtpConn.reset();
-    _videoRtcpConn.reset();
-    _audioRtpConn.reset();
-    _audioRtcpConn.reset();
+    closeUdpTrack(_videoPort, _videoRtpConn, _videoRtcpConn);
+    closeUdpTrack(_audioPort, _audioRtpConn, _audioRtcpConn);
     LOG_DEBUG("UDP connections released");
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define __RTSPCONNECT_H__
 #include "../reactor/TcpConnection.h"
 #include "../reactor/UdpConnection.h"
+#include "../reactor/UdpMux.h"
 #include "../reactor/EventLoop.h"
 #include <string>
 #include <unordered_map>
@@ -9,6 +10,7 @@
 #include "RtpPusher.h"
 #include "H264FileReader.h"
 #include "AacFileReader.h"
+#include "RtspParser.h"
 using std::string;
 using std::mutex;
 using std::unordered_map;
@@ -36,23 +38,29 @@ public:
     void handleRtspConnect();
     void releaseSession();
 private:
-    void parseRequest(const std::string& rBuf);
     void handleOptions();
     void handleDescribe();
     void handleSetup();
     void handlePlay();
+    void handlePause();
     void handleTeardown();
     void sendResponse(const std::string& response);
+    // RTP over TCP：控制连接上收到的 '$' 帧，奇数通道是 RTCP（SETUP 时分配 0-1 给视频、2-3 给音频）
+    void handleInterleaved(uint8_t channel, const uint8_t* data, size_t len);
     string generateSessionId();
-    int allocateUdpPorts();  // 分配UDP端口
+    string requestHost() const;  // 请求 URL 中的主机部分，用于 SDP 和 RTP-Info
+    // 从 UdpPortPool 取一对端口并建立一个轨道的 RTP/RTCP 连接，返回 RTSP 状态码：200 成功，453 端口耗尽，500 绑定失败
+    int openUdpTrack(int& port, const InetAddress& rtpPeer, const InetAddress& rtcpPeer,
+                     std::shared_ptr<UdpConnection>& rtpConn, std::shared_ptr<UdpConnection>& rtcpConn);
+    void closeUdpTrack(int& port, std::shared_ptr<UdpConnection>& rtpConn, std::shared_ptr<UdpConnection>& rtcpConn);
     void releaseUdpPorts();  // 释放UDP端口
     
     TcpConnectionPtr _connPtr;
     EventLoopPtr _loopPtr;
 
-    string method,url,version;
+    // 直接在连接的接收缓冲区上解析，请求行和头部都不拷贝；半条请求的解析进度跨读事件保留
+    RtspParser _parser;
     int CSeq;
-    string transport;
     // sessionID -> Session 映射
     // _sessionMap 和 _sessionMutex 是静态的，因为多个 RtspConnect 实例要共享会话池。
     static unordered_map<std::string, RtspSession> _sessionMap;
@@ -67,6 +75,12 @@ private:
     std::shared_ptr<UdpConnection> _videoRtcpConn;
     std::shared_ptr<UdpConnection> _audioRtpConn;
     std::shared_ptr<UdpConnection> _audioRtcpConn;
+    int _videoPort = -1;    // 从 UdpPortPool 取得的端口对，-1 表示没有
+    int _audioPort = -1;
+    static const int kUdpBindAttempts = 8;
+    // 共享套接字模式（UdpMux::enabled()）下不创建 RTCP 连接，入站 RTCP 由本 EventLoop 的 UdpMux 分发
+    std::shared_ptr<UdpMux> _udpMux;
+    std::vector<uint64_t> _rtcpPeerIds;
 };
 
 
@@ -0,0 +1,302 @@
+#include "RtspParser.h"
+#include <string.h>
+#include <strings.h>
+
+bool StrRef::equals(const char* s) const {
+    return strlen(s) == size && memcmp(data, s, size) == 0;
+}
+
+bool StrRef::iequals(const char* s) const {
+    return strlen(s) == size && strncasecmp(data, s, size) == 0;
+}
+
+size_t StrRef::find(const char* s) const {
+    size_t n = strlen(s);
+    if (n == 0 || n > size) {
+        return n == 0 ? 0 : npos;
+    }
+    const void* p = memmem(data, size, s, n);
+    return p ? static_cast<const char*>(p) - data : npos;
+}
+
+bool StrRef::contains(const char* s) const {
+    return find(s) != npos;
+}
+
+namespace {
+
+struct MethodName {
+    const char* name;
+    size_t len;
+    RtspParser::Method method;
+};
+
+const MethodName kMethods[] = {
+    {"OPTIONS", 7, RtspParser::kOptions},
+    {"DESCRIBE", 8, RtspParser::kDescribe},
+    {"SETUP", 5, RtspParser::kSetup},
+    {"PLAY", 4, RtspParser::kPlay},
+    {"PAUSE", 5, RtspParser::kPause},
+    {"TEARDOWN", 8, RtspParser::kTeardown},
+    {"GET_PARAMETER", 13, RtspParser::kGetParameter},
+    {"SET_PARAMETER", 13, RtspParser::kSetParameter},
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// 十进制非负整数，超过 limit 或没有数字时返回 false
+bool parseDecimal(const char* p, const char* end, size_t limit, size_t& value) {
+    size_t v = 0;
+    const char* begin = p;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        v = v * 10 + (*p - '0');
+        if (v > limit) {
+            return false;
+        }
+    }
+    if (p == begin) {
+        return false;
+    }
+    value = v;
+    return true;
+}
+
+}
+
+void RtspParser::reset() {
+    _base = nullptr;
+    _pos = 0;
+    _state = kRequestLine;
+    _method = Span{0, 0};
+    _url = Span{0, 0};
+    _version = Span{0, 0};
+    _methodId = kUnknown;
+    _cseq = 0;
+    _fieldCount = 0;
+    _transport = -1;
+    _session = -1;
+    _range = -1;
+    _headerLength = 0;
+    _contentLength = 0;
+}
+
+RtspParser::Status RtspParser::parse(const char* data, size_t len) {
+    _base = data;
+    while (_state != kBody) {
+        if (_pos >= len) {
+            return kIncomplete;
+        }
+        const char* nl = static_cast<const char*>(memchr(data + _pos, '\n', len - _pos));
+        if (!nl) {
+            // 半行留到下次，但一行长到超过上限就不用再等了
+            return len > kMaxMessage ? kBadRequest : kIncomplete;
+        }
+        size_t begin = _pos;
+        size_t next = nl - data + 1;
+        size_t end = next - 1;
+        if (end > begin && data[end - 1] == '\r') {
+            --end;
+        }
+        if (next > kMaxMessage) {
+            return kBadRequest;
+        }
+        _pos = next;
+
+        if (_state == kRequestLine) {
+            if (end == begin) {
+                continue;   // 请求之间多余的空行
+            }
+            if (!parseRequestLine(begin, end)) {
+                return kBadRequest;
+            }
+            _state = kHeaders;
+        } else if (end == begin) {
+            _headerLength = next;
+            _state = kBody;
+            if (messageLength() > kMaxMessage) {
+                return kBadRequest;
+            }
+        } else if (!parseHeaderLine(begin, end)) {
+            return kBadRequest;
+        }
+    }
+    if (len < messageLength()) {
+        return kIncomplete;
+    }
+    return kComplete;
+}
+
+bool RtspParser::parseRequestLine(size_t begin, size_t end) {
+    const char* p = _base + begin;
+    const char* e = _base + end;
+    const char* sp1 = static_cast<const char*>(memchr(p, ' ', e - p));
+    if (!sp1 || sp1 == p) {
+        return false;
+    }
+    const char* u = sp1 + 1;
+    while (u < e && *u == ' ') {
+        ++u;
+    }
+    const char* sp2 = static_cast<const char*>(memchr(u, ' ', e - u));
+    if (!sp2 || sp2 == u) {
+        return false;
+    }
+    const char* v = sp2 + 1;
+    while (v < e && *v == ' ') {
+        ++v;
+    }
+    const char* ve = e;
+    while (ve > v && isSpace(ve[-1])) {
+        --ve;
+    }
+    if (ve - v < 5 || memcmp(v, "RTSP/", 5) != 0) {
+        return false;
+    }
+    _method = Span{(uint32_t)begin, (uint32_t)(sp1 - p)};
+    _url = Span{(uint32_t)(u - _base), (uint32_t)(sp2 - u)};
+    _version = Span{(uint32_t)(v - _base), (uint32_t)(ve - v)};
+
+    // 方法名区分大小写（RFC 2326 6.1）
+    for (const MethodName& m : kMethods) {
+        if (m.len == _method.len && memcmp(p, m.name, m.len) == 0) {
+            _methodId = m.method;
+            break;
+        }
+    }
+    return true;
+}
+
+bool RtspParser::parseHeaderLine(size_t begin, size_t end) {
+    const char* p = _base + begin;
+    const char* e = _base + end;
+    if (isSpace(*p)) {
+        // 折行：续到上一个头部的值上，值的片段直接延长到这一行末尾
+        if (_fieldCount == 0) {
+            return true;
+        }
+        Field& last = _fields[_fieldCount - 1];
+        const char* ve = e;
+        while (ve > p && isSpace(ve[-1])) {
+            --ve;
+        }
+        if (ve > p) {
+            if (last.value.len == 0) {
+                while (isSpace(*p)) {
+                    ++p;
+                }
+                last.value.off = (uint32_t)(p - _base);
+            }
+            last.value.len = (uint32_t)(ve - _base - last.value.off);
+            classifyField(_fieldCount - 1);
+        }
+        return true;
+    }
+    const char* colon = static_cast<const char*>(memchr(p, ':', e - p));
+    if (!colon) {
+        return true;    // 不合规的头部行直接忽略，不影响分帧
+    }
+    if (_fieldCount == kMaxHeaders) {
+        return false;
+    }
+    const char* ne = colon;
+    while (ne > p && isSpace(ne[-1])) {
+        --ne;
+    }
+    const char* v = colon + 1;
+    while (v < e && isSpace(*v)) {
+        ++v;
+    }
+    const char* ve = e;
+    while (ve > v && isSpace(ve[-1])) {
+        --ve;
+    }
+    Field& f = _fields[_fieldCount];
+    f.name = Span{(uint32_t)begin, (uint32_t)(ne - p)};
+    f.value = Span{(uint32_t)(v - _base), (uint32_t)(ve - v)};
+    ++_fieldCount;
+    classifyField(_fieldCount - 1);
+    return _contentLength <= kMaxMessage;
+}
+
+void RtspParser::classifyField(int index) {
+    StrRef name = ref(_fields[index].name);
+    StrRef value = ref(_fields[index].value);
+    switch (name.size) {
+    case 4:
+        if (name.iequals("CSeq")) {
+            size_t cseq = 0;
+            if (parseDecimal(value.data, value.data + value.size, 0x7fffffff, cseq)) {
+                _cseq = (int)cseq;
+            }
+        }
+        break;
+    case 5:
+        if (name.iequals("Range")) {
+            _range = index;
+        }
+        break;
+    case 7:
+        if (name.iequals("Session")) {
+            // "Session: 12345678;timeout=60" 只保留 ID
+            const char* semi = static_cast<const char*>(memchr(value.data, ';', value.size));
+            if (semi) {
+                const char* e = semi;
+                while (e > value.data && isSpace(e[-1])) {
+                    --e;
+                }
+                _fields[index].value.len = (uint32_t)(e - value.data);
+            }
+            _session = index;
+        }
+        break;
+    case 9:
+        if (name.iequals("Transport")) {
+            _transport = index;
+        }
+        break;
+    case 14:
+        if (name.iequals("Content-Length")) {
+            size_t n = 0;
+            // 超出上限的长度按坏请求处理，由 parseHeaderLine 判断
+            _contentLength = parseDecimal(value.data, value.data + value.size, kMaxMessage, n) ? n : kMaxMessage + 1;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+StrRef RtspParser::header(const char* name) const {
+    size_t n = strlen(name);
+    for (size_t i = 0; i < _fieldCount; ++i) {
+        const Field& f = _fields[i];
+        if (f.name.len == n && strncasecmp(_base + f.name.off, name, n) == 0) {
+            return ref(f.value);
+        }
+    }
+    return StrRef();
+}
+
+bool RtspParser::parseClientPort(StrRef transport, int& rtpPort, int& rtcpPort) {
+    size_t pos = transport.find("client_port=");
+    if (pos == StrRef::npos) {
+        return false;
+    }
+    const char* p = transport.data + pos + 12;
+    const char* e = transport.data + transport.size;
+    size_t rtp = 0, rtcp = 0;
+    if (!parseDecimal(p, e, 65535, rtp)) {
+        return false;
+    }
+    while (p < e && *p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (p == e || *p != '-' || !parseDecimal(p + 1, e, 65535, rtcp)) {
+        return false;
+    }
+    rtpPort = (int)rtp;
+    rtcpPort = (int)rtcp;
+    return true;
+}
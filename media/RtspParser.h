@@ -0,0 +1,116 @@
+#ifndef __RTSPPARSER_H__
+#define __RTSPPARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// 指向接收缓冲区的只读片段，不持有数据（C++11 还没有 string_view）
+struct StrRef {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    StrRef() {}
+    StrRef(const char* d, size_t n) : data(d), size(n) {}
+
+    bool empty() const { return size == 0; }
+    bool equals(const char* s) const;
+    bool equals(const std::string& s) const { return s.size() == size && s.compare(0, size, data, size) == 0; }
+    bool iequals(const char* s) const;          // ASCII 不区分大小写
+    bool contains(const char* s) const;
+    size_t find(const char* s) const;           // 找不到返回 npos
+    std::string str() const { return std::string(data, size); }
+
+    static const size_t npos = (size_t)-1;
+};
+
+/*
+RTSP 请求的增量解析器（状态机），直接在接收缓冲区上解析，不拷贝也不分配内存：
+请求行和各个头部只记录相对消息起点的偏移，常用头部（CSeq、Transport、Session、Range、Content-Length）
+在解析时按名字（不区分大小写）归类，其余头部留在定长表里可以按名字查。
+数据不完整时返回 kIncomplete，之后缓冲区变长（或被搬到别处）再用新的起点和长度调用，已经解析过的行不再扫描；
+一条请求处理完后调用方从缓冲区取走 messageLength() 字节，再 reset() 复用同一个解析器。
+*/
+class RtspParser {
+public:
+    enum Status {
+        kIncomplete,    // 还没收齐（包括 Content-Length 给出的正文）
+        kComplete,
+        kBadRequest,    // 请求行格式不对、头部太多或消息超长，之后的数据已经无法分帧
+    };
+    enum Method {
+        kUnknown,
+        kOptions,
+        kDescribe,
+        kSetup,
+        kPlay,
+        kPause,
+        kTeardown,
+        kGetParameter,
+        kSetParameter,
+    };
+
+    static const size_t kMaxHeaders = 32;
+    static const size_t kMaxMessage = 64 * 1024;    // 头部加正文的上限
+
+    RtspParser() { reset(); }
+
+    // data 指向这条请求的起点（允许有多余的前导空行），len 是目前收到的字节数
+    Status parse(const char* data, size_t len);
+    void reset();
+    // 还没开始解析下一条请求，此时调用方可以先处理夹在请求之间的其他数据（如 '$' 帧）
+    bool idle() const { return _pos == 0; }
+
+    // 以下在 parse 返回 kComplete 之后、缓冲区被修改之前有效
+    size_t messageLength() const { return _headerLength + _contentLength; }
+    Method method() const { return _methodId; }
+    StrRef methodName() const { return ref(_method); }
+    StrRef url() const { return ref(_url); }
+    StrRef version() const { return ref(_version); }
+    int cseq() const { return _cseq; }              // 没有 CSeq 头时为 0
+    StrRef transport() const { return field(_transport); }
+    StrRef session() const { return field(_session); }   // 只有会话 ID，";timeout=" 等参数已去掉
+    StrRef range() const { return field(_range); }
+    StrRef body() const { return StrRef(_base + _headerLength, _contentLength); }
+    // 按名字查头部（不区分大小写），没有时返回空片段；折行的头部值里保留原始的换行和缩进
+    StrRef header(const char* name) const;
+    size_t headerCount() const { return _fieldCount; }
+
+    // 从 Transport 中取 client_port=RTP-RTCP
+    static bool parseClientPort(StrRef transport, int& rtpPort, int& rtcpPort);
+
+private:
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct Field {
+        Span name;
+        Span value;
+    };
+    enum State { kRequestLine, kHeaders, kBody };
+
+    StrRef ref(Span s) const { return StrRef(_base + s.off, s.len); }
+    StrRef field(int index) const { return index < 0 ? StrRef() : ref(_fields[index].value); }
+    bool parseRequestLine(size_t begin, size_t end);
+    bool parseHeaderLine(size_t begin, size_t end);
+    void classifyField(int index);
+
+    const char* _base;
+    size_t _pos;                // 下一行的起点
+    State _state;
+    Span _method;
+    Span _url;
+    Span _version;
+    Method _methodId;
+    int _cseq;
+    Field _fields[kMaxHeaders];
+    size_t _fieldCount;
+    int _transport;             // 常用头部在 _fields 中的下标，-1 表示没有
+    int _session;
+    int _range;
+    size_t _headerLength;       // 含结尾空行
+    size_t _contentLength;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "StartCodeScanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STARTCODE_X86 1
+#endif
+
+const uint8_t* findStartCodeScalar(const uint8_t* begin, const uint8_t* end) {
+    const uint8_t* p = begin;
+    while (p + 3 <= end) {
+        // 第三个字节不是 0/1 时，当前位置和后两个位置都不可能是起始码，直接跳 3 个字节
+        if (p[2] > 1) {
+            p += 3;
+        } else if (p[2] == 1 && p[1] == 0 && p[0] == 0) {
+            return p;
+        } else {
+            ++p;
+        }
+    }
+    return end;
+}
+
+#ifdef STARTCODE_X86
+
+static const uint8_t* findStartCodeSse2(const uint8_t* begin, const uint8_t* end) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const uint8_t* p = begin;
+    // 同时比较 p[i]==0、p[i+1]==0、p[i+2]==1，三个掩码相与后非零即命中
+    while (p + 16 + 2 <= end) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+        __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                    _mm_cmpeq_epi8(b2, one));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findStartCodeScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const uint8_t* findStartCodeAvx2(const uint8_t* begin, const uint8_t* end) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const uint8_t* p = begin;
+    while (p + 32 + 2 <= end) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        __m256i b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 2));
+        __m256i hit = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+                                       _mm256_cmpeq_epi8(b2, one));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findStartCodeSse2(p, end);
+}
+
+using ScanFunc = const uint8_t* (*)(const uint8_t*, const uint8_t*);
+
+static ScanFunc selectScanner() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findStartCodeAvx2;
+    }
+    return findStartCodeSse2;
+}
+
+const uint8_t* findStartCode(const uint8_t* begin, const uint8_t* end) {
+    static const ScanFunc scanner = selectScanner();//局部静态变量，C++11 保证线程安全地只初始化一次
+    return scanner(begin, end);
+}
+
+#else
+
+const uint8_t* findStartCode(const uint8_t* begin, const uint8_t* end) {
+    return findStartCodeScalar(begin, end);
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __STARTCODESCANNER_H__
+#define __STARTCODESCANNER_H__
+
+#include <cstdint>
+
+/*
+在 [begin, end) 中查找第一个 H264 起始码 00 00 01，返回指向第一个 0x00 的指针，找不到返回 end。
+4 字节起始码 00 00 00 01 会在其后三个字节处命中，由调用方检查前一个字节是否为 0。
+x86 上按块用 SSE2/AVX2 一次比较 16/32 个位置，运行时检测 CPU 选择实现，其他平台走标量版本。
+*/
+const uint8_t* findStartCode(const uint8_t* begin, const uint8_t* end);
+
+// 标量版本，供不支持 SIMD 的平台和对拍使用
+const uint8_t* findStartCodeScalar(const uint8_t* begin, const uint8_t* end);
+
+#endif
@@ -0,0 +1,409 @@
+#include "StreamHub.h"
+#include <string.h>
+#include "RtpHeader.h"
+#include "AacPacketizer.h"
+#include <algorithm>
+#include <atomic>
+#include "../reactor/Logger.h"
+
+using namespace std::chrono;
+
+std::map<std::string, std::weak_ptr<StreamHub>> StreamHub::_registry;
+std::mutex StreamHub::_registryMutex;
+
+static const size_t kNoIndex = static_cast<size_t>(-1);
+
+std::shared_ptr<StreamHub> StreamHub::get(const std::string& name,
+                                          const std::string& videoPath,
+                                          const std::string& audioPath) {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    auto it = _registry.find(name);
+    if (it != _registry.end()) {
+        auto hub = it->second.lock();
+        if (hub) {
+            return hub;
+        }
+    }
+    std::shared_ptr<StreamHub> hub(new StreamHub(name, videoPath, audioPath));
+    _registry[name] = hub;
+    return hub;
+}
+
+StreamHub::StreamHub(const std::string& name, const std::string& videoPath, const std::string& audioPath)
+:_name(name)
+,_video(MediaSource::open(videoPath, MediaCodec::H264))
+,_audio(MediaSource::open(audioPath, MediaCodec::AAC))
+,_payloadCache(nullptr)
+,_subscribers(std::make_shared<SubscriberList>())
+,_loop(nullptr)
+,_generation(0)
+,_videoCursor(0)
+,_audioCursor(0)
+,_spsIndex(kNoIndex)
+,_ppsIndex(kNoIndex)
+,_seqVideo(0)
+,_seqAudio(0)
+,_timestampVideo(0)
+,_timestampAudio(0)
+,_audioSampleRate(44100)
+{
+    AacConfig config;
+    if (_audio->frameCount() > 0 &&
+        parseAdtsConfig(_audio->frameData(_audio->frame(0)), _audio->frame(0).size, config)) {
+        _audioSampleRate = config.sampleRate;
+    }
+    LOG_INFO("StreamHub %s created", _name.c_str());
+}
+
+StreamHub::~StreamHub() {
+    LOG_INFO("StreamHub %s destroyed", _name.c_str());
+}
+
+void StreamHub::subscribe(const std::shared_ptr<StreamSubscriber>& subscriber, EventLoop* loop) {
+    bool needStart = false;
+    size_t count = 0;
+    HubGopPtr gop;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // GOP 快照和加入订阅者在同一把锁内完成：快照里的帧不会再实时投递给它，之后的帧一定会
+        gop = std::make_shared<HubGop>(_gop);
+        auto list = std::make_shared<SubscriberList>(*_subscribers);
+        list->push_back(Subscription{subscriber, subscriber.get(), loop});
+        _subscribers = list;
+        count = list->size();
+        needStart = (_loop == nullptr);
+        if (needStart) {
+            _loop = loop;
+        }
+    }
+    LOG_INFO("StreamHub %s: subscriber added, total: %zu, gop frames: %zu", _name.c_str(), count, gop->size());
+    std::shared_ptr<StreamSubscriber> sub = subscriber;
+    loop->runInLoop([sub, gop]() {
+        sub->onStreamBurst(gop);
+    });
+    if (needStart) {
+        startProducer(loop);
+    }
+}
+
+void StreamHub::unsubscribe(const StreamSubscriber* subscriber) {
+    bool needStop = false;
+    size_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto list = std::make_shared<SubscriberList>();
+        for (const auto& sub : *_subscribers) {
+            if (sub.key != subscriber) {
+                list->push_back(sub);
+            }
+        }
+        _subscribers = list;
+        count = list->size();
+        needStop = list->empty() && _loop != nullptr;
+    }
+    LOG_INFO("StreamHub %s: subscriber removed, total: %zu", _name.c_str(), count);
+    if (needStop) {
+        stopProducer();
+    }
+}
+
+size_t StreamHub::subscriberCount() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _subscribers->size();
+}
+
+void StreamHub::startProducer(EventLoop* loop) {
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        generation = ++_generation;
+    }
+    std::weak_ptr<StreamHub> weakSelf = shared_from_this();
+    loop->runInLoop([this, weakSelf, loop, generation]() {
+        auto self = weakSelf.lock();
+        if (!self) {
+            return;
+        }
+        std::lock_guard<std::mutex> produceLock(_produceMutex);
+        std::shared_ptr<Producer> producer;
+        {
+            // 代数检查和登记生产者在同一把锁里：stopProducer 要么在这之前（这里直接返回），
+            // 要么在这之后拿走 _producer 并投递取消，不会留下没人停的调度
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (generation != _generation) {
+                return;
+            }
+            producer = std::make_shared<Producer>(weakSelf, generation);
+            _producer = producer;
+        }
+        _nextVideoTime = steady_clock::now();
+        _nextAudioTime = _nextVideoTime;
+        MediaPacer::forLoop(loop).schedule(producer, _nextVideoTime);
+        LOG_INFO("StreamHub %s producer started", _name.c_str());
+    });
+}
+
+void StreamHub::stopProducer() {
+    EventLoop* loop = nullptr;
+    std::shared_ptr<Producer> producer;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loop = _loop;
+        producer = std::move(_producer);
+        _loop = nullptr;
+        ++_generation;
+        // 重新启动时从文件当前位置接着播，旧 GOP 的序号、时间戳和之后的实时包接不上，不能再补发给新观众
+        _gop.clear();
+    }
+    if (loop && producer) {
+        // MediaPacer 不是线程安全的，取消操作投递回生产者所在线程
+        loop->runInLoop([loop, producer]() {
+            MediaPacer::forLoop(loop).cancel(producer.get());
+        });
+    }
+    LOG_INFO("StreamHub %s producer stopped", _name.c_str());
+}
+
+bool StreamHub::onPace(uint64_t generation, steady_clock::time_point now, steady_clock::time_point& nextDue) {
+    // 持锁期间旧生产者不会被新启动的那个穿插进来；检查通过后这一轮产出都属于本代
+    std::lock_guard<std::mutex> produceLock(_produceMutex);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (generation != _generation) {
+            return false;
+        }
+    }
+    if (!_payloadCache && _video->frameCount() > 0) {
+        _payloadCache = _video->rtpPayloadCache();
+        if (!_payloadCache) {
+            // 预打包缓存还在后台构建，先不出数据；建好后从那一刻开始，不补发等待期间的帧
+            _nextVideoTime = now + milliseconds(kCacheWaitMs);
+            _nextAudioTime = _nextVideoTime;
+            nextDue = _nextVideoTime;
+            return true;
+        }
+        // 一拍最多一帧视频，加上按延迟预算取的音频帧，每帧最多一个包（超大帧分片除外）
+        _batchReserve = _payloadCache->maxFramePackets() + AacAggregator::framesPerBudget(_audioSampleRate);
+    }
+    produce(generation, now);
+    nextDue = std::min(_nextVideoTime, _nextAudioTime);
+    return true;
+}
+
+void StreamHub::produce(uint64_t generation, steady_clock::time_point now) {
+    std::shared_ptr<HubPacketBatch> video;
+    bool isKeyFrame = false;
+    if (now >= _nextVideoTime) {
+        // 没有视频帧时也照常推进，否则到期时间一直停在过去，调度器会不停地唤醒
+        video = takeBatch();
+        produceVideo(*video, isKeyFrame);
+        _nextVideoTime += milliseconds(40);
+    }
+    // 音频没到期时实时批次就是视频批次本身；到期时 GOP 里只能放纯视频，另取一个批次，视频包只拷引用
+    std::shared_ptr<HubPacketBatch> batch = video;
+    if (now >= _nextAudioTime) {
+        batch = takeBatch();
+        if (video) {
+            batch->insert(batch->end(), video->begin(), video->end());
+        }
+        size_t frames = produceAudio(*batch);
+        if (frames > 0) {
+            _nextAudioTime += microseconds(AacAggregator::framesDurationUs(frames, _audioSampleRate));
+        } else {
+            _nextAudioTime = steady_clock::time_point::max();   // 没有音频
+        }
+    }
+    if (!batch || batch->empty()) {
+        return;
+    }
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (generation != _generation) {
+            return;     // 生产期间被停止：GOP 已经清空，这一批也不再发布
+        }
+        if (video && !video->empty()) {
+            if (isKeyFrame) {
+                _gop.clear();
+            }
+            // 还没遇到第一个 IDR 时不缓存。GOP 过长时整个丢掉、等下一个 IDR：只留开头的话，
+            // 新观众补完这段后直接跳到很靠后的实时帧，序号断开、参考帧缺失，要到下一个 IDR 才能解对
+            if (isKeyFrame || !_gop.empty()) {
+                if (_gop.size() < kMaxGopFrames) {
+                    _gop.push_back(video);
+                } else {
+                    LOG_DEBUG("StreamHub %s: GOP longer than %zu frames, cache dropped until next IDR",
+                              _name.c_str(), kMaxGopFrames);
+                    _gop.clear();
+                }
+            }
+        }
+        subscribers = _subscribers;
+    }
+    publish(batch, subscribers);
+}
+
+bool StreamHub::produceVideo(HubPacketBatch& batch, bool& isKeyFrame) {
+    size_t count = _video->frameCount();
+    if (count == 0) {
+        return false;
+    }
+    // SPS/PPS 只记录下标，随 IDR 一起发出；一直读到一个需要占用帧时间的 NALU 为止
+    for (size_t scanned = 0; scanned < count; ++scanned) {
+        if (_videoCursor >= count) {
+            _videoCursor = 0;//直播循环：读完从头开始，时间戳和序号继续累加
+        }
+        size_t idx = _videoCursor++;
+        const MediaFrame& frame = _video->frame(idx);
+        if (frame.type == 7) {
+            _spsIndex = idx;
+            continue;
+        } else if (frame.type == 8) {
+            _ppsIndex = idx;
+            continue;
+        }
+        const RtpPayload* stap = _payloadCache->stapA(idx);
+        if (stap) {
+            appendVideoPacket(batch, *stap);
+        } else {
+            if (frame.type == 5) {
+                if (_spsIndex != kNoIndex) appendCachedNalu(batch, _spsIndex);
+                if (_ppsIndex != kNoIndex) appendCachedNalu(batch, _ppsIndex);
+            }
+            appendCachedNalu(batch, idx);
+        }
+        _timestampVideo += 3600;
+        isKeyFrame = (frame.type == 5);
+        return true;
+    }
+    return false;
+}
+
+size_t StreamHub::produceAudio(HubPacketBatch& batch) {
+    size_t count = _audio->frameCount();
+    if (count == 0) {
+        return 0;
+    }
+    size_t frames = std::min(AacAggregator::framesPerBudget(_audioSampleRate), count);
+    AacAggregator& aggregator = _aacAggregator;
+    aggregator.clear();
+    auto flush = [&]() {
+        PacketPtr packet = PacketBuffer::alloc();
+        uint8_t* p = packet->append(aggregator.payloadSize());
+        if (p) {
+            aggregator.writePayload(p);
+            batch.push_back(HubPacket{2, finishPacket(std::move(packet), 2, _seqAudio++, _timestampAudio, _ssrcAudio,
+                                                      kRtpPayloadTypeAac, true)});
+        }
+        _timestampAudio += kAacSamplesPerFrame * aggregator.count();
+        aggregator.clear();
+    };
+    // 单独一个包也放不下的帧分片发送，和 RtpPusher::sendAacFragments 一致
+    auto fragment = [&](const uint8_t* aac, size_t len) {
+        const uint8_t* au = nullptr;
+        size_t auSize = 0;
+        if (AacAggregator::auData(aac, len, au, auSize)) {
+            for (size_t pos = 0; pos < auSize;) {
+                size_t n = std::min(aggregator.maxFragmentData(), auSize - pos);
+                PacketPtr packet = PacketBuffer::alloc();
+                AacAggregator::writeFragment(packet->append(4 + n), auSize, au + pos, n);
+                pos += n;
+                batch.push_back(HubPacket{2, finishPacket(std::move(packet), 2, _seqAudio++, _timestampAudio,
+                                                          _ssrcAudio, kRtpPayloadTypeAac, pos == auSize)});
+            }
+        } else {
+            LOG_WARN("StreamHub %s: AAC frame of %zu bytes can not be packetized, dropped", _name.c_str(), len);
+        }
+        _timestampAudio += kAacSamplesPerFrame;
+    };
+    for (size_t i = 0; i < frames; ++i) {
+        if (_audioCursor >= count) {
+            _audioCursor = 0;
+        }
+        const MediaFrame& frame = _audio->frame(_audioCursor++);
+        const uint8_t* aac = _audio->frameData(frame);
+        if (aggregator.append(aac, frame.size)) {
+            continue;
+        }
+        if (!aggregator.empty()) {
+            flush();
+            if (aggregator.append(aac, frame.size)) {
+                continue;
+            }
+        }
+        fragment(aac, frame.size);
+    }
+    if (!aggregator.empty()) {
+        flush();
+    }
+    return frames;
+}
+
+std::shared_ptr<HubPacketBatch> StreamHub::takeBatch() {
+    for (size_t i = 0; i < _batchPool.size(); ++i) {
+        std::shared_ptr<HubPacketBatch>& batch = _batchPool[_batchCursor];
+        _batchCursor = (_batchCursor + 1) % _batchPool.size();
+        // 只剩池里这一个引用时别的线程已经放手，也拿不到新的引用（GOP 快照只从 _gop 里拷）；
+        // 放手时的递减是 release，这里补一个 acquire，保证它们对这一批的读都在复用之前
+        if (batch.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            batch->clear();     // 保留容量；旧包的引用在这里（生产者线程）放掉
+            return batch;
+        }
+    }
+    auto batch = std::make_shared<HubPacketBatch>();
+    batch->reserve(_batchReserve);  // 一次给够，之后轮到它装大帧时不用再扩容
+    if (_batchPool.size() < kMaxPooledBatches) {
+        _batchPool.push_back(batch);
+    }
+    return batch;
+}
+
+void StreamHub::appendCachedNalu(HubPacketBatch& batch, size_t nalIndex) {
+    for (auto p = _payloadCache->payloadsBegin(nalIndex); p != _payloadCache->payloadsEnd(nalIndex); ++p) {
+        appendVideoPacket(batch, *p);
+    }
+}
+
+void StreamHub::appendVideoPacket(HubPacketBatch& batch, const RtpPayload& payload) {
+    // 外挂段持有 _video，GOP 缓存和各订阅者的发送链里还有这个包时映射不会被解除
+    PacketPtr packet = PacketBuffer::alloc();
+    if (payload.bodySize == 0) {
+        packet->attachTail(_payloadCache->head(payload), payload.headSize, _video);
+    } else {
+        ::memcpy(packet->append(payload.headSize), _payloadCache->head(payload), payload.headSize);
+        packet->attachTail(_payloadCache->body(payload), payload.bodySize, _video);
+    }
+    batch.push_back(HubPacket{0, finishPacket(std::move(packet), 0, _seqVideo++, _timestampVideo, _ssrcVideo,
+                                              kRtpPayloadTypeH264, payload.marker)});
+}
+
+PacketPtr StreamHub::finishPacket(PacketPtr&& packet, uint8_t channel, uint16_t seq, uint32_t timestamp,
+                                  uint32_t ssrc, uint8_t pt, bool marker) {
+    // RTP 头和 interleaved 前缀都写在 headroom 里；前缀对所有 TCP 订阅者相同，这里一次写好
+    size_t rtpLen = kRtpHeaderSize + packet->totalSize();
+    writeRtpHeader(packet->prepend(kRtpHeaderSize), seq, timestamp, ssrc, pt, marker);
+    uint8_t* p = packet->prepend(4);
+    p[0] = '$';
+    p[1] = channel;
+    p[2] = uint8_t(rtpLen >> 8);
+    p[3] = uint8_t(rtpLen & 0xFF);
+    return std::move(packet);
+}
+
+void StreamHub::publish(const HubPacketBatchPtr& batch, const std::shared_ptr<const SubscriberList>& subscribers) {
+    for (const auto& sub : *subscribers) {
+        auto subscriber = sub.subscriber.lock();
+        if (!subscriber) {
+            continue;
+        }
+        // 同一批次只有一份数据，投递到各订阅者自己的线程里发送；和生产者同一个 loop 的直接调用，不用包装成任务
+        if (sub.loop->isInLoopThread()) {
+            subscriber->onStreamPackets(batch);
+            continue;
+        }
+        sub.loop->runInLoop([subscriber, batch]() {
+            subscriber->onStreamPackets(batch);
+        });
+    }
+}
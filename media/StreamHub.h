@@ -0,0 +1,147 @@
+#ifndef __STREAMHUB_H__
+#define __STREAMHUB_H__
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "MediaSource.h"
+#include "RtpPayloadCache.h"
+#include "MediaPacer.h"
+#include "AacPacketizer.h"
+#include "RtpHeader.h"
+#include "../reactor/EventLoop.h"
+#include "../reactor/NonCopyable.h"
+#include "../reactor/PacketBuffer.h"
+
+// 一个已经打好 RTP 头的包，所有订阅者共享同一份数据
+struct HubPacket {
+    uint8_t channel;    // 0 视频 RTP，2 音频 RTP，与 interleaved 通道号一致
+    PacketPtr data;     // interleaved 前缀 + RTP 头 + 载荷，实时批次和 GOP 缓存共享同一份；UDP 发送时跳过前 4 字节
+};
+using HubPacketBatch = std::vector<HubPacket>;
+using HubPacketBatchPtr = std::shared_ptr<const HubPacketBatch>;
+// 从最近一个 IDR（带 SPS/PPS）开始到当前为止的视频帧，每个元素是一帧的全部包
+using HubGop = std::vector<HubPacketBatchPtr>;
+using HubGopPtr = std::shared_ptr<const HubGop>;
+
+class StreamSubscriber {
+public:
+    virtual ~StreamSubscriber() = default;
+    // 以下回调都在订阅时指定的 EventLoop 线程中被调用
+    // 订阅后先收到一次 GOP 缓存（可能为空），之后是实时批次；二者的先后由订阅者自己保证
+    virtual void onStreamBurst(const HubGopPtr& gop) = 0;
+    virtual void onStreamPackets(const HubPacketBatchPtr& batch) = 0;
+};
+
+/*
+直播式分发中心：每路流只有一个读取/打包者，按节奏产出引用计数的 RTP 包批次，
+再投递给挂在任意 EventLoop 上的 N 个订阅者，媒体处理的开销从 O(观众数) 变成 O(流数)。
+生产者交给第一个订阅者所在 EventLoop 的 MediaPacer 调度，最后一个订阅者离开时停止；文件读完后从头循环。
+同时缓存当前 GOP，新观众从最近的 IDR 开始看，不用等下一个关键帧。
+*/
+class StreamHub
+: NonCopyable
+, public std::enable_shared_from_this<StreamHub> {
+public:
+    static std::shared_ptr<StreamHub> get(const std::string& name,
+                                          const std::string& videoPath,
+                                          const std::string& audioPath);
+    ~StreamHub();
+
+    void subscribe(const std::shared_ptr<StreamSubscriber>& subscriber, EventLoop* loop);
+    void unsubscribe(const StreamSubscriber* subscriber);
+    size_t subscriberCount() const;
+
+private:
+    friend class StreamHubBench;    // bench/alloc_count_bench.cc 绕过 MediaPacer 直接驱动 onPace，统计堆分配
+
+    StreamHub(const std::string& name, const std::string& videoPath, const std::string& audioPath);
+
+    struct Subscription {
+        std::weak_ptr<StreamSubscriber> subscriber;
+        const StreamSubscriber* key;
+        EventLoop* loop;
+    };
+    using SubscriberList = std::vector<Subscription>;
+
+    // 生产者每启动一次就是一个新的调度对象：停止后旧对象即使还留在某个 MediaPacer 里，唤醒时也只会发现代数过期而退出，
+    // 不会误删或干扰下一次启动的调度
+    class Producer : public PacedStream {
+    public:
+        Producer(const std::weak_ptr<StreamHub>& hub, uint64_t generation) : _hub(hub), _generation(generation) {}
+        bool onPace(std::chrono::steady_clock::time_point now,
+                    std::chrono::steady_clock::time_point& nextDue) override {
+            auto hub = _hub.lock();
+            return hub && hub->onPace(_generation, now, nextDue);
+        }
+    private:
+        std::weak_ptr<StreamHub> _hub;
+        uint64_t _generation;
+    };
+
+    void startProducer(EventLoop* loop);
+    void stopProducer();
+    bool onPace(uint64_t generation, std::chrono::steady_clock::time_point now,
+                std::chrono::steady_clock::time_point& nextDue);
+    // 产出到期的音视频并发布给订阅者
+    void produce(uint64_t generation, std::chrono::steady_clock::time_point now);
+    bool produceVideo(HubPacketBatch& batch, bool& isKeyFrame);
+    size_t produceAudio(HubPacketBatch& batch);
+    // NALU 数据作为外挂段引用文件映射，不拷贝；只有 FU 头和 RTP 头写进包里
+    void appendVideoPacket(HubPacketBatch& batch, const RtpPayload& payload);
+    static PacketPtr finishPacket(PacketPtr&& packet, uint8_t channel, uint16_t seq, uint32_t timestamp,
+                                  uint32_t ssrc, uint8_t pt, bool marker);
+    void appendCachedNalu(HubPacketBatch& batch, size_t nalIndex);
+    // 取一个空批次：优先复用池里已经没有别人引用的，稳态下不再分配
+    std::shared_ptr<HubPacketBatch> takeBatch();
+    void publish(const HubPacketBatchPtr& batch, const std::shared_ptr<const SubscriberList>& subscribers);
+
+    std::string _name;
+    std::shared_ptr<MediaSource> _video;
+    std::shared_ptr<MediaSource> _audio;
+    const RtpPayloadCache* _payloadCache;   // 后台构建完成后才有，受 _produceMutex 保护
+
+    // 订阅者列表写时复制：发布时只需在锁内拷贝一个 shared_ptr
+    mutable std::mutex _mutex;
+    std::shared_ptr<const SubscriberList> _subscribers;
+    EventLoop* _loop;
+    std::shared_ptr<Producer> _producer;    // MediaPacer 只持有弱引用，停止时在这里释放
+    uint64_t _generation;                   // 每次启动、停止生产者都加一，受 _mutex 保护
+    HubGop _gop;                        // 当前 GOP，受 _mutex 保护，保证和订阅者列表的快照一致
+    static const size_t kMaxGopFrames = 300;
+
+    // 以下生产者状态受 _produceMutex 保护。停止后马上在另一个 EventLoop 上重新启动时，
+    // 旧生产者可能还在原线程里跑着这一轮 produce，两边靠这把锁串行，新的一轮再由代数检查挡掉旧的。
+    // 加锁顺序：先 _produceMutex，再 _mutex
+    std::mutex _produceMutex;
+    size_t _videoCursor;
+    size_t _audioCursor;
+    size_t _spsIndex;
+    size_t _ppsIndex;
+    uint16_t _seqVideo;
+    uint16_t _seqAudio;
+    uint32_t _timestampVideo;
+    uint32_t _timestampAudio;
+    int _audioSampleRate;
+    AacAggregator _aacAggregator{RtpPayloadCache::kMtu - kRtpHeaderSize};  // 每轮复用，保留容量
+    const uint32_t _ssrcVideo = 0x12345678;
+    const uint32_t _ssrcAudio = 0x87654321;
+    std::chrono::steady_clock::time_point _nextVideoTime;
+    std::chrono::steady_clock::time_point _nextAudioTime;
+    // 批次池：GOP 缓存和各订阅者放掉引用后，批次连同 vector 的容量一起复用。
+    // 上限之外临时分配，不让订阅者积压时长大的池一直占着内存
+    std::vector<std::shared_ptr<HubPacketBatch>> _batchPool;
+    size_t _batchCursor = 0;
+    size_t _batchReserve = 0;   // 新批次预留的容量，拿到预打包缓存时按最大的帧算好
+    static const size_t kMaxPooledBatches = kMaxGopFrames + 64;
+    // 预打包缓存还在后台构建时，隔这么久再看一次
+    static const int kCacheWaitMs = 10;
+
+    static std::map<std::string, std::weak_ptr<StreamHub>> _registry;
+    static std::mutex _registryMutex;
+};
+
+#endif
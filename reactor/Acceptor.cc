@@ -60,7 +60,9 @@ void Acceptor::listen(){
 }
 
 int Acceptor::accept(){
-    int connfd = ::accept(_sock.fd(),nullptr,nullptr);
+    // 连接 fd 必须是非阻塞的：内核发送缓冲区满时 sendmsg 返回 EAGAIN，数据留在发送链上，
+    // 而不是把整个 EventLoop 线程阻塞住
+    int connfd = ::accept4(_sock.fd(),nullptr,nullptr,SOCK_NONBLOCK | SOCK_CLOEXEC);
     if(-1 == connfd){
         LOG_ERROR("accept failed: %s", strerror(errno));
         return -1;
@@ -9,6 +9,8 @@
 #include <memory>
 #include <cassert>
 #include <string.h>
+#include <poll.h>
+#include <algorithm>
 #include "Logger.h"
 
 using std::cout;
@@ -16,13 +18,19 @@ using std::endl;
 using std::cerr;
 using std::unique_lock;
 
+std::atomic_bool EventLoop::_ioUringEnabled{false};
+std::atomic_bool EventLoop::_edgeTriggeredEnabled{false};
+
 EventLoop::EventLoop(Acceptor &acceptor, bool isMainLoop)
-:_epfd(createEpollFd())
+:_uring(createIoUring())
+,_epfd(_uring ? -1 : createEpollFd())
+,_edgeTriggered(!_uring && _edgeTriggeredEnabled)
 ,_evtList(1024)
 ,_isLooping(false)
 ,_acceptor(acceptor)
 ,_conns()
 ,_eventor()//创建用于通信的文件描述符
+,_timeMgr(_uring == nullptr)   // io_uring 下定时器不用 timerfd，到期时间作为等待超时
 ,_threadId() // 初始化为空
 {
     if (isMainLoop) {
@@ -33,12 +41,29 @@ EventLoop::EventLoop(Acceptor &acceptor, bool isMainLoop)
     else{
         LOG_INFO("Sub EventLoop created");
         addEpollReadFd(_eventor.getEvtfd());
-        addEpollReadFd(_timeMgr.getTimerFd());
+        if (_timeMgr.getTimerFd() >= 0) {
+            addEpollReadFd(_timeMgr.getTimerFd());
+        }
     }
 }
 EventLoop::~EventLoop(){
-    LOG_DEBUG("EventLoop destructor called, closing epoll fd: %d", _epfd);
-    close(_epfd);
+    if (_epfd >= 0) {
+        LOG_DEBUG("EventLoop destructor called, closing epoll fd: %d", _epfd);
+        close(_epfd);
+    }
+}
+
+std::unique_ptr<IoUring> EventLoop::createIoUring(){
+    std::unique_ptr<IoUring> uring;
+    if (!_ioUringEnabled) {
+        return uring;
+    }
+    uring.reset(new IoUring);
+    if (!uring->init(4096)) {
+        LOG_WARN("io_uring unavailable, EventLoop falls back to epoll");
+        uring.reset();
+    }
+    return uring;
 }
 
 void EventLoop::loop(){
@@ -46,7 +71,11 @@ void EventLoop::loop(){
     _isLooping = true;
     LOG_INFO("EventLoop started in thread: %zu", std::hash<std::thread::id>{}(_threadId));
     while(_isLooping){
-        waitEpollFd();
+        if (_uring) {
+            waitIoUring();
+        } else {
+            waitEpollFd();
+        }
     }
     LOG_INFO("EventLoop stopped in thread: %zu", std::hash<std::thread::id>{}(_threadId));
 }
@@ -68,7 +97,7 @@ void EventLoop::addConnection(const TcpConnectionPtr& conn) {
     int fd = conn->getFd();
 
     _conns[fd] = conn;
-    addEpollReadFd(fd);
+    addEpollConnFd(fd, true);
     LOG_DEBUG("Added connection fd: %d, total connections: %zu", fd, _conns.size());
 }
 
@@ -100,35 +129,94 @@ void EventLoop::waitEpollFd(){
             LOG_DEBUG("Expanded event list to %zu", _evtList.capacity());
         }
         for(int idx = 0;idx < nready; ++idx){
-            int fd = _evtList[idx].data.fd;
             uint32_t events = _evtList[idx].events;
-            if(fd == _acceptor.fd()){//处理当有客户端连接时
-                if(events & EPOLLIN){
-                    LOG_DEBUG("New connection event on acceptor fd: %d", fd);
-                    handleNewConnection();
-                }
-            }else if(fd == _eventor.getEvtfd()){//处理触发事件响应
-                if(events & EPOLLIN){
-                    LOG_DEBUG("Eventor event on fd: %d", fd);
-                    _eventor.handleRead();
-                }
-            }else if(fd == _timeMgr.getTimerFd()){//处理时间响应任务
-                if(events & EPOLLIN){
-                    // LOG_DEBUG("Timer event on fd: %d", fd);
-                    _timeMgr.handleRead();
-                }
-            }else{
-                if(events & EPOLLIN){
-                    // LOG_DEBUG("Read event on fd: %d", fd);
-                    handleMessage(fd);
-                }
-                if(events & EPOLLOUT){
-                    // LOG_DEBUG("Write event on fd: %d", fd);
-                    auto itTcp = _conns.find(fd);
-                    if(itTcp != _conns.end()){
-                        itTcp->second->handleWriteCallback();
-                    }
-                }
+            handleEvent(_evtList[idx].data.fd, events & (EPOLLIN | EPOLLRDHUP), events & EPOLLOUT, events & EPOLLERR,
+                        events & (EPOLLRDHUP | EPOLLHUP));
+        }
+    }
+}
+
+void EventLoop::waitIoUring(){
+    // 最近的定时器到期时间就是等待超时，没有定时器时和 epoll_wait 一样最多等 3 秒；
+    // 还有没放进 SQ 的 poll 时不等待，这次 enter 把 SQ 提交空了，下一轮马上补上
+    retryPolls();
+    bool retrying = !_pollRetry.empty() || !_cancelRetry.empty();
+    _completions.clear();
+    if (!_uring->submitAndWait(retrying ? 0 : _timeMgr.timeoutMs(3000), _completions)) {
+        return;
+    }
+    for (const IoUring::Completion& cqe : _completions) {
+        UringOp op = UringOp(cqe.data >> 56);
+        uint32_t gen = (cqe.data >> 32) & 0xffffff;
+        int fd = int(uint32_t(cqe.data));
+        if (op == kUringPoll) {
+            auto it = _polls.find(fd);
+            if (it == _polls.end() || (it->second.gen & 0xffffff) != gen) {
+                continue;   // 已经注销或换了掩码重新注册，这是被取消的旧请求
+            }
+            it->second.armed = false;
+            if (cqe.res < 0) {
+                LOG_ERROR("io_uring poll failed for fd %d: %s", fd, strerror(-cqe.res));
+                continue;
+            }
+            // 对端关闭、出错时和 epoll 一样当作可读，由读回调发现并关闭连接
+            uint32_t revents = cqe.res;
+            handleEvent(fd, revents & (POLLIN | POLLHUP | POLLERR), revents & POLLOUT, revents & POLLERR, revents & POLLHUP);
+            // 单次 poll：处理完仍在关注就重新挂上，下一轮和别的提交项一起提交
+            it = _polls.find(fd);
+            if (it != _polls.end() && !it->second.armed) {
+                armPoll(fd, it->second);
+            }
+        } else if (op == kUringSend) {
+            auto it = _sendsInFlight.find(fd);
+            if (it == _sendsInFlight.end()) {
+                continue;
+            }
+            TcpConnectionPtr conn = std::move(it->second);
+            _sendsInFlight.erase(it);
+            auto itConn = _conns.find(fd);
+            if (itConn == _conns.end() || itConn->second != conn) {
+                continue;   // 连接已经移除，剩下的数据不再发送
+            }
+            conn->handleSendComplete(cqe.res);
+        }
+    }
+    _timeMgr.handleExpired();
+}
+
+void EventLoop::handleEvent(int fd, bool readable, bool writable, bool error, bool hangup){
+    if(fd == _acceptor.fd()){//处理当有客户端连接时
+        if(readable){
+            LOG_DEBUG("New connection event on acceptor fd: %d", fd);
+            handleNewConnection();
+        }
+    }else if(fd == _eventor.getEvtfd()){//处理触发事件响应
+        if(readable){
+            LOG_DEBUG("Eventor event on fd: %d", fd);
+            _eventor.handleRead();
+        }
+    }else if(fd == _timeMgr.getTimerFd()){//处理时间响应任务
+        if(readable){
+            // LOG_DEBUG("Timer event on fd: %d", fd);
+            _timeMgr.handleRead();
+        }
+    }else{
+        if(readable){
+            // LOG_DEBUG("Read event on fd: %d", fd);
+            handleMessage(fd, hangup);
+        }
+        if(writable){
+            // LOG_DEBUG("Write event on fd: %d", fd);
+            auto itTcp = _conns.find(fd);
+            if(itTcp != _conns.end()){
+                itTcp->second->handleWriteCallback();
+            }
+        }
+        if(error){
+            // MSG_ZEROCOPY 的完成通知经错误队列送达，没有开零拷贝的连接直接忽略
+            auto itTcp = _conns.find(fd);
+            if(itTcp != _conns.end()){
+                itTcp->second->handleErrorQueue();
             }
         }
     }
@@ -142,16 +230,19 @@ void EventLoop::handleNewConnection(){
     LOG_INFO("New connection accepted, fd: %d", connfd);
     _onNewConnectionCb(connfd);
 }
-void EventLoop::handleMessage(int fd){
+void EventLoop::handleMessage(int fd, bool hangup){
     auto itTcp = _conns.find(fd);
     auto itUdp = udpConns.find(fd);
     if(itTcp != _conns.end()){
-        if(itTcp->second->isClosed()){
-            LOG_DEBUG("Connection fd: %d is closed, handling close callback", fd);
-            itTcp->second->handleCloseCallback();
-            removeConnection(itTcp->second);
-        }else{
-            itTcp->second->handleMessageCallback();
+        TcpConnectionPtr conn = itTcp->second;
+        // 每个可读事件只读一次（readv），对端关闭由这次读的返回值发现；读到的完整请求在回调里一次处理完，
+        // 关闭前先处理，对端发完 TEARDOWN 紧接着关闭时请求也不会丢
+        if(conn->readInput(hangup) > 0){
+            conn->handleMessageCallback();
+        }
+        if(conn->peerClosed() && _conns.count(fd)){
+            LOG_DEBUG("Connection fd: %d closed by peer, handling close callback", fd);
+            closeConnection(conn);
         }
     }else if(itUdp != udpConns.end()){
         LOG_DEBUG("Handling UDP message for fd: %d", fd);
@@ -161,6 +252,11 @@ void EventLoop::handleMessage(int fd){
         return;
     }
 }
+void EventLoop::closeConnection(const TcpConnectionPtr& conn){
+    conn->handleCloseCallback();
+    removeConnection(conn);
+}
+
 int EventLoop::createEpollFd(){
     int fd = ::epoll_create1(0);
     if(fd < 0){
@@ -170,12 +266,117 @@ int EventLoop::createEpollFd(){
     LOG_DEBUG("Created epoll fd: %d", fd);
     return fd;
 }
-void EventLoop::addEpollReadFd(int fd){
-    struct  epoll_event evt;
-    evt.events = EPOLLIN;
+void EventLoop::armPoll(int fd, PollState& state){
+    if (!_uring->prepPollAdd(fd, state.mask, uringData(kUringPoll, state.gen, fd))) {
+        // 不能就这样放弃：没挂上 poll 的 fd 再也不会有事件。记下来，下一轮提交腾出空间后再挂
+        LOG_WARN("io_uring submission queue full, retrying poll on fd %d next round", fd);
+        state.armed = false;
+        _pollRetry.push_back(fd);
+        return;
+    }
+    state.armed = true;
+}
+
+void EventLoop::cancelPoll(int fd, PollState& state){
+    uint64_t target = uringData(kUringPoll, state.gen, fd);
+    if (!_uring->prepPollRemove(target, uringData(kUringPollRemove, state.gen, fd))) {
+        // 旧请求的完成项会因 gen 不符被丢弃，但它一直挂着会占住 fd 的引用，下一轮再取消
+        LOG_WARN("io_uring submission queue full, retrying poll cancel on fd %d next round", fd);
+        _cancelRetry.push_back(target);
+    }
+    state.armed = false;
+}
+
+void EventLoop::retryPolls(){
+    if (!_cancelRetry.empty()) {
+        std::vector<uint64_t> targets;
+        targets.swap(_cancelRetry);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            uint64_t target = targets[i];
+            uint64_t data = (target & ~(uint64_t(0xff) << 56)) | (uint64_t(kUringPollRemove) << 56);
+            if (!_uring->prepPollRemove(target, data)) {
+                _cancelRetry.insert(_cancelRetry.end(), targets.begin() + i, targets.end());
+                break;
+            }
+        }
+    }
+    if (!_pollRetry.empty()) {
+        std::vector<int> fds;
+        fds.swap(_pollRetry);
+        for (int fd : fds) {
+            // 这期间可能已经注销，或者已经由别的路径重新挂上
+            auto it = _polls.find(fd);
+            if (it != _polls.end() && !it->second.armed) {
+                armPoll(fd, it->second);
+            }
+        }
+    }
+}
+
+void EventLoop::setPollMask(int fd, uint32_t mask){
+    auto it = _polls.find(fd);
+    if (it == _polls.end()) {
+        LOG_ERROR("setPollMask: fd %d is not registered", fd);
+        return;
+    }
+    PollState& state = it->second;
+    if (state.mask == mask) {
+        return;
+    }
+    state.mask = mask;
+    if (state.armed) {
+        // 挂着的 poll 改不了掩码：取消后换一个 gen 重新挂，旧请求的完成项会被丢弃
+        cancelPoll(fd, state);
+        state.gen = _nextPollGen++;
+        armPoll(fd, state);
+    }
+}
+
+bool EventLoop::submitSend(const TcpConnectionPtr& conn, const struct msghdr* msg){
+    int fd = conn->getFd();
+    if (!_uring->prepSendmsg(fd, msg, MSG_NOSIGNAL, uringData(kUringSend, 0, fd))) {
+        return false;
+    }
+    _sendsInFlight[fd] = conn;
+    return true;
+}
+
+int EventLoop::epollCtl(int op, int fd, uint32_t events){
+    struct epoll_event evt;
+    evt.events = events;
     evt.data.fd = fd;
-    
-    int ret = ::epoll_ctl(_epfd,EPOLL_CTL_ADD,fd,&evt);
+    _epollCtlCalls.fetch_add(1, std::memory_order_relaxed);
+    return ::epoll_ctl(_epfd, op, fd, &evt);
+}
+
+void EventLoop::addEpollConnFd(int fd, bool writable){
+    if (!_edgeTriggered) {
+        addEpollReadFd(fd);
+        return;
+    }
+    uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    if (writable) {
+        events |= EPOLLOUT;
+    }
+    if (epollCtl(EPOLL_CTL_ADD, fd, events) < 0) {
+        LOG_ERROR("epoll_ctl_add (edge) failed for fd %d: %s", fd, strerror(errno));
+        return;
+    }
+    LOG_DEBUG("Added fd %d to epoll in edge-triggered mode", fd);
+}
+
+void EventLoop::addEpollReadFd(int fd){
+    if (_uring) {
+        PollState& state = _polls[fd];
+        if (state.armed) {
+            cancelPoll(fd, state);
+        }
+        state.gen = _nextPollGen++;
+        state.mask = POLLIN;
+        armPoll(fd, state);
+        return;
+    }
+    int ret = epollCtl(EPOLL_CTL_ADD, fd, EPOLLIN);
     if(ret < 0){
         LOG_ERROR("epoll_ctl_add failed for fd %d: %s", fd, strerror(errno));
         return;
@@ -184,10 +385,17 @@ void EventLoop::addEpollReadFd(int fd){
     
 }
 void EventLoop::delEpollReadFd(int fd){
-    struct  epoll_event evt;
-    evt.data.fd = fd;
-    
-    int ret = ::epoll_ctl(_epfd,EPOLL_CTL_DEL,fd,&evt);
+    if (_uring) {
+        auto it = _polls.find(fd);
+        if (it != _polls.end()) {
+            if (it->second.armed) {
+                cancelPoll(fd, it->second);
+            }
+            _polls.erase(it);
+        }
+        return;
+    }
+    int ret = epollCtl(EPOLL_CTL_DEL, fd, 0);
     if(ret < 0){
         LOG_ERROR("epoll_ctl_del failed for fd %d: %s", fd, strerror(errno));
         return;
@@ -196,10 +404,14 @@ void EventLoop::delEpollReadFd(int fd){
 }
 
 void EventLoop::addEpollWriteFd(int fd){
-    struct epoll_event evt;
-    evt.events = EPOLLOUT | EPOLLIN;
-    evt.data.fd = fd;
-    int ret = ::epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &evt);
+    if (_uring) {
+        setPollMask(fd, POLLIN | POLLOUT);
+        return;
+    }
+    if (_edgeTriggered) {
+        return;     // 连接注册时已经挂着 EPOLLOUT
+    }
+    int ret = epollCtl(EPOLL_CTL_MOD, fd, EPOLLOUT | EPOLLIN);
     if(ret < 0){
         LOG_ERROR("epoll_ctl_mod (add write) failed for fd %d: %s", fd, strerror(errno));
         return;
@@ -207,10 +419,14 @@ void EventLoop::addEpollWriteFd(int fd){
     LOG_DEBUG("Added write event for fd %d", fd);
 }
 void EventLoop::delEpollWriteFd(int fd){
-    struct epoll_event evt;
-    evt.events = EPOLLIN;
-    evt.data.fd = fd;
-    int ret = ::epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &evt);
+    if (_uring) {
+        setPollMask(fd, POLLIN);
+        return;
+    }
+    if (_edgeTriggered) {
+        return;
+    }
+    int ret = epollCtl(EPOLL_CTL_MOD, fd, EPOLLIN);
     if(ret < 0){
         LOG_ERROR("epoll_ctl_mod (del write) failed for fd %d: %s", fd, strerror(errno));
         return;
@@ -7,8 +7,11 @@
 #include <functional>
 #include <mutex>
 #include <thread>
+#include <atomic>
+#include <unordered_map>
 #include "Eventor.h"
 #include "TimerManager.h"
+#include "IoUring.h"
 
 using std::vector;
 using std::map;
@@ -45,6 +48,30 @@ public:
     void delEpollReadFd(int fd);
     void addEpollWriteFd(int fd);
     void delEpollWriteFd(int fd);
+    // 连接（TCP/UDP）的 fd 用这个注册：边沿触发模式下一次登记 IN|RDHUP（writable 时再加 OUT）并一直保留，
+    // 之后的 add/delEpollWriteFd 不再调 epoll_ctl；没开边沿触发时等同于 addEpollReadFd
+    void addEpollConnFd(int fd, bool writable);
+
+    /*
+    边沿触发模式（EPOLLET）：之后新建的 EventLoop 生效，默认关闭，只作用于 epoll 后端。
+    连接一直挂着 EPOLLOUT，发送缓冲区满后不用再 MOD 出写关注、写空后再 MOD 回去；
+    代价是读写回调都必须做到 EAGAIN 为止，否则不会再收到通知。监听、eventfd、timerfd 仍是水平触发
+    */
+    static void setEdgeTriggered(bool enabled) { _edgeTriggeredEnabled = enabled; }
+    bool edgeTriggered() const { return _edgeTriggered; }
+    // 本 loop 累计调用 epoll_ctl 的次数，供统计输出算每秒次数
+    uint64_t epollCtlCalls() const { return _epollCtlCalls.load(std::memory_order_relaxed); }
+
+    /*
+    io_uring 后端：之后新建的 EventLoop 用 io_uring 代替 epoll，默认关闭，内核不支持时自动退回 epoll。
+    读写就绪改为单次 POLL_ADD（处理完再挂上，语义同水平触发），增删改和 TCP 发送都只是往 SQ 里放提交项，
+    每轮和等待合成一次 io_uring_enter；定时器不再用 timerfd，最近的到期时间直接作为等待超时。
+    上面的 add/del*Fd 接口不变，两种后端下调用方不用区分
+    */
+    static void setIoUringEnabled(bool enabled) { _ioUringEnabled = enabled; }
+    bool usingIoUring() const { return _uring != nullptr; }
+    // io_uring 后端下由 TcpConnection 提交一次 sendmsg，SQ 满时返回 false；完成前持有 conn，msg 和其中的缓冲区必须保持有效
+    bool submitSend(const TcpConnectionPtr& conn, const struct msghdr* msg);
     
     
     bool isInLoopThread() const { return _threadId == std::this_thread::get_id(); }
@@ -58,12 +85,35 @@ public:
 
 private:
     void waitEpollFd();
+    void waitIoUring();
+    void handleEvent(int fd, bool readable, bool writable, bool error, bool hangup);
     void handleNewConnection();
-    void handleMessage(int fd);
+    void handleMessage(int fd, bool hangup);
     int createEpollFd();
+    int epollCtl(int op, int fd, uint32_t events);
+    void closeConnection(const TcpConnectionPtr& conn);
+    static std::unique_ptr<IoUring> createIoUring();
+
+    // io_uring 下每个关注的 fd 一个 POLL_ADD；gen 区分同一个 fd 先后的注册，过期的完成项直接丢弃
+    struct PollState {
+        uint32_t gen;
+        uint32_t mask;
+        bool armed;     // 是否有一个还没完成的 POLL_ADD
+    };
+    enum UringOp : uint8_t { kUringPoll = 1, kUringPollRemove, kUringSend };
+    static uint64_t uringData(UringOp op, uint32_t gen, int fd) {
+        return (uint64_t(op) << 56) | (uint64_t(gen & 0xffffff) << 32) | uint32_t(fd);
+    }
+    void setPollMask(int fd, uint32_t mask);
+    void armPoll(int fd, PollState& state);
+    void cancelPoll(int fd, PollState& state);
+    void retryPolls();      // 把上一轮因 SQ 满没能放进去的 POLL_ADD/POLL_REMOVE 再放一次
 
 private:
+    std::unique_ptr<IoUring> _uring;    // 为空时用 epoll
     int _epfd;
+    bool _edgeTriggered;
+    std::atomic<uint64_t> _epollCtlCalls{0};
     vector<struct epoll_event> _evtList;
     bool _isLooping;
     Acceptor &_acceptor;
@@ -77,6 +127,15 @@ private:
     TimerManager _timeMgr;
     
     std::thread::id _threadId;  // 记录当前EventLoop运行的线程ID
+
+    std::unordered_map<int, PollState> _polls;
+    uint32_t _nextPollGen = 1;
+    std::unordered_map<int, TcpConnectionPtr> _sendsInFlight;   // 每个连接同时最多一个 sendmsg
+    std::vector<IoUring::Completion> _completions;               // 每轮复用
+    std::vector<int> _pollRetry;                                 // SQ 满时没挂上 poll 的 fd
+    std::vector<uint64_t> _cancelRetry;                          // SQ 满时没能取消的 poll（user_data）
+    static std::atomic_bool _ioUringEnabled;
+    static std::atomic_bool _edgeTriggeredEnabled;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "IoUring.h"
+#include "Logger.h"
+#include <errno.h>
+#include <string.h>
+
+// io_uring_getevents_arg 和 IORING_ENTER_EXT_ARG 是 5.11 的内核头文件才有的，更老的头文件上只编一个总是失败的 init
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_ENTER_EXT_ARG) && !defined(RTSP_NO_IO_URING)
+#define RTSP_HAVE_IO_URING 1
+#endif
+
+IoUring::IoUring() {
+}
+
+#ifdef RTSP_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <signal.h>
+
+// 5.18/5.19 才加的 setup 标志，老内核不认识时 init 会去掉它们重试
+#ifndef IORING_SETUP_SUBMIT_ALL
+#define IORING_SETUP_SUBMIT_ALL (1U << 7)
+#endif
+#ifndef IORING_SETUP_COOP_TASKRUN
+#define IORING_SETUP_COOP_TASKRUN (1U << 8)
+#endif
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+IoUring::~IoUring() {
+    if (_sqes) {
+        munmap(_sqes, _sqesSize);
+    }
+    if (_ring) {
+        munmap(_ring, _ringSize);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+bool IoUring::init(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 内核处理完不必打断用户态，等下一次 io_uring_enter 时一起跑；老内核不认识这些标志时退回默认
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        fd = syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (fd < 0) {
+        LOG_WARN("io_uring_setup failed: %s", strerror(errno));
+        return false;
+    }
+    // 等待超时经 EXT_ARG 传给 io_uring_enter，SQ/CQ 共用一次 mmap
+    unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+    if ((params.features & required) != required) {
+        LOG_WARN("io_uring lacks required features (0x%x)", params.features);
+        close(fd);
+        return false;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    _ringSize = sqSize > cqSize ? sqSize : cqSize;
+    _ring = mmap(nullptr, _ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (_ring == MAP_FAILED) {
+        _ring = nullptr;
+        LOG_WARN("io_uring ring mmap failed: %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+    _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_WARN("io_uring sqe mmap failed: %s", strerror(errno));
+        munmap(_ring, _ringSize);
+        _ring = nullptr;
+        close(fd);
+        return false;
+    }
+    _sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* ring = static_cast<char*>(_ring);
+    _sqHead = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+    _sqTail = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+    _sqArray = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+    _sqMask = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+    _sqEntries = params.sq_entries;
+    _sqeTail = *_sqTail;
+    _cqHead = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+    _cqTail = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+    _cqMask = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+    _fd = fd;
+    LOG_INFO("io_uring created, fd: %d, sq entries: %u, cq entries: %u", fd, params.sq_entries, params.cq_entries);
+    return true;
+}
+
+bool IoUring::supported() {
+    static const bool ok = []() {
+        IoUring probe;
+        return probe.init(4);
+    }();
+    return ok;
+}
+
+unsigned IoUring::pending() const {
+    return _sqeTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+}
+
+struct io_uring_sqe* IoUring::getSqe() {
+    if (pending() >= _sqEntries) {
+        // SQ 满了：只提交不等待，内核取走后再填。CQ 积压到内核不肯再收（EBUSY）时，
+        // 先把完成项收进 _backlog 腾出位置再提交一次
+        __atomic_store_n(_sqTail, _sqeTail, __ATOMIC_RELEASE);
+        if (enter(pending(), 0, 0, nullptr, 0) < 0 && (errno == EBUSY || errno == EAGAIN)) {
+            reap(_backlog);
+            enter(pending(), 0, 0, nullptr, 0);
+        }
+        if (pending() >= _sqEntries) {
+            return nullptr;
+        }
+    }
+    unsigned index = _sqeTail & _sqMask;
+    struct io_uring_sqe* sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    _sqArray[index] = index;
+    ++_sqeTail;
+    return sqe;
+}
+
+bool IoUring::prepPollAdd(int fd, uint32_t events, uint64_t data) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = data;
+    return true;
+}
+
+bool IoUring::prepPollRemove(uint64_t target, uint64_t data) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = data;
+    return true;
+}
+
+bool IoUring::prepSendmsg(int fd, const struct msghdr* msg, unsigned flags, uint64_t data) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = flags;
+    sqe->user_data = data;
+    return true;
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) {
+    return syscall(__NR_io_uring_enter, _fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+bool IoUring::submitAndWait(int timeoutMs, std::vector<Completion>& out) {
+    __atomic_store_n(_sqTail, _sqeTail, __ATOMIC_RELEASE);
+    bool backlog = !_backlog.empty();
+    if (backlog) {
+        out.insert(out.end(), _backlog.begin(), _backlog.end());
+        _backlog.clear();
+    }
+
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = timeoutMs >= 0 ? (uint64_t)(uintptr_t)&ts : 0;
+
+    // 上一轮回调里已经产生的完成项不用再等
+    unsigned minComplete = backlog || __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE) != *_cqHead ? 0 : 1;
+    int ret = enter(pending(), minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        LOG_ERROR("io_uring_enter failed: %s", strerror(errno));
+        reap(out);
+        return false;
+    }
+    reap(out);
+    return true;
+}
+
+void IoUring::reap(std::vector<Completion>& out) {
+    // 先整体拷出再推进 head，回调里提交新的请求时不会和 CQ 交错
+    unsigned head = *_cqHead;
+    unsigned tail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = _cqes[head & _cqMask];
+        out.push_back(Completion{cqe.user_data, cqe.res});
+    }
+    __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+}
+
+#else
+
+IoUring::~IoUring() {
+}
+
+bool IoUring::init(unsigned) {
+    LOG_WARN("built without io_uring support (kernel headers older than 5.11 or NO_IO_URING)");
+    return false;
+}
+
+bool IoUring::supported() {
+    return false;
+}
+
+bool IoUring::prepPollAdd(int, uint32_t, uint64_t) {
+    return false;
+}
+
+bool IoUring::prepPollRemove(uint64_t, uint64_t) {
+    return false;
+}
+
+bool IoUring::prepSendmsg(int, const struct msghdr*, unsigned, uint64_t) {
+    return false;
+}
+
+bool IoUring::submitAndWait(int, std::vector<Completion>&) {
+    return false;
+}
+
+#endif
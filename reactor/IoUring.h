@@ -0,0 +1,72 @@
+#ifndef __IOURING_H__
+#define __IOURING_H__
+
+#include "NonCopyable.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct msghdr;
+
+/*
+最小的 io_uring 封装（不依赖 liburing，直接用系统调用和 mmap 出来的环）。
+只在所属 EventLoop 的线程中使用：prep* 往 SQ 里填一个提交项，
+下一次 submitAndWait 时和等待合成一次 io_uring_enter 一起提交。
+内核头文件早于 5.11（没有 IORING_ENTER_EXT_ARG / io_uring_getevents_arg）或以 NO_IO_URING=1 编译时，
+init 总是返回 false，EventLoop 退回 epoll；本头文件不引用内核头文件，调用方不用区分。
+*/
+class IoUring : NonCopyable {
+public:
+    struct Completion {
+        uint64_t data;      // 提交时给的 user_data
+        int32_t res;        // 结果，出错时为 -errno
+    };
+
+    IoUring();
+    ~IoUring();
+
+    // 创建环，内核不支持（或缺少 EXT_ARG 等所需特性）时返回 false
+    bool init(unsigned entries);
+    bool valid() const { return _fd >= 0; }
+
+    // 填一个提交项；SQ 满时先把已有的提交掉再填，仍然放不下时返回 false，由调用方稍后重试
+    bool prepPollAdd(int fd, uint32_t events, uint64_t data);
+    bool prepPollRemove(uint64_t target, uint64_t data);
+    bool prepSendmsg(int fd, const struct msghdr* msg, unsigned flags, uint64_t data);
+
+    // 提交所有待提交项，并等待至少一个完成或超时（timeoutMs < 0 表示不限时），
+    // 收到的完成项追加到 out。返回 false 表示 io_uring_enter 出错
+    bool submitAndWait(int timeoutMs, std::vector<Completion>& out);
+
+    // 运行时探测，结果缓存
+    static bool supported();
+
+private:
+    struct io_uring_sqe* getSqe();
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize);
+    unsigned pending() const;
+    void reap(std::vector<Completion>& out);
+
+    int _fd = -1;
+    void* _ring = nullptr;
+    size_t _ringSize = 0;
+    struct io_uring_sqe* _sqes = nullptr;
+    size_t _sqesSize = 0;
+
+    unsigned* _sqHead = nullptr;
+    unsigned* _sqTail = nullptr;
+    unsigned* _sqArray = nullptr;
+    unsigned _sqMask = 0;
+    unsigned _sqEntries = 0;
+    unsigned _sqeTail = 0;      // 本地已填好的提交项尾部，提交时才发布给内核
+
+    unsigned* _cqHead = nullptr;
+    unsigned* _cqTail = nullptr;
+    unsigned _cqMask = 0;
+    struct io_uring_cqe* _cqes = nullptr;
+    std::vector<Completion> _backlog;   // SQ 满、CQ 又积压时提前收下的完成项，下一次 submitAndWait 先交出去
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "MultiThreadEventLoop.h"
 #include "../media/RtspConnect.h"
+#include "../media/RtcpSession.h"
 #include <iostream>
 #include <algorithm>
 #include "cpp11_compat.h"
@@ -35,6 +36,15 @@ MultiThreadEventLoop::~MultiThreadEventLoop() {
 void MultiThreadEventLoop::start() {
     LOG_INFO("Starting MultiThreadEventLoop...");
     _running = true;
+
+    // 统计挂在第一个子 loop 上；loop 还没跑起来，runInLoop 会排队到它启动后执行
+    if (!_subLoops.empty()) {
+        EventLoop* statsLoop = _subLoops[0].get();
+        statsLoop->runInLoop([this, statsLoop]() {
+            statsLoop->addPeriodicTimer(kStatsIntervalMs, kStatsIntervalMs,
+                std::bind(&MultiThreadEventLoop::logStats, this));
+        });
+    }
     
     // 启动工作线程
     for (size_t i = 0; i < _threadNum; ++i) {
@@ -103,6 +113,28 @@ void MultiThreadEventLoop::threadFunc() {
     LOG_INFO("Thread %zu EventLoop stopped", index);
 }
 
+void MultiThreadEventLoop::logStats() {
+    uint64_t total = _mainLoop.epollCtlCalls();
+    for (auto& loop : _subLoops) {
+        total += loop->epollCtlCalls();
+    }
+    uint64_t delta = total - _lastEpollCtlCalls;
+    _lastEpollCtlCalls = total;
+    LOG_INFO("Reactor stats: epoll_ctl %.1f/s (%s)", delta * 1000.0 / kStatsIntervalMs,
+             _subLoops[0]->edgeTriggered() ? "edge-triggered" : "level-triggered");
+    // 客户端 RTCP 汇报的接收质量：本统计周期内所有会话的平均 RTT/抖动和最大丢包率
+    RtcpTotals rtcp = RtcpSession::takeTotals();
+    if (rtcp.srSent > 0 || rtcp.rrReceived > 0) {
+        LOG_INFO("RTCP stats: %llu SR sent, %llu reports received, rtt avg %.1f ms, jitter avg %.1f ms, max loss %.1f%%, %llu BYE, "
+                 "%llu NACKed, %llu retransmitted",
+                 (unsigned long long)rtcp.srSent, (unsigned long long)rtcp.rrReceived,
+                 rtcp.rttSamples ? rtcp.rttSumMs / rtcp.rttSamples : 0.0,
+                 rtcp.jitterSamples ? rtcp.jitterSumMs / rtcp.jitterSamples : 0.0,
+                 rtcp.maxLossPercent, (unsigned long long)rtcp.byeReceived,
+                 (unsigned long long)rtcp.nackRequested, (unsigned long long)rtcp.retransmitted);
+    }
+}
+
 void MultiThreadEventLoop::onNewConnection(int connfd) {
     EventLoop* loop = getNextLoop();
     loop->runInLoop([connfd, loop, this]() {
@@ -113,7 +145,9 @@ void MultiThreadEventLoop::onNewConnection(int connfd) {
             std::bind(&MultiThreadEventLoop::onMessage, this, std::placeholders::_1));
         connPtr->setCloseCallback(
             std::bind(&MultiThreadEventLoop::onClose, this, std::placeholders::_1));
-        auto rtspConn = std::make_shared<RtspConnect>(connPtr, std::shared_ptr<EventLoop>(loop));
+        // EventLoop 归 MultiThreadEventLoop 所有，这里只给一个不管理生命周期的 shared_ptr
+        std::shared_ptr<EventLoop> loopRef(std::shared_ptr<EventLoop>(), loop);
+        auto rtspConn = std::make_shared<RtspConnect>(connPtr, loopRef);
         connPtr->setRtspConnect(rtspConn);
         LOG_DEBUG("RTSP connection setup completed for fd: %d", connfd);
     });
@@ -136,5 +170,7 @@ void MultiThreadEventLoop::onClose(const TcpConnectionPtr& connPtr) {
     if (rtspConn) {
         LOG_DEBUG("Releasing RTSP session for: %s", connPtr->toString().c_str());
         rtspConn->releaseSession();
+        // RtspConnect 和 TcpConnection 互相持有，这里断开，连接从 loop 移除后才能析构并关闭 fd
+        connPtr->setRtspConnect(nullptr);
     }
 } 
\ No newline at end of file
@@ -30,6 +30,9 @@ private:
     void onNewConnection(int connfd);
     void onMessage(const TcpConnectionPtr& connPtr);
     void onClose(const TcpConnectionPtr& connPtr);
+    void logStats();    // 在第一个子 loop 的定时器里定期调用
+
+    static const int kStatsIntervalMs = 10000;  // 定时器接口的参数实际是毫秒
 
 private:
     Acceptor _acceptor;
@@ -44,6 +47,8 @@ private:
     
     std::atomic<bool> _running;
 
+    uint64_t _lastEpollCtlCalls = 0;    // 上一次统计时所有 loop 的 epoll_ctl 总次数
+
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "PacketBuffer.h"
+#include <vector>
+#include "Logger.h"
+
+std::atomic<size_t> PacketBuffer::_freeListLimit{4096};
+std::atomic<size_t> PacketBuffer::_allocated{0};
+
+// 每个分配线程一个池。本线程释放的缓冲区放回 local；别的线程释放的压进 returned，
+// 它是只有本线程一个消费者、且总是整条取走的无锁栈，所以没有 ABA 问题。
+// 线程退出后池对象本身留着（只有几十字节），之后才被释放的缓冲区仍能看到 orphaned 并直接 delete
+struct PacketBuffer::Pool {
+    std::vector<PacketBuffer*> local;
+    std::atomic<PacketBuffer*> returned{nullptr};
+    std::atomic<bool> orphaned{false};
+};
+
+thread_local PacketBuffer::PoolHolder PacketBuffer::_localPool;
+
+PacketBuffer::PoolHolder::~PoolHolder() {
+    Pool* p = pool;
+    pool = nullptr;
+    if (p) {
+        orphanPool(p);
+    }
+}
+
+void PacketBuffer::orphanPool(Pool* pool) {
+    // 先标记再清空归还栈：别的线程压栈后会再检查 orphaned，两边至少有一边能把它取走释放
+    pool->orphaned.store(true);
+    for (PacketBuffer* buf : pool->local) {
+        delete buf;
+    }
+    pool->local.clear();
+    pool->local.shrink_to_fit();
+    drainReturned(pool, false);
+}
+
+PacketBuffer::Pool* PacketBuffer::localPool() {
+    if (!_localPool.pool) {
+        _localPool.pool = new Pool();
+        _localPool.pool->local.reserve(256);
+    }
+    return _localPool.pool;
+}
+
+void PacketBuffer::drainReturned(Pool* pool, bool keep) {
+    PacketBuffer* buf = pool->returned.exchange(nullptr);
+    while (buf) {
+        PacketBuffer* next = buf->_nextFree;
+        buf->_nextFree = nullptr;
+        if (keep && pool->local.size() < _freeListLimit) {
+            pool->local.push_back(buf);
+        } else {
+            delete buf;
+        }
+        buf = next;
+    }
+}
+
+PacketPtr PacketBuffer::alloc() {
+    Pool* pool = localPool();
+    if (pool->local.empty() && pool->returned.load(std::memory_order_relaxed)) {
+        drainReturned(pool, true);
+    }
+    PacketBuffer* buf;
+    if (!pool->local.empty()) {
+        buf = pool->local.back();
+        pool->local.pop_back();
+        buf->_begin = buf->_end = kHeadroom;
+    } else {
+        buf = new PacketBuffer(pool);
+        ++_allocated;
+    }
+    return PacketPtr(buf);
+}
+
+uint8_t* PacketBuffer::append(size_t n) {
+    if (n > kCapacity - _end) {
+        LOG_ERROR("PacketBuffer append %zu bytes exceeds capacity, %zu bytes left", n, kCapacity - _end);
+        return nullptr;
+    }
+    uint8_t* p = _buf + _end;
+    _end += n;
+    return p;
+}
+
+uint8_t* PacketBuffer::prepend(size_t n) {
+    if (n > _begin) {
+        LOG_ERROR("PacketBuffer prepend %zu bytes exceeds headroom, %zu bytes left", n, _begin);
+        return nullptr;
+    }
+    _begin -= n;
+    return _buf + _begin;
+}
+
+void PacketBuffer::attachTail(const uint8_t* data, size_t len, const std::shared_ptr<const void>& owner) {
+    _tail = data;
+    _tailSize = len;
+    _tailOwner = owner;
+}
+
+size_t PacketBuffer::fillIovec(struct iovec* iov, size_t offset) const {
+    size_t n = 0;
+    if (offset < size()) {
+        iov[n].iov_base = const_cast<uint8_t*>(data()) + offset;
+        iov[n].iov_len = size() - offset;
+        ++n;
+        offset = 0;
+    } else {
+        offset -= size();
+    }
+    if (offset < _tailSize) {
+        iov[n].iov_base = const_cast<uint8_t*>(_tail) + offset;
+        iov[n].iov_len = _tailSize - offset;
+        ++n;
+    }
+    return n;
+}
+
+void PacketBuffer::release() {
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // 外挂段的所有者不能跟着空闲缓冲区一起留着，否则文件映射迟迟不能释放
+    _tail = nullptr;
+    _tailSize = 0;
+    _tailOwner.reset();
+    if (_pool == _localPool.pool) {
+        recycle(_pool, this);
+    } else {
+        giveBack(_pool, this);
+    }
+}
+
+void PacketBuffer::recycle(Pool* pool, PacketBuffer* buf) {
+    if (pool->local.size() < _freeListLimit) {
+        pool->local.push_back(buf);
+    } else {
+        delete buf;
+    }
+}
+
+void PacketBuffer::giveBack(Pool* pool, PacketBuffer* buf) {
+    PacketBuffer* head = pool->returned.load(std::memory_order_relaxed);
+    do {
+        buf->_nextFree = head;
+    } while (!pool->returned.compare_exchange_weak(head, buf));
+    if (pool->orphaned.load()) {
+        // 分配线程已经退出，没有人会再来取
+        drainReturned(pool, false);
+    }
+}
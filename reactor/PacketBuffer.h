@@ -0,0 +1,117 @@
+#ifndef __PACKETBUFFER_H__
+#define __PACKETBUFFER_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <sys/uio.h>
+#include "NonCopyable.h"
+
+class PacketPtr;
+
+/*
+定长、引用计数的包缓冲区，一个 RTP 包从打包到写入套接字都用同一块内存。
+前面预留 kHeadroom 字节，载荷写好之后再依次往前填 12 字节 RTP 头和 4 字节 interleaved 前缀，不用搬动数据。
+引用计数归零后回到分配它的线程的空闲链表，稳态下每个包不再有堆分配：
+在分配线程释放的直接放回；在别的线程释放的（如 StreamHub 的包在各订阅者线程发完）压进分配线程的无锁归还栈，
+分配线程本地链表用完时整条取回。
+载荷本身就在只读的共享内存里（如 mmap 的媒体文件）时，数据区只放头部，载荷作为外挂段引用，发送时是第二个 iovec。
+*/
+class PacketBuffer : NonCopyable {
+public:
+    static const size_t kCapacity = 2048;           // 足够放下 MTU 大小的包
+    static const size_t kHeadroom = 4 + 12;         // interleaved 前缀 + RTP 头
+
+    // 从当前线程的空闲链表取一块，空时先取回别的线程归还的，仍没有才 new；数据区起点在 headroom 之后，长度为 0
+    static PacketPtr alloc();
+
+    uint8_t* data() { return _buf + _begin; }
+    const uint8_t* data() const { return _buf + _begin; }
+    size_t size() const { return _end - _begin; }
+
+    // 在末尾追加 n 字节，返回可写位置；超出容量时记一条错误日志并返回 nullptr，不改变缓冲区
+    uint8_t* append(size_t n);
+    // 在开头前插 n 字节，返回新的起点；超过剩余 headroom 时同样返回 nullptr
+    uint8_t* prepend(size_t n);
+    // 去掉开头 n 字节
+    void consume(size_t n) { _begin += n; }
+
+    // 在数据区之后挂一段外部只读内存，不拷贝；owner 保证这段内存在包释放前一直有效，每个包最多挂一段
+    void attachTail(const uint8_t* data, size_t len, const std::shared_ptr<const void>& owner);
+    // 整个包（数据区 + 外挂段）的长度
+    size_t totalSize() const { return size() + _tailSize; }
+    // 把第 offset 字节之后的内容填进 iov（最多 2 段），返回段数
+    size_t fillIovec(struct iovec* iov, size_t offset = 0) const;
+    // 第 offset 个字节，外挂段也算在内
+    uint8_t byteAt(size_t offset) const {
+        return offset < size() ? data()[offset] : _tail[offset - size()];
+    }
+
+    // 每个线程的本地空闲链表最多缓存多少块，超出的直接释放
+    static void setFreeListLimit(size_t limit) { _freeListLimit = limit; }
+    // 累计 new 出来的缓冲区个数，用于观察稳态下池是否还在增长
+    static size_t allocatedCount() { return _allocated; }
+
+private:
+    friend class PacketPtr;
+    struct Pool;
+    // 线程退出时把本线程的池标记为废弃并释放其中的空闲缓冲区
+    struct PoolHolder {
+        Pool* pool = nullptr;
+        ~PoolHolder();
+    };
+    explicit PacketBuffer(Pool* pool)
+    : _refs(0), _begin(kHeadroom), _end(kHeadroom), _tail(nullptr), _tailSize(0), _pool(pool), _nextFree(nullptr) {}
+
+    void retain() { _refs.fetch_add(1, std::memory_order_relaxed); }
+    void release();
+
+    static Pool* localPool();
+    static void recycle(Pool* pool, PacketBuffer* buf);
+    static void giveBack(Pool* pool, PacketBuffer* buf);
+    static void drainReturned(Pool* pool, bool keep);
+    static void orphanPool(Pool* pool);
+
+    std::atomic<int> _refs;
+    size_t _begin;
+    size_t _end;
+    const uint8_t* _tail;
+    size_t _tailSize;
+    std::shared_ptr<const void> _tailOwner;
+    Pool* _pool;                // 分配它的线程的池
+    PacketBuffer* _nextFree;    // 在归还栈中时指向下一块
+    uint8_t _buf[kCapacity];
+
+    static thread_local PoolHolder _localPool;
+    static std::atomic<size_t> _freeListLimit;
+    static std::atomic<size_t> _allocated;
+};
+
+// PacketBuffer 的侵入式智能指针，拷贝只加引用计数，可以跨线程传递
+class PacketPtr {
+public:
+    PacketPtr() : _buf(nullptr) {}
+    explicit PacketPtr(PacketBuffer* buf) : _buf(buf) { if (_buf) _buf->retain(); }
+    PacketPtr(const PacketPtr& other) : _buf(other._buf) { if (_buf) _buf->retain(); }
+    PacketPtr(PacketPtr&& other) : _buf(other._buf) { other._buf = nullptr; }
+    ~PacketPtr() { if (_buf) _buf->release(); }
+
+    PacketPtr& operator=(PacketPtr other) {
+        std::swap(_buf, other._buf);
+        return *this;
+    }
+
+    PacketBuffer* get() const { return _buf; }
+    PacketBuffer* operator->() const { return _buf; }
+    PacketBuffer& operator*() const { return *_buf; }
+    explicit operator bool() const { return _buf != nullptr; }
+    void reset() { PacketPtr().swap(*this); }
+    void swap(PacketPtr& other) { std::swap(_buf, other._buf); }
+
+private:
+    PacketBuffer* _buf;
+};
+
+#endif
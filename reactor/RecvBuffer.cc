@@ -0,0 +1,64 @@
+#include "RecvBuffer.h"
+#include <sys/uio.h>
+#include <string.h>
+
+RecvBuffer::RecvBuffer(size_t initialSize)
+: _buf(initialSize) {
+}
+
+void RecvBuffer::retrieve(size_t n) {
+    if (n >= readable()) {
+        _readIdx = 0;
+        _writeIdx = 0;
+    } else {
+        _readIdx += n;
+    }
+}
+
+ssize_t RecvBuffer::readFd(int fd) {
+    char extra[kExtraSize];
+    struct iovec iov[2];
+    size_t writable = _buf.size() - _writeIdx;
+    iov[0].iov_base = &_buf[0] + _writeIdx;
+    iov[0].iov_len = writable;
+    iov[1].iov_base = extra;
+    iov[1].iov_len = sizeof(extra);
+    ssize_t n = ::readv(fd, iov, 2);
+    _lastReadFull = n == (ssize_t)(writable + sizeof(extra));
+    if (n <= 0) {
+        return n;
+    }
+    if ((size_t)n <= writable) {
+        _writeIdx += n;
+    } else {
+        _writeIdx = _buf.size();
+        append(extra, n - writable);
+    }
+    return n;
+}
+
+void RecvBuffer::append(const char* data, size_t len) {
+    makeSpace(len);
+    ::memcpy(&_buf[0] + _writeIdx, data, len);
+    _writeIdx += len;
+}
+
+void RecvBuffer::makeSpace(size_t len) {
+    if (_buf.size() - _writeIdx >= len) {
+        return;
+    }
+    size_t used = readable();
+    if (_readIdx > 0) {
+        // 前面已经取走的空间收回来，未处理的数据搬到开头
+        ::memmove(&_buf[0], &_buf[0] + _readIdx, used);
+        _readIdx = 0;
+        _writeIdx = used;
+    }
+    if (_buf.size() - _writeIdx < len) {
+        size_t size = _buf.size();
+        while (size - _writeIdx < len) {
+            size *= 2;
+        }
+        _buf.resize(size);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __RECVBUFFER_H__
+#define __RECVBUFFER_H__
+
+#include <vector>
+#include <stddef.h>
+#include <sys/types.h>
+#include "NonCopyable.h"
+
+/*
+连接的接收缓冲区：[_readIdx, _writeIdx) 是收到但还没处理的数据。
+readFd 每次只调一次 readv：第一段是缓冲区尾部的空闲空间，第二段是栈上的 64KB 临时区，
+内核一次能给多少就收多少，溢出到临时区的部分再追加进来（此时才扩容）。
+取走数据只移动读下标；写空间不够时先把未处理的数据搬回开头，还不够才扩容，
+所以上层看到的未处理数据总是连续的一段，可以直接在上面找消息边界。
+*/
+class RecvBuffer : NonCopyable {
+public:
+    static const size_t kInitialSize = 2048;
+    static const size_t kExtraSize = 64 * 1024;
+
+    explicit RecvBuffer(size_t initialSize = kInitialSize);
+
+    const char* peek() const { return &_buf[_readIdx]; }
+    size_t readable() const { return _writeIdx - _readIdx; }
+    // 取走开头 n 字节，全部取完时两个下标归零
+    void retrieve(size_t n);
+
+    // 一次 readv 读入，返回值同 readv（0 表示对端关闭），出错时 errno 保留
+    ssize_t readFd(int fd);
+    // 上一次 readFd 是否把两段空间都填满了：填满说明内核里可能还有数据
+    bool lastReadFull() const { return _lastReadFull; }
+
+private:
+    void append(const char* data, size_t len);
+    void makeSpace(size_t len);
+
+    std::vector<char> _buf;
+    size_t _readIdx = 0;
+    size_t _writeIdx = 0;
+    bool _lastReadFull = false;
+};
+
+#endif
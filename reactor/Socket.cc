@@ -18,7 +18,9 @@ Socket::Socket(int fd)
 
 }
 Socket::~Socket(){
-
+    if(_fd >= 0){
+        ::close(_fd);
+    }
 }
 int Socket::fd() const{
     return _fd;
@@ -2,12 +2,31 @@
 #include <iostream>
 #include <sstream>
 #include <string.h>
+#include <algorithm>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 #include "Logger.h"
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
 using std::cout;
 using std::endl;
 using std::ostringstream;
 
+std::atomic_bool TcpConnection::_zeroCopyEnabled{false};
+
 
 TcpConnection::TcpConnection(int fd,EventLoop *loop)
 :_loop(loop)
@@ -15,6 +34,14 @@ TcpConnection::TcpConnection(int fd,EventLoop *loop)
 ,_sock(fd)
 ,_localAddr(getLocalAddr())
 ,_peerAddr(getPeerAddr()){
+    if (_zeroCopyEnabled) {
+        int one = 1;
+        if (::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+            _zeroCopy = true;
+        } else {
+            LOG_WARN("SO_ZEROCOPY not supported on fd %d: %s", fd, strerror(errno));
+        }
+    }
 
     LOG_INFO("TcpConnection created - fd: %d, local: %s, peer: %s", 
              fd, _localAddr.toString().c_str(), _peerAddr.toString().c_str());
@@ -25,27 +52,253 @@ TcpConnection::~TcpConnection(){
 }
 
 void TcpConnection::send(const string &msg){
-    if (_sendBuffer.empty() && !_isWriting) {
-        int written = _sockIO.writen(msg.c_str(), msg.size());
-        if (written < (int)msg.size()) {
-            // 没写完，缓存剩余部分
-            _sendBuffer = msg.substr(written);
-            _isWriting = true;
-            _loop->addEpollWriteFd(getFd());
-            // LOG_DEBUG("Partial write for fd %d: %d/%zu bytes, buffering remaining", 
-            //          getFd(), written, msg.size());
-        } else {
-            // LOG_DEBUG("Complete write for fd %d: %zu bytes", getFd(), msg.size());
+    send(msg.data(), msg.size());
+}
+
+void TcpConnection::send(const char *data, size_t len){
+    // 字符串（RTSP 应答等）拷进池里的缓冲区，和 RTP 包走同一条发送链，保证先后顺序
+    const size_t chunk = PacketBuffer::kCapacity - PacketBuffer::kHeadroom;
+    while (len > 0) {
+        size_t n = std::min(len, chunk);
+        PacketPtr packet = PacketBuffer::alloc();
+        ::memcpy(packet->append(n), data, n);
+        enqueue(packet);
+        data += n;
+        len -= n;
+    }
+    startSend();
+}
+
+void TcpConnection::send(const PacketPtr &packet){
+    enqueue(packet);
+    startSend();
+}
+
+void TcpConnection::sendBatch(const std::vector<PacketPtr> &packets){
+    for (const PacketPtr &packet : packets) {
+        enqueue(packet);
+    }
+    startSend();
+}
+
+void TcpConnection::startSend(){
+    // 已经在等写事件说明内核缓冲区满着，只排队，等 EPOLLOUT 再写
+    if (_isWriting) {
+        return;
+    }
+    if (_loop->usingIoUring()) {
+        submitSendChain();
+        return;
+    }
+    if (!flushSendChain()) {
+        // 出错时交给写事件回调统一处理关闭
+        _isWriting = true;
+        _loop->addEpollWriteFd(getFd());
+        return;
+    }
+    updateWriteEvent();
+}
+
+void TcpConnection::enqueue(const PacketPtr &packet){
+    if (packet->totalSize() == 0) {
+        return;
+    }
+    _sendChain.push_back(SendSlice{packet, 0});
+    _sendBytes += packet->totalSize();
+}
+
+size_t TcpConnection::fillSendIov(struct iovec *iov, size_t &total) const{
+    // 带外挂段的节点占两个 iovec
+    size_t n = 0;
+    total = 0;
+    for (size_t i = _sendHead; i < _sendChain.size() && n + 2 <= kMaxSendIov; ++i) {
+        const SendSlice &slice = _sendChain[i];
+        size_t added = slice.packet->fillIovec(iov + n, slice.offset);
+        for (size_t k = n; k < n + added; ++k) {
+            total += iov[k].iov_len;
         }
-    } else {
-        // 缓冲区有数据，直接追加
-        _sendBuffer += msg;
-        if (!_isWriting) {
-            _isWriting = true;
-            _loop->addEpollWriteFd(getFd());
+        n += added;
+    }
+    return n;
+}
+
+bool TcpConnection::flushSendChain(){
+    struct iovec iov[kMaxSendIov];
+    while (_sendHead < _sendChain.size()) {
+        size_t total = 0;
+        size_t n = fillSendIov(iov, total);
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        bool zeroCopy = _zeroCopy && total >= kZeroCopyMinBytes;
+        ssize_t ret = ::sendmsg(getFd(), &msg, MSG_NOSIGNAL | (zeroCopy ? MSG_ZEROCOPY : 0));
+        if (ret < 0 && zeroCopy && errno == ENOBUFS) {
+            // 钉住的页面超过了 optmem 限制，这一次退回普通拷贝
+            zeroCopy = false;
+            ret = ::sendmsg(getFd(), &msg, MSG_NOSIGNAL);
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
+            return false;
+        }
+        consumeSent(ret, zeroCopy);
+        if ((size_t)ret < total) {
+            break;  // 内核发送缓冲区满了
+        }
+    }
+    compactSendChain();
+    return true;
+}
+
+void TcpConnection::consumeSent(size_t bytes, bool zeroCopy){
+    // 写完的节点出队（释放引用），写了一部分的节点只移动 offset；零拷贝时内核还在引用，先钉住
+    size_t left = bytes;
+    size_t touched = 0;
+    _sendBytes -= left;
+    while (left > 0) {
+        SendSlice &slice = _sendChain[_sendHead];
+        size_t remain = slice.packet->totalSize() - slice.offset;
+        if (zeroCopy) {
+            _zcPinned.push_back(slice.packet);
+            ++touched;
+        }
+        if (left < remain) {
+            slice.offset += left;
+            break;
+        }
+        left -= remain;
+        slice.packet.reset();
+        ++_sendHead;
+    }
+    if (zeroCopy) {
+        pinZeroCopy(touched);
+    }
+}
+
+void TcpConnection::compactSendChain(){
+    if (_sendHead == _sendChain.size()) {
+        _sendChain.clear();
+        _sendHead = 0;
+    } else if (_sendHead >= 256 && _sendHead * 2 >= _sendChain.size()) {
+        // 慢速客户端长期积压时，已写出的前半段不再占着队列
+        _sendChain.erase(_sendChain.begin(), _sendChain.begin() + _sendHead);
+        _sendHead = 0;
+    }
+}
+
+void TcpConnection::submitSendChain(){
+    if (_sendInFlight || _sendHead == _sendChain.size()) {
+        return;
+    }
+    size_t total = 0;
+    size_t n = fillSendIov(_uringIov, total);
+    ::memset(&_uringMsg, 0, sizeof(_uringMsg));
+    _uringMsg.msg_iov = _uringIov;
+    _uringMsg.msg_iovlen = n;
+    if (!_loop->submitSend(shared_from_this(), &_uringMsg)) {
+        // SQ 满了，等可写时再提交
+        _isWriting = true;
+        _loop->addEpollWriteFd(getFd());
+        return;
+    }
+    _sendInFlight = true;
+}
+
+void TcpConnection::handleSendComplete(int res){
+    _sendInFlight = false;
+    if (res == -EAGAIN || res == -EWOULDBLOCK) {
+        // 非阻塞套接字的发送缓冲区满时 io_uring 直接返回 EAGAIN，挂上写关注，可写时再提交
+        _isWriting = true;
+        _loop->addEpollWriteFd(getFd());
+        return;
+    }
+    if (res == -EINTR) {
+        submitSendChain();
+        return;
+    }
+    if (res < 0) {
+        LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(-res));
+        handleCloseCallback();
+        return;
+    }
+    consumeSent(res, false);
+    compactSendChain();
+    submitSendChain();
+}
+
+void TcpConnection::pinZeroCopy(size_t count){
+    _zcCalls.push_back(ZeroCopyCall{_zcNextId++, count});
+}
+
+void TcpConnection::releaseZeroCopy(uint32_t lastId){
+    // 通知可能合并多次调用，编号按 32 位回绕比较
+    while (_zcCallHead < _zcCalls.size() && (int32_t)(_zcCalls[_zcCallHead].id - lastId) <= 0) {
+        size_t count = _zcCalls[_zcCallHead].count;
+        for (size_t i = 0; i < count; ++i) {
+            _zcPinned[_zcPinnedHead++].reset();
+        }
+        ++_zcCallHead;
+    }
+    if (_zcCallHead == _zcCalls.size()) {
+        _zcCalls.clear();
+        _zcCallHead = 0;
+        _zcPinned.clear();
+        _zcPinnedHead = 0;
+    } else if (_zcCallHead >= 256 && _zcCallHead * 2 >= _zcCalls.size()) {
+        _zcCalls.erase(_zcCalls.begin(), _zcCalls.begin() + _zcCallHead);
+        _zcCallHead = 0;
+        _zcPinned.erase(_zcPinned.begin(), _zcPinned.begin() + _zcPinnedHead);
+        _zcPinnedHead = 0;
+    }
+}
+
+void TcpConnection::handleErrorQueue(){
+    if (!_zeroCopy && _zcCallHead == _zcCalls.size()) {
+        return;
+    }
+    for (;;) {
+        char control[128];
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(getFd(), &msg, MSG_ERRQUEUE) < 0) {
+            break;  // EAGAIN：错误队列已收空
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                  || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            const struct sock_extended_err *err = (const struct sock_extended_err *)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if ((err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && _zeroCopy) {
+                // 内核最终还是拷贝了（loopback、网卡不支持 SG 等），继续零拷贝只会多出钉页和通知的开销
+                _zeroCopy = false;
+                LOG_INFO("Kernel copied MSG_ZEROCOPY data on fd %d, falling back to normal sends", getFd());
+            }
+            releaseZeroCopy(err->ee_data);
         }
-        LOG_DEBUG("Appended to send buffer for fd %d: %zu bytes, total buffered: %zu", 
-                 getFd(), msg.size(), _sendBuffer.size());
+    }
+}
+
+void TcpConnection::updateWriteEvent(){
+    if (_sendBytes > 0 && !_isWriting) {
+        _isWriting = true;
+        _loop->addEpollWriteFd(getFd());
+        LOG_DEBUG("Send chain pending for fd %d: %zu bytes buffered", getFd(), _sendBytes);
+    } else if (_sendBytes == 0 && _isWriting) {
+        _isWriting = false;
+        _loop->delEpollWriteFd(getFd());
     }
 }
 
@@ -68,36 +321,70 @@ string TcpConnection::recive(){
     return string(buff);
 }
 
-string TcpConnection::reciveRtspRequest(){
-    char temp[4096];
-    int n = ::recv(_sock.fd(), temp, sizeof(temp), 0);
-    if (n < 0) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // 非阻塞下无数据可读，直接返回空
-            return "";
-        } else {
-            // 其他错误
-            // perror("recv");
+ssize_t TcpConnection::readInput(bool hangup){
+    ssize_t total = 0;
+    for (;;) {
+        ssize_t n = _recvBuffer.readFd(getFd());
+        if (n > 0) {
+            total += n;
+            // 两段空间都读满了说明内核里可能还有数据，对端关闭写端时 EOF 排在数据后面：
+            // 边沿触发下不会再有通知，要接着读；水平触发下留给下一轮
+            if (_loop->edgeTriggered() && (_recvBuffer.lastReadFull() || hangup)) {
+                continue;
+            }
+            break;
+        }
+        if (n == 0) {
+            LOG_DEBUG("Connection closed by peer on fd %d", getFd());
+            _peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
             LOG_ERROR("Error reading from fd %d: %s", getFd(), strerror(errno));
-            return "";
+            _peerClosed = true;
         }
-    } else if (n == 0) {
-        LOG_DEBUG("Connection closed by peer on fd %d", getFd());
-        // 对端关闭
-        return "";
+        break;
     }
-    LOG_DEBUG("Received RTSP request from fd %d: %d bytes", getFd(), n);
-    _recvBuffer.append(temp, n);//每次从 socket 读取数据，append 到 _recvBuffer。
+    if (total > 0) {
+        LOG_DEBUG("Received %zd bytes from fd %d, %zu buffered", total, getFd(), _recvBuffer.readable());
+    }
+    return total;
+}
 
-    // 查找所有完整的 RTSP 请求
-    size_t pos = _recvBuffer.find("\r\n\r\n");//循环查找消息分隔符（RTSP 协议用 \r\n\r\n 作为 header 结束标志）。
-    if (pos != std::string::npos) {
-        std::string oneRequest = _recvBuffer.substr(0, pos + 4);
-        _recvBuffer.erase(0, pos + 4);
-        return oneRequest;//每找到一个分隔符，就说明有一条完整的 RTSP 消息，把它从 _recvBuffer 里取出来，交给上层处理。
-        //剩下的数据（可能是不完整的下一条消息），继续留在 _recvBuffer，等待下次数据到来再拼接。
+bool TcpConnection::demuxInterleaved(const InterleavedCallback &cb){
+    for (;;) {
+        const char *p = _recvBuffer.peek();
+        size_t len = _recvBuffer.readable();
+        size_t skip = 0;
+        while (skip < len && (p[skip] == '\r' || p[skip] == '\n')) {
+            ++skip;
+        }
+        if (skip > 0) {
+            _recvBuffer.retrieve(skip);
+            p += skip;
+            len -= skip;
+        }
+        if (len == 0) {
+            return false;
+        }
+        if (p[0] != '$') {
+            return true;
+        }
+        if (len < 4) {
+            return false;
+        }
+        size_t frameLen = ((uint8_t)p[2] << 8) | (uint8_t)p[3];
+        if (len < 4 + frameLen) {
+            return false;   // 最长 64KB，等剩下的部分
+        }
+        if (cb) {
+            cb((uint8_t)p[1], reinterpret_cast<const uint8_t *>(p + 4), frameLen);
+        }
+        _recvBuffer.retrieve(4 + frameLen);
     }
-    return "";
 }
 
 string TcpConnection::toString(){
@@ -134,13 +421,6 @@ InetAddress TcpConnection::getPeerAddr(){
     return InetAddress(addr);
 }
 
-bool TcpConnection::isClosed() const{
-    char buf[10]={0};
-    int ret = ::recv(_sock.fd(),buf,sizeof(buf),MSG_PEEK);
-    
-    return (0 == ret);
-}
-
 void TcpConnection::setRtspConnect(std::shared_ptr<RtspConnect> conn) { 
     _rtspConn = conn; 
     LOG_DEBUG("RTSP connection set for fd %d", getFd());
@@ -202,25 +482,17 @@ void TcpConnection::removeTimer(TimerId timerId){
 }
 
 void TcpConnection::handleWriteCallback() {
-    if (_sendBuffer.empty()) {
+    if (_loop->usingIoUring()) {
         _isWriting = false;
         _loop->delEpollWriteFd(getFd());
-        LOG_DEBUG("Write buffer empty for fd %d, removed write event", getFd());
+        submitSendChain();
         return;
     }
-    int written = _sockIO.writen(_sendBuffer.c_str(), _sendBuffer.size());
-    if (written < 0) {
+    if (!flushSendChain()) {
         // 错误，关闭连接
-        LOG_ERROR("Write error for fd %d: %s", getFd(), strerror(errno));
         handleCloseCallback();
         return;
     }
-    _sendBuffer.erase(0, written);
-    LOG_DEBUG("Wrote %d bytes from buffer for fd %d, remaining: %zu", 
-             written, getFd(), _sendBuffer.size());
-    if (_sendBuffer.empty()) {
-        _isWriting = false;
-        _loop->delEpollWriteFd(getFd());
-        LOG_DEBUG("Write buffer completely sent for fd %d, removed write event", getFd());
-    }
-}
\ No newline at end of file
+    LOG_DEBUG("Flushed send chain for fd %d, remaining: %zu", getFd(), _sendBytes);
+    updateWriteEvent();
+}
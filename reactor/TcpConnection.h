@@ -5,9 +5,15 @@
 #include "SocketIO.h"
 #include "InetAddress.h"
 #include "EventLoop.h"
+#include "PacketBuffer.h"
+#include "RecvBuffer.h"
+#include <atomic>
 #include <memory>
 #include <functional>
 #include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
 using std::shared_ptr;
 using std::function;
 
@@ -17,16 +23,45 @@ class TcpConnection
 :public std::enable_shared_from_this<TcpConnection>{
     using TcpConnectionPtr = shared_ptr<TcpConnection>;
     using TcpConnectionCallback = function<void(const TcpConnectionPtr &)>;
+    using InterleavedCallback = function<void(uint8_t channel, const uint8_t *data, size_t len)>;
 public:
     explicit TcpConnection(int fd,EventLoop *loop);
     ~TcpConnection();
     void send(const string &msg);
+    void send(const char *data, size_t len);
+    // 只持有 packet 的引用挂到发送链上，不拷贝；调用方之后不能再修改它
+    void send(const PacketPtr &packet);
+    // 整批挂到发送链上，用一次 sendmsg（scatter-gather）写出
+    void sendBatch(const std::vector<PacketPtr> &packets);
     void sendInLoop(const string &msg);
+
+    // 发送链里还没写进内核的字节数；超过高水位说明对端消费跟不上，回落到低水位以下说明已经追上
+    size_t bufferedBytes() const { return _sendBytes; }
+    void setWaterMarks(size_t high, size_t low) { _highWaterMark = high; _lowWaterMark = low; }
+    size_t highWaterMark() const { return _highWaterMark; }
+    size_t lowWaterMark() const { return _lowWaterMark; }
+    bool aboveHighWaterMark() const { return _sendBytes >= _highWaterMark; }
+    bool belowLowWaterMark() const { return _sendBytes <= _lowWaterMark; }
     string recive();
-    string reciveRtspRequest();//接收Rtsp请求
+    // 可读时由 EventLoop 调用：一次 readv 读进接收缓冲区，返回读到的字节数；读到 EOF 或出错时置 peerClosed。
+    // hangup 表示事件里带了 RDHUP/HUP，对端已经关闭写端
+    ssize_t readInput(bool hangup = false);
+    // 接收缓冲区里还没处理的数据，上层直接在上面解析，处理完一条消息后用 retrieveInput 取走
+    const char *inputData() const { return _recvBuffer.peek(); }
+    size_t inputBytes() const { return _recvBuffer.readable(); }
+    void retrieveInput(size_t n) { _recvBuffer.retrieve(n); }
+    /*
+    RTP over TCP 时客户端在同一连接上夹着发来 '$' + 通道号 + 2 字节长度 的二进制帧（多为 RTCP 接收报告）。
+    在消息边界上调用：把接收缓冲区开头完整的二进制帧依次交给 cb（指针指向缓冲区，不拷贝，回调返回后即失效）
+    并取走，顺带丢掉消息之间多余的 CRLF。返回 true 表示开头是 RTSP 文本，false 表示缓冲区空了或帧还没收齐
+    */
+    bool demuxInterleaved(const InterleavedCallback &cb);
+    // 上层发现无法分帧（请求超长、格式错误）时调用，EventLoop 在这次读回调之后关闭连接
+    void closeAfterRead() { _peerClosed = true; }
     string toString();
-    bool isClosed() const;
+    bool peerClosed() const { return _peerClosed; }     // 读到了 EOF、读出错或上层要求关闭，连接应当关闭
     int getFd() const { return _sock.fd(); }  // 新增：获取文件描述符
+    EventLoop* getLoop() const { return _loop; }
 
 
     //回调函数注册
@@ -50,6 +85,13 @@ public:
     void removeTimer(TimerId timerId);
 
     void handleWriteCallback(); // 写事件回调
+    void handleErrorQueue();    // EPOLLERR：收割 MSG_ZEROCOPY 的完成通知
+    void handleSendComplete(int res);   // io_uring 后端：提交的 sendmsg 完成，res 为写出的字节数或 -errno
+
+    // 高码率流可以打开 MSG_ZEROCOPY：一次写出足够多的字节时内核直接引用池里的缓冲区，不再拷贝，
+    // 缓冲区一直被持有到完成通知被收割。默认关闭，只影响之后新建的连接；内核回报改成了拷贝（如 loopback）时自动关掉
+    static void setZeroCopyEnabled(bool enabled) { _zeroCopyEnabled = enabled; }
+    bool zeroCopy() const { return _zeroCopy; }
     
 private:
     EventLoop *_loop;
@@ -63,10 +105,65 @@ private:
     如果你只处理本次 recv 的内容，就会丢失消息边界，导致解析出错。
     持久化 buffer就是把每次 recv 到的数据都 append 到一个成员变量（如 _recvBuffer）里，只要没处理完的数据都留着，直到拼出完整的消息。
     */
-    std::string _recvBuffer;//持久化buffer
-    std::string _sendBuffer; // 发送缓冲区
+    RecvBuffer _recvBuffer;//持久化buffer
+    bool _peerClosed = false;
+
+    /*
+    发送链：每个节点引用一块 PacketBuffer，offset 记录部分写出后的起点。
+    写的时候把链上的节点组成 iovec 一次 sendmsg，部分写只移动 offset，不搬数据；
+    RTP 包（包括 StreamHub 里多个订阅者共享的包）直接挂到链上，不拼接也不拷贝。
+    用 vector + 头下标做队列，clear 后保留容量，稳态下入队出队都不分配。
+    */
+    struct SendSlice {
+        PacketPtr packet;
+        size_t offset;
+    };
+    void enqueue(const PacketPtr &packet);
+    void startSend();           // 入队后尝试立即写出
+    bool flushSendChain();      // 尽量写出发送链，出错返回 false
+    size_t fillSendIov(struct iovec *iov, size_t &total) const;  // 从链头取节点填 iovec，最多 kMaxSendIov 个
+    void consumeSent(size_t bytes, bool zeroCopy);  // 已写出的字节出队
+    void compactSendChain();
+    void updateWriteEvent();    // 按发送链是否为空开关写事件
+    void submitSendChain();     // io_uring 后端：没有在途的 sendmsg 时提交一个
+
+    // 内核发送缓冲区本身还能再兜住几百 KB 到数 MB，应用层积压 1MB 时对端已经明显落后
+    static const size_t kDefaultHighWaterMark = 1024 * 1024;
+    static const size_t kDefaultLowWaterMark = 256 * 1024;
+    static const size_t kMaxSendIov = 64;
+    std::vector<SendSlice> _sendChain;
+    size_t _sendHead = 0;       // 链上第一个未写完的节点
+    size_t _sendBytes = 0;      // 链上未写出的总字节数
+    size_t _highWaterMark = kDefaultHighWaterMark;
+    size_t _lowWaterMark = kDefaultLowWaterMark;
     bool _isWriting = false; // 是否正在监听写事件
 
+    // io_uring 后端：同一时刻最多一个在途的 sendmsg，iovec 指向链上的缓冲区，完成后才出队
+    bool _sendInFlight = false;
+    struct iovec _uringIov[kMaxSendIov];
+    struct msghdr _uringMsg;
+
+    /*
+    MSG_ZEROCOPY：内核按调用次数给每次零拷贝 sendmsg 编号（从 0 开始），完成通知给出已完成的编号区间。
+    每次调用写出的缓冲区按顺序挂在 _zcPinned 上，_zcCalls 记录每次调用的编号和挂了几块，
+    收到通知后按顺序释放。小于 kZeroCopyMinBytes 的写出走普通拷贝，页面钉住和通知的开销比拷贝还大。
+    */
+    struct ZeroCopyCall {
+        uint32_t id;
+        size_t count;
+    };
+    void pinZeroCopy(size_t count);
+    void releaseZeroCopy(uint32_t lastId);
+
+    static const size_t kZeroCopyMinBytes = 16 * 1024;
+    bool _zeroCopy = false;
+    uint32_t _zcNextId = 0;
+    std::vector<PacketPtr> _zcPinned;
+    size_t _zcPinnedHead = 0;
+    std::vector<ZeroCopyCall> _zcCalls;
+    size_t _zcCallHead = 0;
+    static std::atomic_bool _zeroCopyEnabled;
+
     std::shared_ptr<RtspConnect> _rtspConn;
     TcpConnectionCallback _onNewConnectionCb;
     TcpConnectionCallback _onMessageCb;
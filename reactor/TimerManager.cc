@@ -1,11 +1,34 @@
 #include "TimerManager.h"
 #include <sys/time.h>
 #include <string.h>
+#include <algorithm>
 #include <iostream>
 #include "Logger.h"
 
-TimerManager::TimerManager()
-:_timerfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)){
+namespace {
+// 在 nbits 位（2 的幂）的环形位图中，从 start 开始找第一个置位，返回相对 start 的偏移，没有则返回 -1
+int findNextSet(const uint64_t *words, int nbits, int start) {
+    int idx = start;
+    for (int scanned = 0; scanned < nbits;) {
+        int bit = idx & 63;
+        uint64_t bits = words[idx >> 6] >> bit;
+        if (bits) {
+            return scanned + __builtin_ctzll(bits);
+        }
+        int step = 64 - bit;
+        scanned += step;
+        idx = (idx + step) & (nbits - 1);
+    }
+    return -1;
+}
+}  // namespace
+
+TimerManager::TimerManager(bool useTimerfd)
+:_timerfd(useTimerfd ? timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC) : -1)
+,_currentMs(getNowMs()){
+    memset(_wheel, 0, sizeof(_wheel));
+    memset(_level0Bitmap, 0, sizeof(_level0Bitmap));
+    memset(_levelBitmap, 0, sizeof(_levelBitmap));
     LOG_DEBUG("TimeManager created with fd: %d", _timerfd);
 }
 
@@ -30,18 +53,35 @@ uint64_t TimerManager::getNowMs() const {
 TimerManager::TimerId TimerManager::addTimer(int delaySec, TimerCallback &&cb) {
     LOG_DEBUG("Add once timer event");
     uint64_t expireTime = getNowMs() + delaySec;//计算到期执行时间单位毫秒
-    TimerId timerId = _nextId++;
-    _timers.emplace(timerId, std::make_pair(expireTime, Timer{0, std::move(cb)}));//添加到执行表，执行时间和回调函数
-    resetTimerfd();
-    return timerId;
+    return addTimerInternal(expireTime, 0, std::move(cb));
 }
 
 TimerManager::TimerId TimerManager::addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb) {
     uint64_t expireTime = getNowMs() + delaySec;
+    TimerId timerId = addTimerInternal(expireTime, intervalSec, std::move(cb));
+    LOG_DEBUG("Add periodic timer event timerId: %llu", (unsigned long long)timerId);
+    return timerId;
+}
+
+TimerManager::TimerId TimerManager::addTimerInternal(uint64_t expireTime, int interval, TimerCallback &&cb) {
+    if (_timers.empty()) {
+        // 轮上没有定时器时 _currentMs 可能停留在很久以前，先对齐到当前时间，避免挂到过高的层
+        uint64_t now = getNowMs();
+        if (now > _currentMs) _currentMs = now;
+    }
     TimerId timerId = _nextId++;
-    _timers.emplace(timerId, std::make_pair(expireTime, Timer{intervalSec, std::move(cb)}));
-    LOG_DEBUG("Add periodic timer event timerId: %d",timerId);
-    resetTimerfd();
+    std::unique_ptr<Timer> timer(new Timer);
+    timer->id = timerId;
+    timer->expire = expireTime;
+    timer->interval = interval;
+    timer->callback = std::move(cb);
+    place(timer.get());
+    _timers.emplace(timerId, std::move(timer));
+    // 只有比当前设置更早时才需要重设 timerfd；挂在高层的定时器晚于级联点唤醒也没关系，
+    // handleRead 会先补做所有不晚于当前时间的级联再执行到期回调
+    if (_armedMs == 0 || expireTime < _armedMs) {
+        armTimerfd(expireTime);
+    }
     return timerId;
 }
 
@@ -49,52 +89,198 @@ void TimerManager::removeTimer(TimerId timerId) {
     LOG_DEBUG("Remove timer");
     auto it = _timers.find(timerId);
     if (it != _timers.end()) {
+        unlink(it->second.get());
         _timers.erase(it);
-        resetTimerfd();  // 删除后重置 timerfd
+        // 不重设 timerfd：多一次空唤醒的代价远小于每次删除都调用 timerfd_settime
+    }
+}
+
+void TimerManager::place(Timer *timer) {
+    uint64_t expire = timer->expire;
+    if (expire <= _currentMs) {
+        expire = _currentMs + 1;  // 已过期的放到下一个 tick 执行
+    }
+    uint64_t diff = expire - _currentMs;
+    int slot;
+    if (diff < static_cast<uint64_t>(kLevel0Slots)) {
+        slot = expire & (kLevel0Slots - 1);
+        _level0Bitmap[slot >> 6] |= 1ULL << (slot & 63);
+    } else {
+        int level = 1;
+        while (level < kLevels - 1 && diff >= (1ULL << (levelShift(level) + kLevelBits))) {
+            ++level;
+        }
+        int shift = levelShift(level);
+        if (diff >= (1ULL << (shift + kLevelBits))) {
+            // 超出整个时间轮的跨度，先挂在最高层最远的位置，级联时再按真实到期时间放置
+            expire = _currentMs + (1ULL << (shift + kLevelBits)) - 1;
+        }
+        int index = (expire >> shift) & (kLevelSlots - 1);
+        _levelBitmap[level] |= 1ULL << index;
+        slot = slotBase(level) + index;
+    }
+
+    timer->slot = slot;
+    timer->prev = nullptr;
+    timer->next = _wheel[slot];
+    if (_wheel[slot]) _wheel[slot]->prev = timer;
+    _wheel[slot] = timer;
+}
+
+void TimerManager::unlink(Timer *timer) {
+    int slot = timer->slot;
+    if (slot < 0) return;
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        _wheel[slot] = timer->next;
+    }
+    if (timer->next) timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+    timer->slot = -1;
+
+    if (!_wheel[slot]) {
+        if (slot < kLevel0Slots) {
+            _level0Bitmap[slot >> 6] &= ~(1ULL << (slot & 63));
+        } else {
+            int level = 1 + (slot - kLevel0Slots) / kLevelSlots;
+            _levelBitmap[level] &= ~(1ULL << ((slot - kLevel0Slots) % kLevelSlots));
+        }
+    }
+}
+
+void TimerManager::cascade(int level, int index) {
+    int slot = slotBase(level) + index;
+    Timer *timer = _wheel[slot];
+    _wheel[slot] = nullptr;
+    _levelBitmap[level] &= ~(1ULL << index);
+    while (timer) {
+        Timer *next = timer->next;
+        place(timer);
+        timer = next;
     }
 }
 
+void TimerManager::runTick(uint64_t tick, uint64_t now) {
+    _currentMs = tick;
+    for (int level = kLevels - 1; level >= 1; --level) {
+        int shift = levelShift(level);
+        if ((tick & ((1ULL << shift) - 1)) == 0) {
+            cascade(level, (tick >> shift) & (kLevelSlots - 1));
+        }
+    }
+
+    int slot = tick & (kLevel0Slots - 1);
+    _expired.clear();
+    for (Timer *timer = _wheel[slot]; timer;) {
+        Timer *next = timer->next;
+        timer->prev = timer->next = nullptr;
+        timer->slot = -1;
+        _expired.push_back(timer->id);
+        timer = next;
+    }
+    _wheel[slot] = nullptr;
+    _level0Bitmap[slot >> 6] &= ~(1ULL << (slot & 63));
+
+    // 回调里可能增删任意定时器（包括自己），所以每次都按 id 重新查找
+    for (TimerId timerId : _expired) {
+        auto it = _timers.find(timerId);
+        if (it == _timers.end()) continue;
+        TimerCallback cb;
+        cb.swap(it->second->callback);  // 回调执行期间删除自己也不会销毁正在运行的 function
+        if (cb) cb();
+
+        it = _timers.find(timerId);
+        if (it == _timers.end()) continue;
+        Timer *timer = it->second.get();
+        if (timer->interval > 0) {
+            timer->callback.swap(cb);
+            timer->expire = now + timer->interval;
+            place(timer);
+        } else {
+            _timers.erase(it);
+        }
+    }
+}
+
+uint64_t TimerManager::nextEventMs() const {
+    uint64_t next = 0;
+    int offset = findNextSet(_level0Bitmap, kLevel0Slots, (_currentMs + 1) & (kLevel0Slots - 1));
+    if (offset >= 0) {
+        next = _currentMs + 1 + offset;
+    }
+    for (int level = 1; level < kLevels; ++level) {
+        if (!_levelBitmap[level]) continue;
+        int shift = levelShift(level);
+        uint64_t block = _currentMs >> shift;
+        offset = findNextSet(&_levelBitmap[level], kLevelSlots, (block + 1) & (kLevelSlots - 1));
+        uint64_t cascadeAt = (block + 1 + offset) << shift;
+        if (next == 0 || cascadeAt < next) next = cascadeAt;
+    }
+    return next;
+}
+
 void TimerManager::handleRead() {
     uint64_t expirations;
     ssize_t ret = ::read(_timerfd, &expirations, sizeof(expirations));  // 清除触发状态
     (void)ret; // 忽略返回值
+    _armedMs = 0;
+    handleExpired();
+}
 
+int TimerManager::timeoutMs(int maxMs) const {
+    if (_armedMs == 0) {
+        return maxMs;
+    }
     uint64_t now = getNowMs();
-
-    std::vector<std::pair<TimerId, Timer>> expired;
-
-    for (auto it = _timers.begin(); it != _timers.end() && it->second.first <= now;) {
-        expired.push_back({it->first, it->second.second});
-        it = _timers.erase(it);
+    if (_armedMs <= now) {
+        return 0;
     }
+    return (int)std::min<uint64_t>(_armedMs - now, maxMs);
+}
 
-    for (auto& pair : expired) {
-        auto& timerId = pair.first;
-        auto& timer = pair.second;
-
-        if (timer.callback) timer.callback();
-        if (timer.interval > 0) {
-            _timers.emplace(timerId, std::make_pair(now + timer.interval, timer));
+void TimerManager::handleExpired() {
+    uint64_t now = getNowMs();
+    if (_timerfd < 0) {
+        if (_armedMs == 0 || _armedMs > now) {
+            return;
         }
+        _armedMs = 0;
+    }
+
+    // 只在有到期或级联的时间点推进，中间的空槽直接跳过
+    for (uint64_t tick = nextEventMs(); tick != 0 && tick <= now; tick = nextEventMs()) {
+        runTick(tick, now);
     }
+    if (now > _currentMs) _currentMs = now;
 
     resetTimerfd();
 }
 
-
 void TimerManager::resetTimerfd() {
-    if (_timers.empty()) {
-        itimerspec spec{};
-        timerfd_settime(_timerfd, 0, &spec, nullptr);  // 停用定时器
+    uint64_t nextExpire = nextEventMs();
+    if (nextExpire == 0) {
+        if (_timerfd >= 0) {
+            itimerspec spec{};
+            timerfd_settime(_timerfd, 0, &spec, nullptr);  // 停用定时器
+        }
+        _armedMs = 0;
         return;
     }
+    armTimerfd(nextExpire);
+}
 
-    uint64_t nextExpire = _timers.begin()->second.first;
+void TimerManager::armTimerfd(uint64_t expireMs) {
+    if (_timerfd < 0) {
+        _armedMs = expireMs;
+        return;
+    }
     uint64_t now = getNowMs();
-    uint64_t diffMs = (nextExpire > now) ? (nextExpire - now) : 1;
+    uint64_t diffMs = (expireMs > now) ? (expireMs - now) : 1;
 
     itimerspec spec{};
     spec.it_value.tv_sec = diffMs / 1000;
     spec.it_value.tv_nsec = (diffMs % 1000) * 1000000;
     timerfd_settime(_timerfd, 0, &spec, nullptr);
+    _armedMs = expireMs;
 }
@@ -2,24 +2,33 @@
 #define __TIMER_MANAGER_H__
 
 #include <functional>
-#include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <sys/timerfd.h>
 #include <unistd.h>
 #include <stdint.h>
 
+/*
+分层时间轮（毫秒精度），每个 EventLoop 一个 timerfd。
+第 0 层 256 个槽，每槽 1ms；第 1~4 层各 64 个槽，每槽分别覆盖 2^8/2^14/2^20/2^26 ms，
+总跨度 2^32 ms，更远的定时器先挂在最高层，级联时再按真实到期时间重新放置。
+添加、删除都是 O(1)；到期时只处理非空的槽，空的时间段通过位图直接跳过，
+timerfd 总是按最早的非空槽/级联点设置，而不是按定时器 id。
+*/
 class TimerManager {
 public:
     using TimerCallback = std::function<void()>;
-    using TimerId = uint64_t; 
+    using TimerId = uint64_t;
 
-    TimerManager();
+    // useTimerfd 为 false 时不创建 timerfd，由 EventLoop 用 timeoutMs() 作为等待超时，醒来后调用 handleExpired()
+    explicit TimerManager(bool useTimerfd = true);
     ~TimerManager();
 
-    // 添加一次性定时器（延时秒数）
+    // 添加一次性定时器（延时，单位毫秒）
     TimerId addTimer(int delaySec, TimerCallback &&cb);
 
-    // 添加周期性定时器（延时、周期秒数）
+    // 添加周期性定时器（延时、周期，单位毫秒）
     TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback &&cb);
 
     // 获取底层timerfd
@@ -27,18 +36,57 @@ public:
 
     // 由上层 EventLoop 调用，当 timerfd 可读时触发
     void handleRead();
+    // 执行所有已到期的定时器
+    void handleExpired();
+    // 距离下一次需要处理的时间点还有多少毫秒，不超过 maxMs
+    int timeoutMs(int maxMs) const;
 
     void removeTimer(TimerId timerId);  // 删除定时器
 
+    size_t size() const { return _timers.size(); }
+
 private:
+    static const int kLevel0Bits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevels = 5;
+    static const int kLevel0Slots = 1 << kLevel0Bits;   // 256
+    static const int kLevelSlots = 1 << kLevelBits;     // 64
+    static const int kTotalSlots = kLevel0Slots + (kLevels - 1) * kLevelSlots;
+
     struct Timer {
-        int interval;  // 0 表示一次性，>0 表示周期
+        TimerId id;
+        uint64_t expire;       // 到期时间（毫秒，CLOCK_MONOTONIC）
+        int interval;          // 0 表示一次性，>0 表示周期
         TimerCallback callback;
+        Timer *prev = nullptr; // 槽内双向链表，删除时 O(1) 摘除
+        Timer *next = nullptr;
+        int slot = -1;         // 所在槽的下标，-1 表示不在轮上（正在执行）
     };
 
-    int _timerfd;
-    std::map<TimerId, std::pair<uint64_t, Timer>> _timers;  // key: expiration time
+    TimerId addTimerInternal(uint64_t expireTime, int interval, TimerCallback &&cb);
+    void place(Timer *timer);          // 按到期时间挂到对应层的槽上
+    void unlink(Timer *timer);         // 从所在槽摘下
+    void cascade(int level, int index);// 把高层的一个槽重新分配到低层
+    void runTick(uint64_t tick, uint64_t now);  // 推进到 tick：先级联，再执行第 0 层对应槽
+    uint64_t nextEventMs() const;      // 下一个需要处理的时间点（到期或级联），无定时器时返回 0
     void resetTimerfd();  // 设置下一个 timerfd 到期时间
+    void armTimerfd(uint64_t expireMs);  // 没有 timerfd 时只记录到期时刻
+
+    static int levelShift(int level) {
+        return level == 0 ? 0 : kLevel0Bits + (level - 1) * kLevelBits;
+    }
+    static int slotBase(int level) {
+        return level == 0 ? 0 : kLevel0Slots + (level - 1) * kLevelSlots;
+    }
+
+    int _timerfd;
+    std::unordered_map<TimerId, std::unique_ptr<Timer>> _timers;
+    Timer *_wheel[kTotalSlots];                 // 每个槽的链表头
+    uint64_t _level0Bitmap[kLevel0Slots / 64];  // 第 0 层非空槽位图
+    uint64_t _levelBitmap[kLevels];             // 第 1~4 层非空槽位图（下标 0 不用）
+    uint64_t _currentMs;                        // 时间轮已处理到的时刻
+    std::vector<TimerId> _expired;              // runTick 复用的到期 id 缓冲
+    uint64_t _armedMs = 0;                      // timerfd 当前设置的到期时刻，0 表示未设置
     TimerId _nextId = 1;  // 用于生成唯一的 TimerId
 
     uint64_t getNowMs() const;
@@ -1,4 +1,5 @@
 #include "UdpConnection.h"
+#include "Logger.h"
 #include <iostream>
 #include <sstream>
 
@@ -6,15 +7,30 @@ using std::cout;
 using std::endl;
 using std::ostringstream;
 
+std::atomic_bool UdpConnection::_gsoEnabled{true};
+std::atomic_bool UdpConnection::_txTimeEnabled{false};
+std::atomic<uint32_t> UdpConnection::_maxPacingRate{0};
+
 UdpConnection::UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr,std::shared_ptr<EventLoop> loopPtr)
-    : _loopPtr(loopPtr), _sock(ip,port,peerAddr), _localAddr(getLocalAddr()), _peerAddr(peerAddr) {
+    : _loopPtr(loopPtr), _sock(std::make_shared<UdpSocket>(ip,port,peerAddr)), _localAddr(getLocalAddr()), _peerAddr(peerAddr) {
+    _sock->setGso(_gsoEnabled);
+    if (_txTimeEnabled) {
+        _sock->setTxTime(true);
+    }
+    if (_maxPacingRate) {
+        _sock->setMaxPacingRate(_maxPacingRate);
+    }
+}
+
+UdpConnection::UdpConnection(std::shared_ptr<UdpSocket> sock, InetAddress peerAddr, std::shared_ptr<EventLoop> loopPtr)
+    : _loopPtr(loopPtr), _sock(sock), _localAddr(getLocalAddr()), _peerAddr(peerAddr) {
 }
 
 UdpConnection::~UdpConnection() {
 }
 
 void UdpConnection::send(const std::string& msg) {
-    _sock.sendto(msg.c_str(), msg.size());
+    _sock->sendto(msg.c_str(), msg.size(), _peerAddr);
 }
 
 void UdpConnection::sendInLoop(const std::string& msg) {
@@ -25,9 +41,59 @@ void UdpConnection::sendInLoop(const std::string& msg) {
     }
 }
 
-int UdpConnection::recv(void* buff) {
-    int n = _sock.recvfrom(buff, sizeof(buff));
-    _peerAddr = _sock.getPeerAddr();
+void UdpConnection::sendBatch(const struct iovec* packets, size_t count, uint64_t spreadNs) {
+    sendBatch(packets, nullptr, count, spreadNs);
+}
+
+void UdpConnection::sendBatch(const struct iovec* iovs, const uint8_t* segments, size_t count, uint64_t spreadNs) {
+    if (count == 1 && (!segments || segments[0] == 1)) {
+        _sock->sendto(iovs[0].iov_base, iovs[0].iov_len, _peerAddr);
+    } else if (count > 0) {
+        _sock->sendmmsg(iovs, segments, count, _peerAddr, spreadNs);
+    }
+}
+
+void UdpConnection::sendBatch(const std::vector<PacketPtr>& packets, uint64_t spreadNs) {
+    // 带外挂段的包占两个 iovec
+    _iovs.resize(packets.size() * 2);
+    _segments.resize(packets.size());
+    size_t n = 0;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        _segments[i] = uint8_t(packets[i]->fillIovec(&_iovs[n]));
+        n += _segments[i];
+    }
+    sendBatch(_iovs.data(), _segments.data(), packets.size(), spreadNs);
+}
+
+void UdpConnection::reserveBatch(size_t packets) {
+    _iovs.reserve(packets * 2);
+    _segments.reserve(packets);
+}
+
+void UdpConnection::sendBatchInLoop(const std::vector<PacketPtr>& packets, uint64_t spreadNs) {
+    if (!_loopPtr) {
+        return;
+    }
+    if (_loopPtr->isInLoopThread()) {
+        sendBatch(packets, spreadNs);
+        return;
+    }
+    // 跨线程时整批只投递一个任务，包本身只增加引用计数，不拷贝内容
+    auto self = shared_from_this();
+    std::vector<PacketPtr> batch(packets);
+    _loopPtr->runInLoop([self, batch, spreadNs]() {
+        self->sendBatch(batch, spreadNs);
+    });
+}
+
+int UdpConnection::recv(void* buff, size_t len) {
+    InetAddress from;
+    int n = _sock->recvfrom(buff, len, &from);
+    // 端口不比较：NAT 可能给客户端的 RTCP 换了源端口
+    if (n >= 0 && from.getInetAddrPtr()->sin_addr.s_addr != _peerAddr.getInetAddrPtr()->sin_addr.s_addr) {
+        LOG_DEBUG("UdpConnection: dropped %d bytes from unexpected peer %s", n, from.toString().c_str());
+        return 0;
+    }
     return n;
 }
 
@@ -44,7 +110,7 @@ void UdpConnection::handleMessageCallback() {
 InetAddress UdpConnection::getLocalAddr() {
     struct sockaddr_in addr;
     socklen_t len = sizeof(struct sockaddr);
-    int ret = getsockname(_sock.fd(), (struct sockaddr*)&addr, &len);
+    int ret = getsockname(_sock->fd(), (struct sockaddr*)&addr, &len);
     if (-1 == ret) {
         perror("getsockname");
     }
@@ -56,7 +122,7 @@ InetAddress UdpConnection::getPeerAddr(){
 }
 
 int UdpConnection::getUdpFd() const {
-    return _sock.fd();
+    return _sock->fd();
 }
 
 TimerId UdpConnection::addOneTimer(int delaySec, TimerCallback&& cb) {
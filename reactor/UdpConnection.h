@@ -4,9 +4,12 @@
 #include "UdpSocket.h"
 #include "InetAddress.h"
 #include "EventLoop.h"
+#include "PacketBuffer.h"
 #include <memory>
 #include <functional>
 #include <string>
+#include <vector>
+#include <atomic>
 
 using std::shared_ptr;
 using std::function;
@@ -20,11 +23,33 @@ class UdpConnection : public std::enable_shared_from_this<UdpConnection> {
     
 public:
     explicit UdpConnection(const string &ip,unsigned short port,InetAddress peerAddr, std::shared_ptr<EventLoop> loopPtr);
+    // 共享套接字：不单独绑定端口，经 sock（通常是本 EventLoop 的 UdpMux 套接字）发给 peerAddr
+    UdpConnection(std::shared_ptr<UdpSocket> sock, InetAddress peerAddr, std::shared_ptr<EventLoop> loopPtr);
     ~UdpConnection();
     
     void send(const std::string& msg);
     void sendInLoop(const std::string& msg);
-    int recv(void *buff);
+    // 批量发送：每个元素是一个 RTP 包，一次 sendmmsg 发出，用于整帧/整个发送节拍的包。
+    // spreadNs 非 0 且开启了 SO_TXTIME 时，由内核把这批包均匀铺开在 spreadNs 内发出，而不是一次突发
+    void sendBatch(const struct iovec* packets, size_t count, uint64_t spreadNs = 0);
+    // 一个包由 segments[i] 个连续的 iovec 组成（见 UdpSocket::sendmmsg），segments 为 nullptr 时每包一段
+    void sendBatch(const struct iovec* iovs, const uint8_t* segments, size_t count, uint64_t spreadNs = 0);
+    void sendBatch(const std::vector<PacketPtr>& packets, uint64_t spreadNs = 0);
+    // 不在本连接的 EventLoop 线程时，拷贝包指针（只加引用计数）投递过去
+    void sendBatchInLoop(const std::vector<PacketPtr>& packets, uint64_t spreadNs = 0);
+    // 预留 sendBatch(packets) 的 iovec 容量，一批最多 packets 个包时稳态下不再分配
+    void reserveBatch(size_t packets);
+
+    // 新建的连接是否对等长的连续包（如同一 NALU 的 FU-A 分片）使用 UDP GSO，默认开启；内核不支持时自动退回
+    static void setGsoEnabled(bool enabled) { _gsoEnabled = enabled; }
+    // 新建的连接是否用 SO_TXTIME 给批量发送的包标上发送时间，默认关闭；需要出口网卡挂 fq/etf 队列规则
+    static void setTxTimeEnabled(bool enabled) { _txTimeEnabled = enabled; }
+    static bool txTimeEnabled() { return _txTimeEnabled; }
+    // 新建的独占端口连接的 SO_MAX_PACING_RATE（字节/秒），0 表示不限，默认 0；同样依赖 fq 队列规则
+    static void setMaxPacingRate(uint32_t bytesPerSec) { _maxPacingRate = bytesPerSec; }
+    // 收一个数据报到 buff（最多 len 字节）。只接受来自 SETUP 时协商的客户端 IP 的数据报，
+    // 其他来源的丢掉并返回 0；对端地址不跟着源地址变，伪造的数据报不能把推流引到别处
+    int recv(void *buff, size_t len);
     
     // 回调函数注册
     void setMessageCallback(const UdpConnectionCallback& cb);
@@ -33,9 +58,11 @@ public:
     void handleMessageCallback();
     
     InetAddress getLocalAddr();
+    unsigned short localPort() const { return _sock->localPort(); }   // 绑定失败时返回 0
     InetAddress getPeerAddr();
     
     int getUdpFd() const;
+    EventLoop* getLoop() const { return _loopPtr.get(); }
     
     TimerId addOneTimer(int delaySec, TimerCallback&& cb);
     TimerId addPeriodicTimer(int delaySec, int intervalSec, TimerCallback&& cb);
@@ -43,11 +70,16 @@ public:
     
 private:
     std::shared_ptr<EventLoop> _loopPtr;
-    UdpSocket _sock;
+    std::shared_ptr<UdpSocket> _sock;
     InetAddress _localAddr;
     InetAddress _peerAddr;
     
     UdpConnectionCallback _onMessageCb;
+    std::vector<struct iovec> _iovs;    // sendBatch 复用，避免每批分配
+    std::vector<uint8_t> _segments;
+    static std::atomic_bool _gsoEnabled;
+    static std::atomic_bool _txTimeEnabled;
+    static std::atomic<uint32_t> _maxPacingRate;
 };
 
 #endif 
\ No newline at end of file
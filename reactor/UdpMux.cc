@@ -0,0 +1,168 @@
+#include "UdpMux.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "UdpPortPool.h"
+#include <string.h>
+
+std::atomic_bool UdpMux::_enabled{false};
+std::map<EventLoop*, std::shared_ptr<UdpMux>> UdpMux::_registry;
+std::mutex UdpMux::_registryMutex;
+
+std::shared_ptr<UdpMux> UdpMux::forLoop(EventLoop* loop) {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    std::shared_ptr<UdpMux>& mux = _registry[loop];
+    if (!mux) {
+        std::shared_ptr<UdpMux> created(new UdpMux(loop));
+        if (!created->open()) {
+            _registry.erase(loop);
+            return nullptr;
+        }
+        mux = created;
+    }
+    return mux;
+}
+
+UdpMux::UdpMux(EventLoop* loop)
+:_loop(loop)
+{
+    for (size_t i = 0; i < kRecvBatch; ++i) {
+        _recvIov[i].iov_base = _recvBuf[i];
+        _recvIov[i].iov_len = kMaxRtcpSize;
+    }
+}
+
+bool UdpMux::open() {
+    // 从端口池里取一对端口；被其他进程占用、绑定失败的就还回去换下一对。这对端口随 UdpMux 一直占用
+    for (int attempt = 0; attempt < kPortAttempts; ++attempt) {
+        int port = UdpPortPool::acquire();
+        if (port < 0) {
+            break;
+        }
+        auto rtp = std::make_shared<UdpSocket>("0.0.0.0", port, InetAddress());
+        auto rtcp = std::make_shared<UdpSocket>("0.0.0.0", port + 1, InetAddress());
+        if (rtp->localPort() != port || rtcp->localPort() != port + 1) {
+            UdpPortPool::release(port);
+            continue;
+        }
+        rtp->setGso(true);
+        if (UdpConnection::txTimeEnabled()) {
+            rtp->setTxTime(true);   // 发送时间按包标记，多个会话共用也互不影响；SO_MAX_PACING_RATE 是整个套接字的上限，这里不设
+        }
+        _rtpSock = rtp;
+        _rtcpSock = rtcp;
+        _rtpPort = port;
+        break;
+    }
+    if (!_rtpSock) {
+        LOG_ERROR("UdpMux: no free RTP/RTCP port pair for loop %p", _loop);
+        return false;
+    }
+    // EventLoop 按 fd 分发 UDP 读事件，共享 RTCP 套接字也包成一个 UdpConnection 登记进去；
+    // 注册表一直持有 UdpMux，回调里直接用 this。EventLoop 的生命周期由 MultiThreadEventLoop 管理，这里不持有
+    std::shared_ptr<EventLoop> loopRef(std::shared_ptr<EventLoop>(), _loop);
+    _rtcpConn = std::make_shared<UdpConnection>(_rtcpSock, InetAddress(), loopRef);
+    _rtcpConn->setMessageCallback([this](const UdpConnectionPtr&) {
+        handleRtcpRead();
+    });
+    _loop->udpConns[_rtcpSock->fd()] = _rtcpConn;
+    _loop->addEpollConnFd(_rtcpSock->fd(), false);
+    LOG_INFO("UdpMux for loop %p: RTP port %d, RTCP port %d", _loop, _rtpPort, _rtpPort + 1);
+    return true;
+}
+
+std::shared_ptr<UdpConnection> UdpMux::connect(const InetAddress& peer, const std::shared_ptr<EventLoop>& loopPtr) {
+    return std::make_shared<UdpConnection>(_rtpSock, peer, loopPtr);
+}
+
+std::shared_ptr<UdpConnection> UdpMux::connectRtcp(const InetAddress& peer, const std::shared_ptr<EventLoop>& loopPtr) {
+    return std::make_shared<UdpConnection>(_rtcpSock, peer, loopPtr);
+}
+
+uint64_t UdpMux::addRtcpPeer(const InetAddress& peer, RtcpHandler handler) {
+    uint64_t id = _nextPeerId++;
+    uint64_t addr = addrKey(*peer.getInetAddrPtr());
+    _peers[id] = RtcpPeer{addr, 0, false, std::move(handler)};
+    _byAddr[addr] = id;
+    return id;
+}
+
+void UdpMux::removeRtcpPeer(uint64_t id) {
+    auto it = _peers.find(id);
+    if (it == _peers.end()) {
+        return;
+    }
+    auto addrIt = _byAddr.find(it->second.addr);
+    if (addrIt != _byAddr.end() && addrIt->second == id) {
+        _byAddr.erase(addrIt);
+    }
+    if (it->second.hasSsrc) {
+        auto ssrcIt = _bySsrc.find(it->second.ssrc);
+        if (ssrcIt != _bySsrc.end() && ssrcIt->second == id) {
+            _bySsrc.erase(ssrcIt);
+        }
+    }
+    _peers.erase(it);
+}
+
+uint64_t UdpMux::addrKey(const struct sockaddr_in& addr) {
+    return (uint64_t(ntohl(addr.sin_addr.s_addr)) << 16) | ntohs(addr.sin_port);
+}
+
+void UdpMux::handleRtcpRead() {
+    // 一次读空：每轮最多 kRecvBatch 个数据报
+    for (;;) {
+        for (size_t i = 0; i < kRecvBatch; ++i) {
+            memset(&_recvMsgs[i], 0, sizeof(_recvMsgs[i]));
+            _recvMsgs[i].msg_hdr.msg_iov = &_recvIov[i];
+            _recvMsgs[i].msg_hdr.msg_iovlen = 1;
+            _recvMsgs[i].msg_hdr.msg_name = &_recvFrom[i];
+            _recvMsgs[i].msg_hdr.msg_namelen = sizeof(_recvFrom[i]);
+        }
+        int n = _rtcpSock->recvmmsg(_recvMsgs, kRecvBatch);
+        for (int i = 0; i < n; ++i) {
+            dispatchRtcp(_recvFrom[i], _recvBuf[i], _recvMsgs[i].msg_len);
+        }
+        if (n < (int)kRecvBatch) {
+            break;
+        }
+    }
+}
+
+void UdpMux::dispatchRtcp(const struct sockaddr_in& from, const uint8_t* data, size_t len) {
+    // 复合 RTCP 包的第一个包（SR/RR/SDES/BYE）在偏移 4 处都是发送者 SSRC
+    bool hasSsrc = len >= 8 && (data[0] >> 6) == 2 && data[1] >= 200 && data[1] <= 204;
+    uint32_t ssrc = hasSsrc ? (uint32_t(data[4]) << 24 | uint32_t(data[5]) << 16 | uint32_t(data[6]) << 8 | data[7]) : 0;
+    uint64_t addr = addrKey(from);
+
+    RtcpPeer* peer = nullptr;
+    auto addrIt = _byAddr.find(addr);
+    if (addrIt != _byAddr.end()) {
+        peer = &_peers[addrIt->second];
+        if (hasSsrc && (!peer->hasSsrc || peer->ssrc != ssrc)) {
+            // 第一次从这个地址收到 RTCP，记下客户端的 SSRC
+            peer->ssrc = ssrc;
+            peer->hasSsrc = true;
+            _bySsrc[ssrc] = addrIt->second;
+        }
+    } else if (hasSsrc) {
+        auto ssrcIt = _bySsrc.find(ssrc);
+        if (ssrcIt != _bySsrc.end()) {
+            // 同一个 SSRC 换了源地址（NAT 重新映射），跟着更新地址索引
+            peer = &_peers[ssrcIt->second];
+            auto oldIt = _byAddr.find(peer->addr);
+            if (oldIt != _byAddr.end() && oldIt->second == ssrcIt->second) {
+                _byAddr.erase(oldIt);
+            }
+            peer->addr = addr;
+            _byAddr[addr] = ssrcIt->second;
+            LOG_INFO("UdpMux: RTCP source for SSRC %u moved to %s", ssrc, InetAddress(from).toString().c_str());
+        }
+    }
+    if (!peer) {
+        LOG_DEBUG("UdpMux: dropped %zu bytes of RTCP from unknown peer %s", len, InetAddress(from).toString().c_str());
+        return;
+    }
+    if (peer->handler) {
+        peer->handler(data, len);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __UDPMUX_H__
+#define __UDPMUX_H__
+
+#include "NonCopyable.h"
+#include "UdpSocket.h"
+#include "UdpConnection.h"
+#include "InetAddress.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <stdint.h>
+
+class EventLoop;
+
+/*
+每个 EventLoop 一对共享的 RTP/RTCP 套接字（RTP 偶数端口，RTCP 紧随其后）。
+开启后 UDP 会话不再各自绑定四个端口：RTP 经共享套接字 sendto/sendmmsg 发给各自的客户端，
+入站 RTCP 用 recvmmsg 批量读出，先按源地址找到会话；源地址变了（NAT 重新映射）时再按包里的发送者 SSRC 找回会话并更新地址。
+除 forLoop 的注册表外都只在所属 EventLoop 的线程中使用。
+*/
+class UdpMux : NonCopyable {
+public:
+    using RtcpHandler = std::function<void(const uint8_t* data, size_t len)>;
+
+    // 是否启用共享套接字模式，默认关闭
+    static void setEnabled(bool enabled) { _enabled = enabled; }
+    static bool enabled() { return _enabled; }
+
+    // 必须在 loop 的线程中调用；第一次调用时创建套接字并注册读事件，失败返回空
+    static std::shared_ptr<UdpMux> forLoop(EventLoop* loop);
+
+    unsigned short rtpPort() const { return _rtpPort; }
+    unsigned short rtcpPort() const { return _rtpPort + 1; }
+
+    // 一个经共享 RTP 套接字发往 peer 的发送端，接口和独占端口的 UdpConnection 相同
+    std::shared_ptr<UdpConnection> connect(const InetAddress& peer, const std::shared_ptr<EventLoop>& loopPtr);
+    // 同上，经共享 RTCP 套接字发往 peer，用于发送 SR
+    std::shared_ptr<UdpConnection> connectRtcp(const InetAddress& peer, const std::shared_ptr<EventLoop>& loopPtr);
+
+    // 登记一个客户端 RTCP 地址，返回的 id 用于注销
+    uint64_t addRtcpPeer(const InetAddress& peer, RtcpHandler handler);
+    void removeRtcpPeer(uint64_t id);
+    size_t rtcpPeerCount() const { return _peers.size(); }
+
+private:
+    explicit UdpMux(EventLoop* loop);
+    bool open();
+    void handleRtcpRead();
+    void dispatchRtcp(const struct sockaddr_in& from, const uint8_t* data, size_t len);
+    static uint64_t addrKey(const struct sockaddr_in& addr);
+
+    struct RtcpPeer {
+        uint64_t addr;
+        uint32_t ssrc;
+        bool hasSsrc;
+        RtcpHandler handler;
+    };
+
+    static const size_t kRecvBatch = 16;
+    static const size_t kMaxRtcpSize = 1500;
+    static const int kPortAttempts = 64;
+
+    EventLoop* _loop;
+    std::shared_ptr<UdpSocket> _rtpSock;
+    std::shared_ptr<UdpSocket> _rtcpSock;
+    std::shared_ptr<UdpConnection> _rtcpConn;   // 登记在 EventLoop::udpConns 里，读事件回调到 handleRtcpRead
+    unsigned short _rtpPort = 0;
+
+    std::unordered_map<uint64_t, RtcpPeer> _peers;    // id -> 客户端
+    std::unordered_map<uint64_t, uint64_t> _byAddr;   // 源地址 -> id
+    std::unordered_map<uint32_t, uint64_t> _bySsrc;   // 发送者 SSRC -> id
+    uint64_t _nextPeerId = 1;
+
+    // recvmmsg 复用的接收缓冲区
+    uint8_t _recvBuf[kRecvBatch][kMaxRtcpSize];
+    struct iovec _recvIov[kRecvBatch];
+    struct sockaddr_in _recvFrom[kRecvBatch];
+    struct mmsghdr _recvMsgs[kRecvBatch];
+
+    static std::atomic_bool _enabled;
+    static std::map<EventLoop*, std::shared_ptr<UdpMux>> _registry;
+    static std::mutex _registryMutex;
+};
+
+#endif
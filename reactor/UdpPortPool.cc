@@ -0,0 +1,75 @@
+#include "UdpPortPool.h"
+#include "Logger.h"
+
+std::atomic<uint64_t> UdpPortPool::_bitmap[UdpPortPool::kWords];
+std::atomic<size_t> UdpPortPool::_cursor{0};
+std::atomic<size_t> UdpPortPool::_inUse{0};
+unsigned short UdpPortPool::_firstPort = 10000;
+size_t UdpPortPool::_pairCount = 5000;   // 默认 10000-19999
+
+bool UdpPortPool::setRange(unsigned short first, unsigned short last) {
+    unsigned int evenFirst = (first + 1u) & ~1u;
+    if (evenFirst == 0 || evenFirst + 1 > last) {
+        LOG_ERROR("UdpPortPool: invalid port range %u-%u", first, last);
+        return false;
+    }
+    _firstPort = (unsigned short)evenFirst;
+    _pairCount = (last - evenFirst + 1) / 2;
+    for (size_t i = 0; i < kWords; ++i) {
+        _bitmap[i].store(0);
+    }
+    _cursor = 0;
+    _inUse = 0;
+    LOG_INFO("UdpPortPool: %zu port pairs in %u-%u", _pairCount, evenFirst, (unsigned)(evenFirst + _pairCount * 2 - 1));
+    return true;
+}
+
+int UdpPortPool::acquire() {
+    size_t words = (_pairCount + 63) / 64;
+    size_t start = _cursor.load(std::memory_order_relaxed) % _pairCount;
+    // 从游标所在的字开始转一圈，多看一次起始字，以便拿到它里面游标之前的位
+    for (size_t n = 0; n <= words; ++n) {
+        size_t w = (start / 64 + n) % words;
+        uint64_t valid = ~uint64_t(0);
+        if (w == words - 1 && _pairCount % 64) {
+            valid = (uint64_t(1) << (_pairCount % 64)) - 1;
+        }
+        uint64_t cur = _bitmap[w].load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t freeBits = ~cur & valid;
+            if (n == 0) {
+                // 第一次只看游标之后的位，保持轮转顺序
+                freeBits &= ~uint64_t(0) << (start % 64);
+            }
+            if (!freeBits) {
+                break;
+            }
+            uint64_t bit = freeBits & (~freeBits + 1);
+            if (_bitmap[w].compare_exchange_weak(cur, cur | bit, std::memory_order_acquire, std::memory_order_relaxed)) {
+                size_t pair = w * 64 + __builtin_ctzll(bit);
+                _cursor.store(pair + 1, std::memory_order_relaxed);
+                ++_inUse;
+                return _firstPort + int(pair * 2);
+            }
+            // CAS 失败时 cur 已是最新值，重新找
+        }
+    }
+    return -1;
+}
+
+void UdpPortPool::release(int rtpPort) {
+    if (rtpPort < _firstPort || (rtpPort - _firstPort) % 2) {
+        return;
+    }
+    size_t pair = (rtpPort - _firstPort) / 2;
+    if (pair >= _pairCount) {
+        return;
+    }
+    uint64_t bit = uint64_t(1) << (pair % 64);
+    uint64_t prev = _bitmap[pair / 64].fetch_and(~bit, std::memory_order_release);
+    if (prev & bit) {
+        --_inUse;
+    } else {
+        LOG_WARN("UdpPortPool: port %d released twice", rtpPort);
+    }
+}
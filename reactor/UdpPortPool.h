@@ -0,0 +1,37 @@
+#ifndef __UDPPORTPOOL_H__
+#define __UDPPORTPOOL_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+服务器端 RTP/RTCP 端口对的分配器：RTP 用偶数端口，RTCP 紧随其后。
+每一对占位图中的一位，分配和归还都是对 64 位字的原子操作，不加锁；
+分配从一个轮转游标开始找，刚归还的端口不会马上被下一个会话拿到，晚到的旧包不会串进新会话。
+*/
+class UdpPortPool {
+public:
+    // 设置可分配的端口范围 [first, last]，first 向上取偶数。只能在服务器启动、还没有会话时调用
+    static bool setRange(unsigned short first, unsigned short last);
+
+    // 取一对空闲端口，返回 RTP 端口，范围内已经没有空闲端口对时返回 -1
+    static int acquire();
+    // 归还 acquire 返回的端口，重复归还或不在范围内的端口会被忽略
+    static void release(int rtpPort);
+
+    static size_t capacity() { return _pairCount; }
+    static size_t inUse() { return _inUse; }
+
+private:
+    static const size_t kMaxPairs = 65536 / 2;
+    static const size_t kWords = kMaxPairs / 64;
+
+    static std::atomic<uint64_t> _bitmap[kWords];   // 置位表示这一对已被占用
+    static std::atomic<size_t> _cursor;             // 下一次从哪一对开始找
+    static std::atomic<size_t> _inUse;
+    static unsigned short _firstPort;
+    static size_t _pairCount;
+};
+
+#endif
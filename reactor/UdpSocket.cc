@@ -6,6 +6,25 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <linux/net_tstamp.h>
+#include <time.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
 
 UdpSocket::UdpSocket(const string &ip,unsigned short port,InetAddress clientAddr)
 :_serverAddr(ip,port)
@@ -64,29 +83,228 @@ int UdpSocket::bind() {
 }
 
 int UdpSocket::sendto(const void* data, size_t len) {
-    int ret = ::sendto(_fd, data, len, 0, (struct sockaddr *)_clientAddr.getInetAddrPtr(), sizeof(struct sockaddr_in));
+    return sendto(data, len, _clientAddr);
+}
+
+int UdpSocket::sendto(const void* data, size_t len, const InetAddress& peer) {
+    int ret = ::sendto(_fd, data, len, 0, (const struct sockaddr *)peer.getInetAddrPtr(), sizeof(struct sockaddr_in));
     if (ret == -1) {
         perror("sendto");
     }
     return ret;
 }
 
-int UdpSocket::recvfrom(void* data, size_t len) {
+int UdpSocket::sendmmsg(const struct iovec* packets, size_t count) {
+    return sendmmsg(packets, count, _clientAddr);
+}
+
+int UdpSocket::sendmmsg(const struct iovec* packets, size_t count, const InetAddress& peer, uint64_t spreadNs) {
+    return sendmmsg(packets, nullptr, count, peer, spreadNs);
+}
+
+int UdpSocket::sendmmsg(const struct iovec* iovs, const uint8_t* segments, size_t count, const InetAddress& peer,
+                        uint64_t spreadNs) {
+    const size_t kMaxBatch = 64;
+    struct mmsghdr msgs[kMaxBatch];
+    char control[kMaxBatch][CMSG_SPACE(sizeof(uint64_t))];
+    size_t firstPacket[kMaxBatch + 1];  // 每条消息的第一个包在 iovs 所描述的包序列中的下标
+    size_t firstIov[kMaxBatch + 1];     // 以及它的第一段在 iovs 中的下标
+    auto segmentsOf = [segments](size_t packet) -> size_t {
+        return segments ? segments[packet] : 1;
+    };
+    auto packetBytes = [iovs, &segmentsOf](size_t iov, size_t packet) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < segmentsOf(packet); ++i) {
+            bytes += iovs[iov + i].iov_len;
+        }
+        return bytes;
+    };
+    size_t sent = 0;
+    size_t sentIov = 0;
+    bool timed = _txTime && spreadNs > 0 && count > 1;
+    uint64_t launchNs = 0;
+    if (timed) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        launchNs = uint64_t(now.tv_sec) * 1000000000ull + now.tv_nsec;
+    }
+    while (sent < count) {
+        size_t n = 0;
+        size_t p = sent;
+        size_t iov = sentIov;
+        memset(msgs, 0, sizeof(msgs));
+        while (n < kMaxBatch && p < count) {
+            // GSO：除最后一个外都必须和第一个包等长，段数和总长度受内核限制；
+            // 内核把整条消息的各段拼起来再按 segment 切，所以一个包由几段组成都不影响切分
+            size_t segment = packetBytes(iov, p);
+            size_t run = 1;
+            size_t runIovs = segmentsOf(p);
+            size_t total = segment;
+            while (_gso && !timed && p + run < count && run < kMaxGsoSegments) {
+                size_t next = packetBytes(iov + runIovs, p + run);
+                if (next > segment || total + next > kMaxGsoBytes) {
+                    break;
+                }
+                total += next;
+                runIovs += segmentsOf(p + run);
+                ++run;
+                if (next < segment) {
+                    break;
+                }
+            }
+            struct msghdr& hdr = msgs[n].msg_hdr;
+            hdr.msg_name = const_cast<struct sockaddr_in*>(peer.getInetAddrPtr());
+            hdr.msg_namelen = sizeof(struct sockaddr_in);
+            hdr.msg_iov = const_cast<struct iovec*>(&iovs[iov]);
+            hdr.msg_iovlen = runIovs;
+            if (run > 1) {
+                hdr.msg_control = control[n];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gsoSize = segment;
+                memcpy(CMSG_DATA(cm), &gsoSize, sizeof(gsoSize));
+            } else if (timed) {
+                // 第 p 个包在 launch + p * spread / count 时刻发出，重试时时间不变
+                hdr.msg_control = control[n];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(uint64_t));
+                struct cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+                cm->cmsg_level = SOL_SOCKET;
+                cm->cmsg_type = SCM_TXTIME;
+                cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+                uint64_t txTime = launchNs + spreadNs * p / count;
+                memcpy(CMSG_DATA(cm), &txTime, sizeof(txTime));
+            }
+            firstPacket[n] = p;
+            firstIov[n++] = iov;
+            p += run;
+            iov += runIovs;
+        }
+        firstPacket[n] = p;
+        firstIov[n] = iov;
+
+        int ret = ::sendmmsg(_fd, msgs, n, 0);
+        if (ret == -1) {
+            // 返回 -1 说明第一条消息就失败了，errno 对应 msgs[0]
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 非阻塞套接字缓冲区满时和 sendto 一样直接丢弃剩余的包
+                perror("sendmmsg");
+                break;
+            }
+            bool gsoMsg = firstPacket[1] - firstPacket[0] > 1;
+            bool timedMsg = timed && !gsoMsg;
+            if (timedMsg && (errno == EINVAL || errno == EOPNOTSUPP)) {
+                // 只有内核拒绝这个特性本身才关掉；套接字可能是多个会话共用的，不能因为某个对端出错就关
+                perror("sendmmsg SCM_TXTIME");
+                _txTime = false;
+                timed = false;
+                continue;
+            }
+            if (gsoMsg && (errno == EIO || errno == EINVAL)) {
+                // 网卡不支持校验和卸载等情况下内核会拒绝 GSO，本套接字退回逐包发送后重试
+                perror("sendmmsg UDP_SEGMENT");
+                _gso = false;
+                continue;
+            }
+            // 对端不可达、被防火墙拒绝、超过路径 MTU 等只和这一条消息有关，跳过它接着发后面的
+            perror("sendmmsg");
+            ret = 1;
+        }
+        sent = firstPacket[ret];
+        sentIov = firstIov[ret];
+    }
+    return sent;
+}
+
+bool UdpSocket::setGso(bool on) {
+    _gso = on && gsoSupported();
+    return _gso == on;
+}
+
+bool UdpSocket::gsoSupported() {
+    static const bool supported = []() {
+        int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        int size = 1400;
+        bool ok = setsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, sizeof(size)) == 0;
+        ::close(fd);
+        return ok;
+    }();
+    return supported;
+}
+
+bool UdpSocket::setTxTime(bool on) {
+    // 内核没有关闭 SO_TXTIME 的办法，关闭时只是不再带 SCM_TXTIME，包立即发出
+    if (on && !_txTime) {
+        struct sock_txtime config;
+        memset(&config, 0, sizeof(config));
+        config.clockid = CLOCK_MONOTONIC;
+        if (setsockopt(_fd, SOL_SOCKET, SO_TXTIME, &config, sizeof(config)) == -1) {
+            perror("setsockopt SO_TXTIME");
+            return false;
+        }
+    }
+    _txTime = on;
+    return true;
+}
+
+bool UdpSocket::setMaxPacingRate(uint32_t bytesPerSec) {
+    uint32_t rate = bytesPerSec ? bytesPerSec : ~0u;   // ~0U 表示不限速
+    if (setsockopt(_fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) == -1) {
+        perror("setsockopt SO_MAX_PACING_RATE");
+        return false;
+    }
+    return true;
+}
+
+int UdpSocket::recvfrom(void* data, size_t len, InetAddress* from) {
     struct sockaddr_in clientAddr;
     socklen_t addrLen = sizeof(clientAddr);
     
-    int ret = ::recvfrom(_fd, data, len, 0, (struct sockaddr*)&_clientAddr, &addrLen);
+    int ret = ::recvfrom(_fd, data, len, 0, (struct sockaddr*)&clientAddr, &addrLen);
     if (ret == -1) {
         if (errno != EAGAIN && errno != EWOULDBLOCK) {
             perror("recvfrom");
         }
-    } else {
-        _clientAddr = InetAddress(clientAddr);
+    } else if (from) {
+        *from = InetAddress(clientAddr);
     }
     return ret;
 } 
 
 
+int UdpSocket::recvmmsg(struct mmsghdr* msgs, size_t count) {
+    for (;;) {
+        int ret = ::recvmmsg(_fd, msgs, count, 0, nullptr);
+        if (ret >= 0) {
+            return ret;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("recvmmsg");
+        }
+        return 0;
+    }
+}
+
+unsigned short UdpSocket::localPort() const {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(_fd, (struct sockaddr*)&addr, &len) == -1) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
 InetAddress UdpSocket::getPeerAddr(){
     return _clientAddr;
 } 
\ No newline at end of file
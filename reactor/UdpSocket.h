@@ -4,6 +4,8 @@
 #include "NonCopyable.h"
 #include "InetAddress.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <stdint.h>
 
 class UdpSocket : NonCopyable {
 public:
@@ -18,7 +20,34 @@ public:
     // UDP特有方法
     int bind();
     int sendto(const void* data, size_t len);
-    int recvfrom(void* data, size_t len);
+    int sendto(const void* data, size_t len, const InetAddress& peer);
+    // 每个 iovec 是一个独立的数据报，用 sendmmsg 批量发给对端，返回处理完的包数：
+    // 发出的，加上因为单条出错（对端不可达等）被跳过的；缓冲区满时剩下的不算。
+    // 开启 GSO 时，连续等长的包（最后一个可以更短）合成一条带 UDP_SEGMENT 的消息，由内核切分
+    int sendmmsg(const struct iovec* packets, size_t count);
+    // 发给指定对端，用于多个会话共享一个套接字。
+    // spreadNs 非 0 且开启了 SO_TXTIME 时，每个包单独成一条消息并带上发送时间，从现在起均匀铺开在 spreadNs 内，不做 GSO 合并
+    int sendmmsg(const struct iovec* packets, size_t count, const InetAddress& peer, uint64_t spreadNs = 0);
+    // 同上，但一个包可以由多个 iovec 组成（如 RTP 头 + 引用文件映射的载荷）：iovs 依次是各包的各段，
+    // segments[i] 是第 i 个包的段数，为 nullptr 时每包一段
+    int sendmmsg(const struct iovec* iovs, const uint8_t* segments, size_t count, const InetAddress& peer,
+                 uint64_t spreadNs = 0);
+    // 批量读取数据报，返回读到的个数，没有数据时返回 0
+    int recvmmsg(struct mmsghdr* msgs, size_t count);
+    unsigned short localPort() const;   // 绑定失败时返回 0
+    // 开启/关闭 UDP GSO，内核不支持时返回 false；发送时被内核拒绝会自动关闭
+    bool setGso(bool on);
+    bool gso() const { return _gso; }
+    // 运行时探测内核是否支持 UDP_SEGMENT，结果缓存
+    static bool gsoSupported();
+    // 内核辅助的发送节奏，都要求出口网卡挂 fq（或 etf）队列规则才生效，其他队列规则下被忽略：
+    // SO_TXTIME 让 sendmmsg 给每个包标上发送时间（CLOCK_MONOTONIC，与 steady_clock 同源）；
+    // SO_MAX_PACING_RATE 限制本套接字的发送速率（字节/秒），0 表示不限
+    bool setTxTime(bool on);
+    bool txTime() const { return _txTime; }
+    bool setMaxPacingRate(uint32_t bytesPerSec);
+    // 收一个数据报，from 非空时填入源地址；不改变发送用的对端地址
+    int recvfrom(void* data, size_t len, InetAddress* from = nullptr);
     void setPeerAddr(InetAddress clientAddr);
     void closeUdp();
     InetAddress getPeerAddr();
@@ -27,6 +56,10 @@ private:
     int _fd;
     InetAddress _serverAddr;//服务器地址
     InetAddress _clientAddr;//客户端地址
+    bool _gso = false;
+    bool _txTime = false;
+    static const size_t kMaxGsoSegments = 64;   // 内核 UDP_MAX_SEGMENTS
+    static const size_t kMaxGsoBytes = 65000;   // 超级缓冲区不能超过一个 IP 包的上限
 };
 
 #endif 
\ No newline at end of file